@@ -0,0 +1,600 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "server/Poller.h"
+#include "server/Socket.h"
+#include "utils/Histogram.h"
+
+// HTTP/1.1 load generator. Each thread drives its share of the connections
+// from one Poller, keeping up to --pipeline requests in flight per
+// connection. By default it runs closed-loop (a response triggers the next
+// request) and latency is measured from the send. With --rate it runs
+// open-loop: every connection has a fixed request schedule, and latency is
+// measured from the scheduled time, so a stalled server is charged for the
+// requests it delayed (no coordinated omission).
+namespace {
+
+std::uint64_t nowNs() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+struct Target {
+    std::string path;
+    unsigned weight{1};
+    std::string request;
+};
+
+struct Options {
+    std::string host{"127.0.0.1"};
+    int port{8080};
+    std::vector<Target> targets;
+    std::size_t threads{2};
+    std::size_t connections{64};
+    std::size_t pipeline{1};
+    bool keepAlive{true};
+    // Total requests per second across all connections; 0 runs closed-loop.
+    double rate{0};
+    double durationSeconds{10};
+    // Stop after this many requests in total; 0 runs for the whole duration.
+    std::uint64_t requests{0};
+    std::string hdrPath;
+};
+
+struct Connection {
+    Socket socket{-1};
+    std::string out;
+    std::size_t outOffset{0};
+    bool wantWrite{false};
+    // Start times of requests in flight, oldest first.
+    std::deque<std::uint64_t> inflight;
+    // Open loop: scheduled times of requests waiting for a pipeline slot.
+    std::deque<std::uint64_t> owed;
+
+    std::string header;
+    std::size_t bodyRemaining{0};
+    bool inBody{false};
+    int status{0};
+    bool closeAfter{false};
+};
+
+struct Stats {
+    std::uint64_t responses{0};
+    std::uint64_t badStatus{0};
+    std::uint64_t socketErrors{0};
+    std::uint64_t connects{0};
+    std::uint64_t bytesRead{0};
+    std::uint64_t backlog{0};
+    std::unique_ptr<Histogram> latency = std::make_unique<Histogram>();
+};
+
+class Worker {
+public:
+    Worker(const Options& options, std::size_t connections, std::uint64_t quota, std::uint64_t seed)
+        : options_(options), connections_(connections), quota_(quota), rng_(seed | 1) {
+        for (const Target& target : options_.targets) {
+            totalWeight_ += target.weight;
+        }
+        if (options_.rate > 0 && connections > 0) {
+            const double perConnection = options_.rate / static_cast<double>(options_.connections);
+            interval_ = static_cast<std::uint64_t>(1e9 / perConnection);
+        }
+    }
+
+    void run(std::uint64_t start, std::uint64_t end) {
+        end_ = end;
+        for (std::size_t i = 0; i < connections_.size(); ++i) {
+            if (!connect(i)) {
+                ++stats.socketErrors;
+            }
+            if (interval_ != 0) {
+                // Stagger the schedules so the connections don't fire in lockstep.
+                schedule_.push({start + interval_ * i / connections_.size(), i});
+            } else {
+                fill(i);
+            }
+        }
+
+        std::vector<Poller::Event> events;
+        while (true) {
+            const std::uint64_t now = nowNs();
+            if (now >= end_ || (quotaReached() && idle())) {
+                break;
+            }
+            int timeoutMs = static_cast<int>(std::min<std::uint64_t>((end_ - now) / 1'000'000 + 1, 100));
+            if (interval_ != 0) {
+                releaseDue(now);
+                if (!schedule_.empty()) {
+                    const std::uint64_t due = schedule_.top().first;
+                    // Sub-millisecond waits spin so schedules stay accurate.
+                    timeoutMs = due <= now ? 0 : std::min<int>(timeoutMs, static_cast<int>((due - now) / 1'000'000));
+                }
+            }
+            try {
+                poller_.wait(events, timeoutMs);
+            } catch (const std::exception&) {
+                continue;
+            }
+            for (const Poller::Event& event : events) {
+                const auto index = static_cast<std::size_t>(event.token);
+                if (event.readable || event.hangup) {
+                    readResponses(index);
+                }
+                if (event.writable && connections_[index].socket.isValid()) {
+                    flush(index);
+                }
+            }
+        }
+        for (const Connection& connection : connections_) {
+            stats.backlog += connection.owed.size();
+        }
+    }
+
+    Stats stats;
+
+private:
+    bool quotaReached() const { return quota_ != 0 && issued_ >= quota_; }
+
+    bool idle() const {
+        return std::all_of(connections_.begin(), connections_.end(),
+                           [](const Connection& connection) { return connection.inflight.empty(); });
+    }
+
+    const Target& pickTarget() {
+        if (options_.targets.size() == 1) {
+            return options_.targets.front();
+        }
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 7;
+        rng_ ^= rng_ << 17;
+        std::uint64_t pick = rng_ % totalWeight_;
+        for (const Target& target : options_.targets) {
+            if (pick < target.weight) {
+                return target;
+            }
+            pick -= target.weight;
+        }
+        return options_.targets.back();
+    }
+
+    bool connect(std::size_t index) {
+        Connection& connection = connections_[index];
+        if (connection.socket.isValid()) {
+            poller_.remove(connection.socket.getFd());
+            connection.socket.close();
+        }
+        connection.out.clear();
+        connection.outOffset = 0;
+        connection.wantWrite = false;
+        connection.inflight.clear();
+        connection.header.clear();
+        connection.inBody = false;
+        connection.bodyRemaining = 0;
+        try {
+            Socket socket;
+            socket.connect(options_.host, options_.port);
+            socket.setNoDelay();
+            socket.setNonBlocking();
+            poller_.add(socket.getFd(), index, Poller::kRead);
+            connection.socket = std::move(socket);
+        } catch (const std::exception&) {
+            return false;
+        }
+        ++stats.connects;
+        return true;
+    }
+
+    // Closed loop: top the pipeline up with requests stamped now.
+    void fill(std::size_t index) {
+        Connection& connection = connections_[index];
+        while (connection.socket.isValid() && connection.inflight.size() < options_.pipeline && !quotaReached() &&
+               nowNs() < end_) {
+            issue(index, nowNs());
+        }
+        flush(index);
+    }
+
+    // Open loop: hand every due slot to its connection, or queue it there.
+    void releaseDue(std::uint64_t now) {
+        while (!schedule_.empty() && schedule_.top().first <= now && !quotaReached()) {
+            const auto [due, index] = schedule_.top();
+            schedule_.pop();
+            schedule_.push({due + interval_, index});
+            Connection& connection = connections_[index];
+            if (connection.socket.isValid() && connection.inflight.size() < options_.pipeline &&
+                connection.owed.empty()) {
+                issue(index, due);
+                flush(index);
+            } else {
+                connection.owed.push_back(due);
+            }
+        }
+    }
+
+    void issue(std::size_t index, std::uint64_t startedAt) {
+        Connection& connection = connections_[index];
+        connection.out.append(pickTarget().request);
+        connection.inflight.push_back(startedAt);
+        ++issued_;
+    }
+
+    void flush(std::size_t index) {
+        Connection& connection = connections_[index];
+        while (connection.outOffset < connection.out.size()) {
+            ssize_t sent = 0;
+            try {
+                sent = connection.socket.send(connection.out.data() + connection.outOffset,
+                                              connection.out.size() - connection.outOffset);
+            } catch (const std::exception&) {
+                fail(index);
+                return;
+            }
+            if (sent <= 0) {
+                break;
+            }
+            connection.outOffset += static_cast<std::size_t>(sent);
+        }
+        const bool pending = connection.outOffset < connection.out.size();
+        if (!pending) {
+            connection.out.clear();
+            connection.outOffset = 0;
+        }
+        if (pending != connection.wantWrite) {
+            connection.wantWrite = pending;
+            poller_.modify(connection.socket.getFd(), index, Poller::kRead | (pending ? Poller::kWrite : 0u));
+        }
+    }
+
+    void readResponses(std::size_t index) {
+        Connection& connection = connections_[index];
+        while (connection.socket.isValid()) {
+            ssize_t bytes = 0;
+            try {
+                bytes = connection.socket.recv(buffer_, sizeof(buffer_));
+            } catch (const std::exception&) {
+                fail(index);
+                return;
+            }
+            if (bytes < 0) {
+                return;
+            }
+            if (bytes == 0) {
+                // A close between responses is the server ending keep-alive.
+                if (!connection.inflight.empty() || connection.inBody || !connection.header.empty()) {
+                    fail(index);
+                } else {
+                    (void)connect(index);
+                    resume(index);
+                }
+                return;
+            }
+            stats.bytesRead += static_cast<std::uint64_t>(bytes);
+            if (!consume(index, buffer_, static_cast<std::size_t>(bytes))) {
+                return;
+            }
+        }
+    }
+
+    // Returns false once the connection has been replaced.
+    bool consume(std::size_t index, const char* data, std::size_t size) {
+        Connection& connection = connections_[index];
+        while (size > 0) {
+            if (connection.inBody) {
+                const std::size_t take = std::min(size, connection.bodyRemaining);
+                connection.bodyRemaining -= take;
+                data += take;
+                size -= take;
+                if (connection.bodyRemaining == 0 && !complete(index)) {
+                    return false;
+                }
+                continue;
+            }
+            const std::size_t searchFrom = connection.header.size() < 3 ? 0 : connection.header.size() - 3;
+            connection.header.append(data, size);
+            const std::size_t end = connection.header.find("\r\n\r\n", searchFrom);
+            if (end == std::string::npos) {
+                if (connection.header.size() > 64 * 1024) {
+                    fail(index);
+                    return false;
+                }
+                return true;
+            }
+            const std::size_t used = end + 4 - (connection.header.size() - size);
+            data += used;
+            size -= used;
+            connection.header.resize(end + 2);
+            if (!parseHeader(connection)) {
+                fail(index);
+                return false;
+            }
+            connection.header.clear();
+            connection.inBody = true;
+            if (connection.bodyRemaining == 0 && !complete(index)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static bool parseHeader(Connection& connection) {
+        const std::string_view header = connection.header;
+        if (header.size() < 12 || header.substr(0, 5) != "HTTP/") {
+            return false;
+        }
+        connection.status = std::atoi(header.data() + 9);
+        connection.bodyRemaining = 0;
+        connection.closeAfter = false;
+        std::size_t lineStart = header.find("\r\n") + 2;
+        while (lineStart < header.size()) {
+            const std::size_t lineEnd = header.find("\r\n", lineStart);
+            const std::string_view line = header.substr(lineStart, lineEnd - lineStart);
+            const std::size_t colon = line.find(':');
+            if (colon != std::string_view::npos) {
+                std::string name(line.substr(0, colon));
+                std::transform(name.begin(), name.end(), name.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+                std::string_view value = line.substr(colon + 1);
+                value.remove_prefix(std::min(value.find_first_not_of(' '), value.size()));
+                if (name == "content-length") {
+                    connection.bodyRemaining = static_cast<std::size_t>(std::strtoull(value.data(), nullptr, 10));
+                } else if (name == "connection") {
+                    connection.closeAfter = value.substr(0, 5) == "close";
+                }
+            }
+            lineStart = lineEnd + 2;
+        }
+        return true;
+    }
+
+    bool complete(std::size_t index) {
+        Connection& connection = connections_[index];
+        connection.inBody = false;
+        const std::uint64_t now = nowNs();
+        if (!connection.inflight.empty()) {
+            stats.latency->record(now - connection.inflight.front());
+            connection.inflight.pop_front();
+        }
+        ++stats.responses;
+        if (connection.status < 200 || connection.status >= 400) {
+            ++stats.badStatus;
+        }
+        if (connection.closeAfter || !options_.keepAlive) {
+            stats.socketErrors += connection.inflight.size();
+            (void)connect(index);
+            resume(index);
+            return false;
+        }
+        resume(index);
+        return true;
+    }
+
+    // Sends whatever the connection may send next: queued slots (open loop)
+    // or a refill of the pipeline (closed loop).
+    void resume(std::size_t index) {
+        Connection& connection = connections_[index];
+        if (!connection.socket.isValid()) {
+            return;
+        }
+        if (interval_ == 0) {
+            fill(index);
+            return;
+        }
+        while (!connection.owed.empty() && connection.inflight.size() < options_.pipeline) {
+            issue(index, connection.owed.front());
+            connection.owed.pop_front();
+        }
+        flush(index);
+    }
+
+    void fail(std::size_t index) {
+        Connection& connection = connections_[index];
+        stats.socketErrors += std::max<std::size_t>(connection.inflight.size(), 1);
+        if (!connect(index)) {
+            ++stats.socketErrors;
+            return;
+        }
+        resume(index);
+    }
+
+    const Options& options_;
+    Poller poller_;
+    std::vector<Connection> connections_;
+    using Slot = std::pair<std::uint64_t, std::size_t>;
+    std::priority_queue<Slot, std::vector<Slot>, std::greater<>> schedule_;
+    std::uint64_t interval_{0};
+    std::uint64_t quota_;
+    std::uint64_t issued_{0};
+    std::uint64_t end_{0};
+    std::uint64_t rng_;
+    std::uint64_t totalWeight_{0};
+    char buffer_[64 * 1024];
+};
+
+void printUsage() {
+    std::cerr << "Usage: http-bench [options] [path[:weight] ...]\n"
+                 "  --host <addr>         server address (default 127.0.0.1)\n"
+                 "  --port <num>          server port (default 8080)\n"
+                 "  --threads <num>       client threads (default 2)\n"
+                 "  --connections <num>   connections across all threads (default 64)\n"
+                 "  --pipeline <num>      requests in flight per connection (default 1)\n"
+                 "  --no-keepalive        one request per connection\n"
+                 "  --rate <req/s>        open-loop total request rate (default: closed loop)\n"
+                 "  --duration <s>        run time (default 10)\n"
+                 "  --requests <num>      stop after this many requests\n"
+                 "  --hdr <file>          write the latency percentile distribution (HdrHistogram format)\n"
+                 "Paths default to /index.html; weights set the URL mix.\n";
+}
+
+double toMs(std::uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+void writeDistribution(const std::string& path, const HistogramSnapshot& latency) {
+    std::ofstream out(path);
+    char line[128];
+    std::snprintf(line, sizeof(line), "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount",
+                  "1/(1-Percentile)");
+    out << line;
+    std::uint64_t cumulative = 0;
+    double squares = 0;
+    for (std::size_t i = 0; i < latency.counts.size(); ++i) {
+        if (latency.counts[i] == 0) {
+            continue;
+        }
+        cumulative += latency.counts[i];
+        const double value = toMs(Histogram::highestValueIn(i));
+        const double fraction = static_cast<double>(cumulative) / static_cast<double>(latency.total);
+        squares += static_cast<double>(latency.counts[i]) * std::pow(value - latency.mean() / 1e6, 2);
+        if (fraction < 1.0) {
+            std::snprintf(line, sizeof(line), "%12.3f %14.12f %10llu %14.2f\n", value, fraction,
+                          static_cast<unsigned long long>(cumulative), 1.0 / (1.0 - fraction));
+        } else {
+            std::snprintf(line, sizeof(line), "%12.3f %14.12f %10llu\n", value, fraction,
+                          static_cast<unsigned long long>(cumulative));
+        }
+        out << line;
+    }
+    const double deviation = latency.total == 0 ? 0 : std::sqrt(squares / static_cast<double>(latency.total));
+    std::snprintf(line, sizeof(line), "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", latency.mean() / 1e6,
+                  deviation);
+    out << line;
+    std::snprintf(line, sizeof(line), "#[Max     = %12.3f, Total count    = %12llu]\n", toMs(latency.max()),
+                  static_cast<unsigned long long>(latency.total));
+    out << line;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    try {
+        for (int i = 1; i < argc; ++i) {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+            if (arg == "--host" && hasValue) {
+                options.host = argv[++i];
+            } else if (arg == "--port" && hasValue) {
+                options.port = std::stoi(argv[++i]);
+            } else if (arg == "--threads" && hasValue) {
+                options.threads = std::max<std::size_t>(1, std::stoull(argv[++i]));
+            } else if (arg == "--connections" && hasValue) {
+                options.connections = std::max<std::size_t>(1, std::stoull(argv[++i]));
+            } else if (arg == "--pipeline" && hasValue) {
+                options.pipeline = std::max<std::size_t>(1, std::stoull(argv[++i]));
+            } else if (arg == "--no-keepalive") {
+                options.keepAlive = false;
+            } else if (arg == "--rate" && hasValue) {
+                options.rate = std::stod(argv[++i]);
+            } else if (arg == "--duration" && hasValue) {
+                options.durationSeconds = std::stod(argv[++i]);
+            } else if (arg == "--requests" && hasValue) {
+                options.requests = std::stoull(argv[++i]);
+            } else if (arg == "--hdr" && hasValue) {
+                options.hdrPath = argv[++i];
+            } else if (!arg.empty() && arg[0] == '/') {
+                Target target;
+                const std::size_t colon = arg.rfind(':');
+                target.path = arg.substr(0, colon);
+                if (colon != std::string::npos) {
+                    target.weight = static_cast<unsigned>(std::max(1, std::stoi(arg.substr(colon + 1))));
+                }
+                options.targets.push_back(std::move(target));
+            } else {
+                printUsage();
+                return 1;
+            }
+        }
+    } catch (const std::exception&) {
+        printUsage();
+        return 1;
+    }
+    if (options.targets.empty()) {
+        options.targets.push_back(Target{"/index.html", 1, ""});
+    }
+    if (!options.keepAlive) {
+        options.pipeline = 1;
+    }
+    options.threads = std::min(options.threads, options.connections);
+    const std::string hostHeader = options.host + ":" + std::to_string(options.port);
+    for (Target& target : options.targets) {
+        target.request = "GET " + target.path + " HTTP/1.1\r\nHost: " + hostHeader +
+                         (options.keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (std::size_t t = 0; t < options.threads; ++t) {
+        const std::size_t connections =
+            options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        const std::uint64_t quota =
+            options.requests == 0 ? 0 : options.requests / options.threads + (t < options.requests % options.threads);
+        workers.push_back(std::make_unique<Worker>(options, connections, quota, 0x9e3779b97f4a7c15ULL * (t + 1)));
+    }
+
+    std::printf("Running %.1fs test @ %s (%zu threads, %zu connections, pipeline %zu, %s)\n",
+                options.durationSeconds, hostHeader.c_str(), options.threads, options.connections, options.pipeline,
+                options.rate > 0 ? ("open loop at " + std::to_string(static_cast<long long>(options.rate)) + " req/s")
+                                       .c_str()
+                                 : "closed loop");
+
+    const std::uint64_t start = nowNs();
+    const std::uint64_t end = start + static_cast<std::uint64_t>(options.durationSeconds * 1e9);
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        threads.emplace_back([&worker, start, end]() { worker->run(start, end); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const double elapsed = static_cast<double>(nowNs() - start) / 1e9;
+
+    HistogramSnapshot latency;
+    Stats total;
+    for (const auto& worker : workers) {
+        worker->stats.latency->addTo(latency);
+        total.responses += worker->stats.responses;
+        total.badStatus += worker->stats.badStatus;
+        total.socketErrors += worker->stats.socketErrors;
+        total.connects += worker->stats.connects;
+        total.bytesRead += worker->stats.bytesRead;
+        total.backlog += worker->stats.backlog;
+    }
+
+    std::printf("  Requests:    %llu in %.2fs, %.1f req/s, %.2f MB/s read\n",
+                static_cast<unsigned long long>(total.responses), elapsed,
+                static_cast<double>(total.responses) / elapsed,
+                static_cast<double>(total.bytesRead) / elapsed / (1024.0 * 1024.0));
+    std::printf("  Errors:      %llu socket, %llu non-2xx/3xx, %llu connects\n",
+                static_cast<unsigned long long>(total.socketErrors), static_cast<unsigned long long>(total.badStatus),
+                static_cast<unsigned long long>(total.connects));
+    if (options.rate > 0) {
+        std::printf("  Unsent:      %llu requests still queued behind the schedule\n",
+                    static_cast<unsigned long long>(total.backlog));
+    }
+    std::printf("  Latency:     mean %.3f ms, max %.3f ms\n", latency.mean() / 1e6, toMs(latency.max()));
+    for (const double p : {50.0, 75.0, 90.0, 99.0, 99.9, 99.99}) {
+        std::printf("    %7.3f%%  %10.3f ms\n", p, toMs(latency.percentile(p)));
+    }
+
+    if (!options.hdrPath.empty()) {
+        writeDistribution(options.hdrPath, latency);
+        std::printf("  Percentile distribution written to %s\n", options.hdrPath.c_str());
+    }
+    return total.responses == 0 ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "threadpool/WorkStealingQueue.h"
+
+// Owner/thief stress run that doubles as a throughput comparison between the
+// lock-free deque and the mutex-guarded deque it replaced. Every task must run
+// exactly once; any loss or duplication fails the run.
+namespace {
+
+class MutexQueue {
+public:
+    void push(threadpool::Task task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+
+    std::optional<threadpool::Task> pop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return std::nullopt;
+        }
+        threadpool::Task task = std::move(tasks_.back());
+        tasks_.pop_back();
+        return task;
+    }
+
+    std::optional<threadpool::Task> steal() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return std::nullopt;
+        }
+        threadpool::Task task = std::move(tasks_.front());
+        tasks_.pop_front();
+        return task;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<threadpool::Task> tasks_;
+};
+
+struct RunResult {
+    double seconds{0};
+    std::size_t stolen{0};
+    bool valid{true};
+};
+
+template <typename Queue>
+RunResult runOnce(std::size_t taskCount, std::size_t thieves, std::size_t burst) {
+    Queue queue;
+    std::vector<std::atomic<unsigned>> hits(taskCount);
+    std::atomic<std::size_t> completed{0};
+    std::atomic<std::size_t> stolen{0};
+    std::atomic<bool> done{false};
+
+    auto makeTask = [&](std::size_t i) {
+        return threadpool::Task([&hits, &completed, i]() {
+            hits[i].fetch_add(1, std::memory_order_relaxed);
+            completed.fetch_add(1, std::memory_order_relaxed);
+        });
+    };
+
+    std::vector<std::thread> thiefThreads;
+    for (std::size_t t = 0; t < thieves; ++t) {
+        thiefThreads.emplace_back([&]() {
+            std::size_t local = 0;
+            while (!done.load(std::memory_order_acquire)) {
+                auto task = queue.steal();
+                if (task) {
+                    (*task)();
+                    ++local;
+                }
+            }
+            stolen.fetch_add(local, std::memory_order_relaxed);
+        });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::size_t next = 0;
+    while (next < taskCount) {
+        for (std::size_t i = 0; i < burst && next < taskCount; ++i) {
+            queue.push(makeTask(next++));
+        }
+        for (std::size_t i = 0; i < burst / 2; ++i) {
+            auto task = queue.pop();
+            if (!task) {
+                break;
+            }
+            (*task)();
+        }
+    }
+    while (auto task = queue.pop()) {
+        (*task)();
+    }
+    while (completed.load(std::memory_order_acquire) < taskCount) {
+        std::this_thread::yield();
+    }
+    const auto end = std::chrono::steady_clock::now();
+
+    done.store(true, std::memory_order_release);
+    for (auto& thread : thiefThreads) {
+        thread.join();
+    }
+
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(end - start).count();
+    result.stolen = stolen.load();
+    for (const auto& hit : hits) {
+        if (hit.load() != 1) {
+            result.valid = false;
+            break;
+        }
+    }
+    return result;
+}
+
+template <typename Queue>
+bool report(const char* name, std::size_t taskCount, std::size_t thieves, std::size_t burst, std::size_t rounds) {
+    double best = 0;
+    std::size_t stolen = 0;
+    for (std::size_t r = 0; r < rounds; ++r) {
+        const RunResult result = runOnce<Queue>(taskCount, thieves, burst);
+        if (!result.valid) {
+            std::cerr << name << ": task lost or executed twice in round " << r << "\n";
+            return false;
+        }
+        const double rate = static_cast<double>(taskCount) / result.seconds;
+        if (rate > best) {
+            best = rate;
+            stolen = result.stolen;
+        }
+    }
+    std::cout << name << ": " << static_cast<std::size_t>(best) << " tasks/s (" << stolen << " stolen of "
+              << taskCount << ")\n";
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t taskCount = 1000000;
+    std::size_t thieves = 3;
+    std::size_t burst = 64;
+    std::size_t rounds = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--tasks" && i + 1 < argc) {
+            taskCount = static_cast<std::size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--thieves" && i + 1 < argc) {
+            thieves = static_cast<std::size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--burst" && i + 1 < argc) {
+            burst = static_cast<std::size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--rounds" && i + 1 < argc) {
+            rounds = static_cast<std::size_t>(std::stoull(argv[++i]));
+        }
+    }
+
+    std::cout << "tasks=" << taskCount << " thieves=" << thieves << " burst=" << burst << " rounds=" << rounds
+              << "\n";
+    const bool ok = report<threadpool::WorkStealingQueue>("chase-lev", taskCount, thieves, burst, rounds) &&
+                    report<MutexQueue>("mutex", taskCount, thieves, burst, rounds);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+"""Compare a micro-bench run against a saved baseline.
+
+Both files are Google Benchmark JSON output:
+
+    ./micro-bench --benchmark_out=baseline.json --benchmark_out_format=json
+    ./micro-bench --benchmark_out=current.json --benchmark_out_format=json
+    scripts/compare_bench.py baseline.json current.json
+
+With --benchmark_repetitions the median aggregate is compared. Exits with
+status 1 when any benchmark is slower than the baseline by more than
+--threshold percent.
+"""
+
+import argparse
+import json
+import sys
+
+NANOS_PER_UNIT = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load(path, metric):
+    with open(path) as f:
+        data = json.load(f)
+    plain = {}
+    medians = {}
+    for bench in data.get("benchmarks", []):
+        if bench.get("error_occurred"):
+            continue
+        name = bench.get("run_name", bench["name"])
+        value = bench[metric] * NANOS_PER_UNIT[bench.get("time_unit", "ns")]
+        if bench.get("run_type") == "aggregate":
+            if bench.get("aggregate_name") == "median":
+                medians[name] = value
+        else:
+            # Repetitions without aggregates: keep the fastest.
+            plain[name] = min(plain.get(name, value), value)
+    plain.update(medians)
+    return plain
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline")
+    parser.add_argument("current")
+    parser.add_argument("--threshold", type=float, default=5.0, help="allowed slowdown in percent (default 5)")
+    parser.add_argument("--metric", choices=["real_time", "cpu_time"], default="real_time")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline, args.metric)
+    current = load(args.current, args.metric)
+
+    width = max((len(name) for name in current), default=20)
+    print(f"{'Benchmark':<{width}}  {'Baseline ns':>12}  {'Current ns':>12}  {'Change':>8}")
+    regressions = []
+    for name, value in current.items():
+        if name not in baseline:
+            print(f"{name:<{width}}  {'-':>12}  {value:>12.1f}  {'new':>8}")
+            continue
+        before = baseline[name]
+        change = (value - before) / before * 100.0 if before > 0 else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        print(f"{name:<{width}}  {before:>12.1f}  {value:>12.1f}  {change:>+7.1f}%{flag}")
+    for name in baseline:
+        if name not in current:
+            print(f"{name:<{width}}  {baseline[name]:>12.1f}  {'-':>12}  {'missing':>8}")
+
+    if regressions:
+        print(f"\n{len(regressions)} benchmark(s) slower than baseline by more than {args.threshold:g}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
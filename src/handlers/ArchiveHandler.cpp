@@ -0,0 +1,80 @@
+#include "handlers/ArchiveHandler.h"
+
+#include "handlers/ErrorHandler.h"
+#include "http/HttpConstants.h"
+
+ArchiveHandler::ArchiveHandler(std::string archivePath)
+    : archivePath_(std::move(archivePath)),
+      archive_(std::make_shared<const DocrootArchive>(archivePath_)) {}
+
+void ArchiveHandler::reload() {
+    auto next = std::make_shared<const DocrootArchive>(archivePath_);
+    std::atomic_store(&archive_, std::shared_ptr<const DocrootArchive>(std::move(next)));
+}
+
+http::HttpResponse ArchiveHandler::handle(const http::HttpRequest& request) {
+    if (request.method != "GET" && request.method != "HEAD") {
+        return handlers::create405();
+    }
+
+    std::string_view path;
+    if (!normalizePath(request.uri, path)) {
+        return handlers::create404();
+    }
+
+    const std::shared_ptr<const DocrootArchive> archive = std::atomic_load(&archive_);
+    ArchivedFile file;
+    if (!archive->lookup(path, file)) {
+        return handlers::create404();
+    }
+
+    std::string_view content = file.content;
+    std::pmr::string etag(file.etag, request.resource());
+    const bool useGzip =
+        !file.gzipContent.empty() && request.getHeader("accept-encoding").find("gzip") != std::string_view::npos;
+    if (useGzip) {
+        content = file.gzipContent;
+        if (etag.size() >= 2) {
+            etag.insert(etag.size() - 1, "-gz");
+        }
+    }
+
+    http::HttpResponse resp(request.resource());
+    resp.setContentType(file.mimeType);
+    resp.setHeader("ETag", etag);
+    resp.setHeader("Connection", request.isKeepAlive() ? "keep-alive" : "close");
+    if (!file.gzipContent.empty()) {
+        resp.setHeader("Vary", "Accept-Encoding");
+    }
+    if (useGzip) {
+        resp.setHeader("Content-Encoding", "gzip");
+    }
+
+    if (!etag.empty() && request.getHeader("if-none-match") == etag) {
+        resp.setStatus(http::HTTP_NOT_MODIFIED, "Not Modified");
+        resp.setHeader("Content-Length", std::to_string(content.size()));
+        return resp;
+    }
+
+    resp.setStatus(http::HTTP_OK, "OK");
+    resp.setHeader("Content-Length", std::to_string(content.size()));
+    if (request.method != "HEAD") {
+        resp.setBodyView(content, archive);
+    }
+    return resp;
+}
+
+bool ArchiveHandler::normalizePath(std::string_view uri, std::string_view& outPath) {
+    const std::size_t q = uri.find('?');
+    if (q != std::string_view::npos) {
+        uri = uri.substr(0, q);
+    }
+    if (uri.find("..") != std::string_view::npos) {
+        return false;
+    }
+    while (!uri.empty() && uri.front() == '/') {
+        uri.remove_prefix(1);
+    }
+    outPath = uri;
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "handlers/RequestHandler.h"
+#include "utils/DocrootArchive.h"
+
+class ArchiveHandler : public RequestHandler {
+public:
+    explicit ArchiveHandler(std::string archivePath);
+
+    http::HttpResponse handle(const http::HttpRequest& request) override;
+    // Everything is served from the mapped archive.
+    std::optional<http::HttpResponse> handleNonBlocking(const http::HttpRequest& request) override {
+        return handle(request);
+    }
+    void reload();
+
+private:
+    static bool normalizePath(std::string_view uri, std::string_view& outPath);
+
+    std::string archivePath_;
+    std::shared_ptr<const DocrootArchive> archive_;
+};
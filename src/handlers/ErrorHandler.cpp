@@ -42,4 +42,30 @@ http::HttpResponse create500(const std::string& error) {
     return resp;
 }
 
+http::HttpResponse create502(const std::string& error) {
+    http::HttpResponse resp;
+    resp.setStatus(502, "Bad Gateway");
+    resp.setContentType("text/html");
+    resp.setBody("<html><body><h1>502 Bad Gateway</h1><p>" + error + "</p></body></html>");
+    return resp;
+}
+
+http::HttpResponse create503(int retryAfterSeconds) {
+    http::HttpResponse resp;
+    resp.setStatus(503, "Service Unavailable");
+    resp.setContentType("text/html");
+    resp.setHeader("Retry-After", std::to_string(retryAfterSeconds));
+    resp.setHeader("Connection", "close");
+    resp.setBody("<html><body><h1>503 Service Unavailable</h1></body></html>");
+    return resp;
+}
+
+http::HttpResponse create504() {
+    http::HttpResponse resp;
+    resp.setStatus(504, "Gateway Timeout");
+    resp.setContentType("text/html");
+    resp.setBody("<html><body><h1>504 Gateway Timeout</h1></body></html>");
+    return resp;
+}
+
 }  // namespace handlers
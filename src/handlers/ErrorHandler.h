@@ -11,5 +11,8 @@ http::HttpResponse create404();
 http::HttpResponse create405();
 http::HttpResponse create429();
 http::HttpResponse create500(const std::string& error);
+http::HttpResponse create502(const std::string& error);
+http::HttpResponse create503(int retryAfterSeconds);
+http::HttpResponse create504();
 
 }  // namespace handlers
@@ -3,9 +3,26 @@
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
+#include <sys/stat.h>
 
 #include "handlers/ErrorHandler.h"
 #include "http/HttpConstants.h"
+#include "utils/RequestTrace.h"
+
+namespace {
+
+FileStamp stampOf(const struct stat& info) {
+#if defined(__APPLE__)
+    const struct timespec& mtime = info.st_mtimespec;
+#else
+    const struct timespec& mtime = info.st_mtim;
+#endif
+    return {static_cast<std::uint64_t>(info.st_dev), static_cast<std::uint64_t>(info.st_ino),
+            static_cast<std::uint64_t>(info.st_size),
+            static_cast<std::int64_t>(mtime.tv_sec) * 1000000000 + mtime.tv_nsec};
+}
+
+}  // namespace
 
 FileHandler::FileHandler(std::string docRoot, FileCache* cache)
     : docRoot_(std::move(docRoot)), cache_(cache) {
@@ -13,6 +30,10 @@ FileHandler::FileHandler(std::string docRoot, FileCache* cache)
         std::filesystem::create_directories(docRoot_);
     }
     canonicalDocRoot_ = std::filesystem::weakly_canonical(docRoot_);
+    cacheKeyPrefix_ = canonicalDocRoot_.string();
+    if (cacheKeyPrefix_.empty() || cacheKeyPrefix_.back() != '/') {
+        cacheKeyPrefix_ += '/';
+    }
 }
 
 http::HttpResponse FileHandler::handle(const http::HttpRequest& request) {
@@ -21,37 +42,49 @@ http::HttpResponse FileHandler::handle(const http::HttpRequest& request) {
     }
 
     std::filesystem::path path;
-    if (!sanitizeAndResolvePath(request.uri, path)) {
-        return handlers::create404();
-    }
-
-    if (std::filesystem::is_directory(path)) {
-        path /= "index.html";
-    }
+    std::string pathKey;
+    std::string mimeType;
+    FileStamp stamp;
+    {
+        PhaseTimer timer(request.trace, Phase::Resolve);
+        if (!sanitizeAndResolvePath(request.uri, path)) {
+            return notFound();
+        }
 
-    if (!std::filesystem::exists(path) || !std::filesystem::is_regular_file(path)) {
-        return handlers::create404();
-    }
+        if (std::filesystem::is_directory(path)) {
+            path /= "index.html";
+        }
 
-    std::error_code ec;
-    const auto fileSize = std::filesystem::file_size(path, ec);
-    if (ec || fileSize > maxFileSize_) {
-        return handlers::create500("File too large or unreadable");
+        pathKey = path.string();
+        struct stat info{};
+        if (::stat(pathKey.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+            if (cache_ != nullptr) {
+                cache_->erase(pathKey);
+            }
+            return notFound();
+        }
+        if (static_cast<std::uint64_t>(info.st_size) > maxFileSize_) {
+            return handlers::create500("File too large or unreadable");
+        }
+        stamp = stampOf(info);
+        mimeType = detectMimeType(path);
     }
 
-    const std::string pathKey = path.string();
-    std::string content;
-    std::string mimeType = detectMimeType(path);
-
+    std::shared_ptr<const std::string> content;
     if (cache_ != nullptr) {
+        PhaseTimer timer(request.trace, Phase::Cache);
         auto cached = cache_->get(pathKey);
-        if (cached.has_value()) {
+        // A stale entry is replaced by the read below.
+        if (cached.has_value() && cached->stamp == stamp) {
             content = std::move(cached->content);
             mimeType = std::move(cached->mimeType);
+            cache_->markVerified(pathKey);
+            count(cacheHitsMetric_);
         }
     }
 
-    if (content.empty()) {
+    if (content == nullptr || content->empty()) {
+        PhaseTimer timer(request.trace, Phase::Disk);
         std::ifstream file(path, std::ios::binary);
         if (!file.is_open()) {
             return handlers::create500("Could not open file");
@@ -59,43 +92,115 @@ http::HttpResponse FileHandler::handle(const http::HttpRequest& request) {
 
         std::ostringstream buffer;
         buffer << file.rdbuf();
-        content = buffer.str();
+        content = std::make_shared<const std::string>(buffer.str());
+        count(diskReadsMetric_);
+        count(diskBytesMetric_, content->size());
 
         if (cache_ != nullptr) {
-            cache_->put(pathKey, content, mimeType);
+            cache_->put(pathKey, content, mimeType, stamp);
         }
     }
 
-    http::HttpResponse resp;
+    return makeResponse(request, std::move(content), mimeType);
+}
+
+std::optional<http::HttpResponse> FileHandler::handleNonBlocking(const http::HttpRequest& request) {
+    if (request.method != "GET" && request.method != "HEAD") {
+        return handlers::create405();
+    }
+    if (cache_ == nullptr) {
+        return std::nullopt;
+    }
+
+    std::pmr::string pathKey(request.resource());
+    {
+        PhaseTimer timer(request.trace, Phase::Resolve);
+        std::string_view cleanUri = request.uri;
+        cleanUri = cleanUri.substr(0, cleanUri.find('?'));
+        if (cleanUri.find("..") != std::string_view::npos) {
+            return notFound();
+        }
+        const std::size_t start = cleanUri.find_first_not_of('/');
+        cleanUri.remove_prefix(start == std::string_view::npos ? cleanUri.size() : start);
+        const bool directory = cleanUri.empty() || cleanUri.back() == '/';
+
+        // Matches the key handle() caches under whenever the path has no
+        // symlinks; anything else simply misses and takes the blocking path.
+        // Already-normal paths are keyed in the request arena without touching
+        // std::filesystem.
+        const bool normal = cleanUri.find("//") == std::string_view::npos &&
+                            cleanUri.find("/./") == std::string_view::npos && cleanUri.rfind("./", 0) != 0 &&
+                            cleanUri != "." && !(cleanUri.size() >= 2 && cleanUri.substr(cleanUri.size() - 2) == "/.");
+        if (normal) {
+            pathKey.reserve(cacheKeyPrefix_.size() + cleanUri.size() + 10);
+            pathKey.append(cacheKeyPrefix_).append(cleanUri);
+            if (directory) {
+                pathKey.append("index.html");
+            }
+        } else {
+            std::string relative(cleanUri);
+            if (directory) {
+                relative += "index.html";
+            }
+            pathKey.assign((canonicalDocRoot_ / relative).lexically_normal().string());
+        }
+    }
+
+    std::optional<CachedFile> cached;
+    {
+        PhaseTimer timer(request.trace, Phase::Cache);
+        cached = cache_->get(pathKey);
+    }
+    // Past the revalidation interval, handle() checks the file first.
+    if (!cached.has_value() || std::chrono::steady_clock::now() - cached->verifiedAt >= kRevalidateAfter) {
+        return std::nullopt;
+    }
+    count(cacheHitsMetric_);
+    return makeResponse(request, std::move(cached->content), cached->mimeType);
+}
+
+void FileHandler::setMetrics(Metrics* metrics) {
+    metrics_ = metrics;
+    if (metrics_ == nullptr) {
+        return;
+    }
+    cacheHitsMetric_ = metrics_->counter("file_handler_cache_hits_total", "Files served from the file cache");
+    diskReadsMetric_ = metrics_->counter("file_handler_disk_reads_total", "Files read from disk");
+    diskBytesMetric_ = metrics_->counter("file_handler_disk_read_bytes_total", "Bytes read from disk");
+    notFoundMetric_ = metrics_->counter("file_handler_not_found_total", "Requests for missing or rejected paths");
+}
+
+http::HttpResponse FileHandler::notFound() const {
+    count(notFoundMetric_);
+    return handlers::create404();
+}
+
+http::HttpResponse FileHandler::makeResponse(const http::HttpRequest& request,
+                                             std::shared_ptr<const std::string> content,
+                                             std::string_view mimeType) const {
+    http::HttpResponse resp(request.resource());
     resp.setStatus(http::HTTP_OK, "OK");
     resp.setContentType(mimeType);
     resp.setHeader("Connection", request.isKeepAlive() ? "keep-alive" : "close");
     if (request.method == "HEAD") {
-        resp.setHeader("Content-Length", std::to_string(content.size()));
+        resp.setHeader("Content-Length", std::to_string(content->size()));
         resp.setBody("");
     } else {
-        resp.setBody(std::move(content));
+        const std::string_view view = *content;
+        resp.setBodyView(view, std::move(content));
     }
     return resp;
 }
 
-bool FileHandler::sanitizeAndResolvePath(const std::string& uri, std::filesystem::path& outPath) const {
-    std::string cleanUri = uri;
-    const std::size_t q = cleanUri.find('?');
-    if (q != std::string::npos) {
-        cleanUri = cleanUri.substr(0, q);
-    }
-
-    if (cleanUri.empty()) {
-        cleanUri = "/";
-    }
-
-    if (cleanUri.find("..") != std::string::npos) {
+bool FileHandler::sanitizeAndResolvePath(std::string_view uri, std::filesystem::path& outPath) const {
+    std::string_view cleanUri = uri.substr(0, uri.find('?'));
+    if (cleanUri.find("..") != std::string_view::npos) {
         return false;
     }
 
+    // An empty or all-slash path names the docroot itself.
     while (!cleanUri.empty() && cleanUri.front() == '/') {
-        cleanUri.erase(cleanUri.begin());
+        cleanUri.remove_prefix(1);
     }
 
     std::filesystem::path candidate = canonicalDocRoot_ / cleanUri;
@@ -1,23 +1,54 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
+#include <memory>
 #include <string>
+#include <string_view>
 
 #include "handlers/RequestHandler.h"
 #include "utils/FileCache.h"
+#include "utils/Metrics.h"
 
 class FileHandler : public RequestHandler {
 public:
     FileHandler(std::string docRoot, FileCache* cache);
 
+    // Stats the file on every request: a missing file is a 404 (and leaves
+    // the cache), and a changed one is read again.
     http::HttpResponse handle(const http::HttpRequest& request) override;
+    // Serves cache hits found by a purely lexical path lookup, without
+    // touching the filesystem, while the entry was checked by handle() less
+    // than kRevalidateAfter ago; older hits go to handle() instead.
+    std::optional<http::HttpResponse> handleNonBlocking(const http::HttpRequest& request) override;
+    // Registers cache hit, disk read and not-found counts; call before serving.
+    void setMetrics(Metrics* metrics);
+
+    // How long a change to a file can go unnoticed by the event-loop fast path.
+    static constexpr std::chrono::seconds kRevalidateAfter{1};
 
 private:
-    bool sanitizeAndResolvePath(const std::string& uri, std::filesystem::path& outPath) const;
+    http::HttpResponse makeResponse(const http::HttpRequest& request, std::shared_ptr<const std::string> content,
+                                    std::string_view mimeType) const;
+    http::HttpResponse notFound() const;
+    void count(Metrics::Id metric, std::uint64_t delta = 1) const {
+        if (metrics_ != nullptr) {
+            metrics_->add(metric, delta);
+        }
+    }
+    bool sanitizeAndResolvePath(std::string_view uri, std::filesystem::path& outPath) const;
     std::string detectMimeType(const std::filesystem::path& path) const;
 
     std::filesystem::path docRoot_;
     std::filesystem::path canonicalDocRoot_;
+    // canonicalDocRoot_ with a trailing '/', for building cache keys.
+    std::string cacheKeyPrefix_;
     FileCache* cache_;
     std::size_t maxFileSize_{10 * 1024 * 1024};
+
+    Metrics* metrics_{nullptr};
+    Metrics::Id cacheHitsMetric_{0};
+    Metrics::Id diskReadsMetric_{0};
+    Metrics::Id diskBytesMetric_{0};
+    Metrics::Id notFoundMetric_{0};
 };
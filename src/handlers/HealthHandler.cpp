@@ -0,0 +1,17 @@
+#include "handlers/HealthHandler.h"
+
+#include <string>
+#include <string_view>
+
+http::HttpResponse HealthHandler::handle(const http::HttpRequest& request) {
+    constexpr std::string_view kBody = "ok\n";
+    http::HttpResponse response(request.resource());
+    response.setContentType("text/plain");
+    response.setHeader("Cache-Control", "no-store");
+    if (request.method == "HEAD") {
+        response.setHeader("Content-Length", std::to_string(kBody.size()));
+    } else {
+        response.setBodyView(kBody, nullptr);
+    }
+    return response;
+}
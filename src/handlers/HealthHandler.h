@@ -0,0 +1,13 @@
+#pragma once
+
+#include "handlers/RequestHandler.h"
+
+// Liveness endpoint for load balancers and orchestrators: 200 "ok" for as
+// long as the server answers requests.
+class HealthHandler : public RequestHandler {
+public:
+    http::HttpResponse handle(const http::HttpRequest& request) override;
+    std::optional<http::HttpResponse> handleNonBlocking(const http::HttpRequest& request) override {
+        return handle(request);
+    }
+};
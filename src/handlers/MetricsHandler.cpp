@@ -0,0 +1,8 @@
+#include "handlers/MetricsHandler.h"
+
+http::HttpResponse MetricsHandler::handle(const http::HttpRequest& request) {
+    http::HttpResponse response(request.resource());
+    response.setContentType("text/plain; version=0.0.4; charset=utf-8");
+    response.setBody(metrics_.render());
+    return response;
+}
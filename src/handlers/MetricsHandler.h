@@ -0,0 +1,19 @@
+#pragma once
+
+#include "handlers/RequestHandler.h"
+#include "utils/Metrics.h"
+
+// Serves the registry in the Prometheus text exposition format.
+class MetricsHandler : public RequestHandler {
+public:
+    explicit MetricsHandler(const Metrics& metrics) : metrics_(metrics) {}
+
+    http::HttpResponse handle(const http::HttpRequest& request) override;
+    // Rendering only sums in-memory shards.
+    std::optional<http::HttpResponse> handleNonBlocking(const http::HttpRequest& request) override {
+        return handle(request);
+    }
+
+private:
+    const Metrics& metrics_;
+};
@@ -0,0 +1,584 @@
+#include "handlers/ProxyHandler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <sys/socket.h>
+
+#include "handlers/ErrorHandler.h"
+#include "threadpool/ThreadPool.h"
+
+namespace {
+
+// A request that failed on a pooled connection or a failed connect is
+// retried on another (or a fresh) connection at most this often.
+constexpr int kMaxAttempts = 3;
+constexpr int kHealthTimeoutSeconds = 2;
+constexpr std::size_t kReadChunk = 16 * 1024;
+// Status line plus headers; anything longer is treated as a broken upstream.
+constexpr std::size_t kMaxHeadSize = 64 * 1024;
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char a, char b) {
+               return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+           });
+}
+
+bool containsToken(std::string_view list, std::string_view token) {
+    while (!list.empty()) {
+        const std::size_t comma = list.find(',');
+        std::string_view item = list.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) {
+            item.remove_suffix(1);
+        }
+        if (equalsIgnoreCase(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        list.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Connection-scoped headers (RFC 9110 section 7.6.1) are never forwarded;
+// the proxy frames bodies itself, so neither is the length.
+bool isHopByHop(std::string_view name) {
+    constexpr std::string_view kNames[] = {"connection", "keep-alive", "proxy-connection", "te",
+                                           "trailer",    "upgrade",    "transfer-encoding", "content-length"};
+    return std::any_of(std::begin(kNames), std::end(kNames),
+                       [name](std::string_view hop) { return equalsIgnoreCase(name, hop); });
+}
+
+bool isIdempotent(std::string_view method) {
+    return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "PUT" || method == "DELETE";
+}
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// False if the connection is gone (reset or closed by the peer).
+bool sendAll(const Socket& connection, std::string_view data) {
+    try {
+        while (!data.empty()) {
+            const ssize_t sent = connection.send(data.data(), data.size());
+            if (sent <= 0) {
+                return false;
+            }
+            data.remove_prefix(static_cast<std::size_t>(sent));
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+// Reads up to `limit` more upstream bytes onto `buffer`: the count, 0 on EOF
+// or a reset, or -1 once the receive timeout expires.
+ssize_t readMore(const Socket& connection, std::string& buffer, std::size_t limit = kReadChunk) {
+    const std::size_t used = buffer.size();
+    buffer.resize(used + limit);
+    ssize_t bytes;
+    try {
+        bytes = connection.recv(buffer.data() + used, limit);
+    } catch (const std::exception&) {
+        bytes = 0;
+    }
+    buffer.resize(used + static_cast<std::size_t>(std::max<ssize_t>(bytes, 0)));
+    return bytes;
+}
+
+// Whether a pooled connection was closed (or sent something unsolicited)
+// while it sat idle; such a connection cannot carry another request.
+bool closedWhileIdle(const Socket& connection) {
+    char byte;
+    const ssize_t bytes = ::recv(connection.getFd(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    return bytes >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+struct StatusLine {
+    bool http11{false};
+    int code{0};
+    std::string_view reason;
+};
+
+bool parseStatusLine(std::string_view line, StatusLine& status) {
+    if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." || line[8] != ' ') {
+        return false;
+    }
+    status.http11 = line[7] == '1';
+    const auto [end, error] = std::from_chars(line.data() + 9, line.data() + 12, status.code);
+    if (error != std::errc() || end != line.data() + 12 || status.code < 100 || status.code > 999) {
+        return false;
+    }
+    status.reason = trim(line.substr(12));
+    return true;
+}
+
+}  // namespace
+
+ProxyHandler::ProxyHandler(ProxyConfig config) : config_(std::move(config)) {
+    if (config_.upstreams.empty()) {
+        throw std::invalid_argument("Proxy " + config_.prefix + " has no upstreams");
+    }
+    for (const std::string& address : config_.upstreams) {
+        const std::size_t colon = address.rfind(':');
+        int port = 0;
+        if (colon != std::string::npos) {
+            const char* last = address.data() + address.size();
+            const auto [end, error] = std::from_chars(address.data() + colon + 1, last, port);
+            if (error != std::errc() || end != last) {
+                port = 0;
+            }
+        }
+        if (colon == std::string::npos || colon == 0 || port <= 0 || port > 65535) {
+            throw std::invalid_argument("Invalid upstream address (expected host:port): " + address);
+        }
+        auto upstream = std::make_unique<Upstream>();
+        upstream->host = address.substr(0, colon);
+        upstream->port = port;
+        upstream->name = address;
+        upstreams_.push_back(std::move(upstream));
+    }
+}
+
+ProxyHandler::~ProxyHandler() {
+    stop();
+}
+
+void ProxyHandler::start() {
+    if (healthThread_.joinable() || config_.healthInterval.count() <= 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(healthMutex_);
+        stopping_ = false;
+    }
+    healthThread_ = std::thread([this]() { runHealthChecks(); });
+}
+
+void ProxyHandler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(healthMutex_);
+        stopping_ = true;
+    }
+    healthWake_.notify_all();
+    if (healthThread_.joinable()) {
+        healthThread_.join();
+    }
+}
+
+void ProxyHandler::registerMetrics(Metrics& metrics, const std::vector<ProxyHandler*>& handlers) {
+    const auto forEach = [&handlers](auto&& fn) {
+        for (ProxyHandler* handler : handlers) {
+            for (auto& upstream : handler->upstreams_) {
+                fn(*upstream, "route=\"" + handler->config_.prefix + "\",upstream=\"" + upstream->name + "\"");
+            }
+        }
+    };
+    forEach([&metrics](Upstream& upstream, const std::string& labels) {
+        upstream.requestsMetric = metrics.counter("proxy_upstream_requests_total", "Requests sent upstream", labels);
+    });
+    forEach([&metrics](Upstream& upstream, const std::string& labels) {
+        upstream.failuresMetric = metrics.counter("proxy_upstream_failures_total",
+                                                  "Upstream connects or exchanges that failed or timed out", labels);
+    });
+    forEach([&metrics](Upstream& upstream, const std::string& labels) {
+        upstream.connectsMetric =
+            metrics.counter("proxy_upstream_connects_total", "New upstream connections (pool misses)", labels);
+    });
+    forEach([&metrics](Upstream& upstream, const std::string& labels) {
+        upstream.healthyMetric =
+            metrics.gauge("proxy_upstream_healthy", "1 while the upstream passes health checks", labels);
+    });
+    for (ProxyHandler* handler : handlers) {
+        handler->metrics_ = &metrics;
+        for (auto& upstream : handler->upstreams_) {
+            if (upstream->healthy.load(std::memory_order_relaxed)) {
+                metrics.add(upstream->healthyMetric);
+            }
+        }
+    }
+}
+
+http::HttpResponse ProxyHandler::handle(const http::HttpRequest& request) {
+    const bool retryAfterSend = isIdempotent(request.method);
+    // The exchange blocks on the upstream; let the pool cover for this worker.
+    threadpool::ThreadPool::BlockingScope blocking;
+
+    for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+        Upstream* upstream = pick();
+        Socket connection(-1);
+        bool reused = false;
+        if (!acquire(*upstream, connection, reused)) {
+            continue;
+        }
+        const std::pmr::string head = buildRequest(request, *upstream);
+
+        upstream->outstanding.fetch_add(1, std::memory_order_relaxed);
+        count(upstream->requestsMetric);
+        http::HttpResponse response(request.resource());
+        bool reusable = false;
+        Exchange result;
+        try {
+            result = exchange(connection, head, request, response, reusable);
+        } catch (const std::exception&) {
+            result = Exchange::Failed;
+        }
+        upstream->outstanding.fetch_sub(1, std::memory_order_relaxed);
+
+        if (result == Exchange::Ok) {
+            if (reusable) {
+                release(*upstream, std::move(connection));
+            }
+            return response;
+        }
+        // A pooled connection the upstream had already closed: nothing was
+        // processed, so the request can go again unless it has side effects.
+        if (result == Exchange::Stale && reused && retryAfterSend) {
+            continue;
+        }
+        count(upstream->failuresMetric);
+        if (result == Exchange::TooLarge) {
+            return handlers::create502("Upstream response exceeds " + std::to_string(config_.maxResponseBody) +
+                                       " bytes");
+        }
+        if (result == Exchange::TimedOut) {
+            // One slow request says little about the upstream; the probes
+            // decide whether it stays in rotation.
+            return handlers::create504();
+        }
+        return handlers::create502("Upstream " + upstream->name + " failed");
+    }
+    return handlers::create502("No upstream reachable");
+}
+
+// The healthy upstream with the fewest requests in flight; the scan starts
+// one further on each call so ties rotate. With none healthy, every upstream
+// is tried in turn rather than failing outright.
+ProxyHandler::Upstream* ProxyHandler::pick() {
+    const std::size_t size = upstreams_.size();
+    const std::size_t start = next_.fetch_add(1, std::memory_order_relaxed);
+    Upstream* best = nullptr;
+    int bestLoad = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        Upstream* candidate = upstreams_[(start + i) % size].get();
+        if (!candidate->healthy.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        const int load = candidate->outstanding.load(std::memory_order_relaxed);
+        if (best == nullptr || load < bestLoad) {
+            best = candidate;
+            bestLoad = load;
+        }
+    }
+    return best != nullptr ? best : upstreams_[start % size].get();
+}
+
+// Borrows the most recently used idle connection, else connects. A refused
+// connect takes the upstream out of rotation until a probe succeeds.
+bool ProxyHandler::acquire(Upstream& upstream, Socket& connection, bool& reused) {
+    {
+        std::lock_guard<std::mutex> lock(upstream.mutex);
+        while (!upstream.idle.empty()) {
+            connection = std::move(upstream.idle.back());
+            upstream.idle.pop_back();
+            if (!closedWhileIdle(connection)) {
+                reused = true;
+                return true;
+            }
+        }
+    }
+
+    reused = false;
+    try {
+        Socket fresh;
+        fresh.connect(upstream.host, upstream.port, config_.timeout);
+        fresh.setNoDelay();
+        fresh.setReceiveTimeoutSeconds(static_cast<int>(config_.timeout.count()));
+        connection = std::move(fresh);
+    } catch (const std::exception&) {
+        count(upstream.failuresMetric);
+        setHealthy(upstream, false);
+        return false;
+    }
+    count(upstream.connectsMetric);
+    return true;
+}
+
+void ProxyHandler::release(Upstream& upstream, Socket connection) {
+    if (!upstream.healthy.load(std::memory_order_relaxed)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(upstream.mutex);
+    if (upstream.idle.size() < config_.maxIdlePerUpstream) {
+        upstream.idle.push_back(std::move(connection));
+    }
+}
+
+void ProxyHandler::setHealthy(Upstream& upstream, bool healthy) {
+    if (upstream.healthy.exchange(healthy, std::memory_order_relaxed) == healthy) {
+        return;
+    }
+    if (metrics_ != nullptr) {
+        if (healthy) {
+            metrics_->add(upstream.healthyMetric);
+        } else {
+            metrics_->subtract(upstream.healthyMetric);
+        }
+    }
+    if (!healthy) {
+        std::vector<Socket> dropped;
+        std::lock_guard<std::mutex> lock(upstream.mutex);
+        dropped.swap(upstream.idle);
+    }
+}
+
+// Request line and headers as the upstream sees them: the URI unchanged,
+// hop-by-hop headers dropped and the body framed by Content-Length. A client
+// that sent no Host gets the upstream's address.
+std::pmr::string ProxyHandler::buildRequest(const http::HttpRequest& request, const Upstream& upstream) const {
+    std::pmr::string head(request.resource());
+    head.reserve(256 + request.uri.size());
+    head.append(request.method).append(" ").append(request.uri).append(" HTTP/1.1\r\n");
+    for (const auto& [key, value] : request.headers) {
+        if (!isHopByHop(key)) {
+            head.append(key).append(": ").append(value).append("\r\n");
+        }
+    }
+    if (!request.hasHeader("host")) {
+        head.append("host: ").append(upstream.name).append("\r\n");
+    }
+    if (!request.body.empty() || request.method == "POST" || request.method == "PUT" || request.method == "PATCH") {
+        head.append("content-length: ").append(std::to_string(request.body.size())).append("\r\n");
+    }
+    head.append("\r\n");
+    return head;
+}
+
+// One request/response round trip. `reusable` is set if the connection can
+// carry another request afterwards.
+ProxyHandler::Exchange ProxyHandler::exchange(Socket& connection, const std::pmr::string& head,
+                                              const http::HttpRequest& request, http::HttpResponse& response,
+                                              bool& reusable) const {
+    if (!sendAll(connection, head) || !sendAll(connection, request.body)) {
+        return Exchange::Stale;
+    }
+
+    std::string buffer;
+    std::size_t headEnd;
+    StatusLine status;
+    // Interim (1xx) responses are consumed and dropped.
+    do {
+        while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+            if (buffer.size() > kMaxHeadSize) {
+                return Exchange::Failed;
+            }
+            const bool first = buffer.empty();
+            const ssize_t bytes = readMore(connection, buffer);
+            if (bytes < 0) {
+                return Exchange::TimedOut;
+            }
+            if (bytes == 0) {
+                return first ? Exchange::Stale : Exchange::Failed;
+            }
+        }
+        if (!parseStatusLine(std::string_view(buffer).substr(0, buffer.find("\r\n")), status)) {
+            return Exchange::Failed;
+        }
+        if (status.code < 200) {
+            buffer.erase(0, headEnd + 4);
+        }
+    } while (status.code < 200);
+
+    response.setStatus(status.code, status.reason);
+    bool closeAfter = !status.http11;
+    bool chunked = false;
+    std::size_t contentLength = 0;
+    bool hasLength = false;
+    std::string_view lines = std::string_view(buffer).substr(0, headEnd + 2);
+    lines.remove_prefix(lines.find("\r\n") + 2);
+    while (!lines.empty()) {
+        const std::size_t eol = lines.find("\r\n");
+        const std::string_view line = lines.substr(0, eol);
+        lines.remove_prefix(eol + 2);
+        const std::size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0) {
+            return Exchange::Failed;
+        }
+        const std::string_view name = line.substr(0, colon);
+        const std::string_view value = trim(line.substr(colon + 1));
+        if (equalsIgnoreCase(name, "connection")) {
+            closeAfter = closeAfter || containsToken(value, "close");
+            if (!status.http11 && containsToken(value, "keep-alive")) {
+                closeAfter = false;
+            }
+        } else if (equalsIgnoreCase(name, "transfer-encoding")) {
+            chunked = containsToken(value, "chunked");
+        } else if (equalsIgnoreCase(name, "content-length")) {
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), contentLength);
+            if (error != std::errc() || end != value.data() + value.size()) {
+                return Exchange::Failed;
+            }
+            hasLength = true;
+        }
+        if (isHopByHop(name)) {
+            continue;
+        }
+        // Repeated fields are joined into one list, as HeaderMap keeps one
+        // value per name. Set-Cookie values may contain commas, so each
+        // keeps its own line.
+        if (equalsIgnoreCase(name, "set-cookie")) {
+            response.addHeader(name, value);
+            continue;
+        }
+        const auto existing = response.headers.find(name);
+        if (existing != response.headers.end()) {
+            existing->second.append(", ").append(value);
+        } else {
+            response.setHeader(name, value);
+        }
+    }
+    buffer.erase(0, headEnd + 4);
+
+    // HEAD keeps the upstream's length; the server would otherwise announce
+    // the empty body.
+    if (request.method == "HEAD" || status.code == 204 || status.code == 304) {
+        if (request.method == "HEAD" && hasLength) {
+            response.setHeader("Content-Length", std::to_string(contentLength));
+        }
+        reusable = !closeAfter && buffer.empty();
+        return Exchange::Ok;
+    }
+
+    std::string& body = response.body;
+    if (chunked) {
+        std::size_t parsed = 0;
+        while (true) {
+            std::size_t eol;
+            while ((eol = buffer.find("\r\n", parsed)) == std::string::npos) {
+                const ssize_t bytes = readMore(connection, buffer);
+                if (bytes <= 0) {
+                    return bytes < 0 ? Exchange::TimedOut : Exchange::Failed;
+                }
+            }
+            std::size_t size = 0;
+            const auto [end, error] = std::from_chars(buffer.data() + parsed, buffer.data() + eol, size, 16);
+            if (error != std::errc() || end == buffer.data() + parsed) {
+                return Exchange::Failed;
+            }
+            parsed = eol + 2;
+            if (size == 0) {
+                break;
+            }
+            if (size > config_.maxResponseBody - body.size()) {
+                return Exchange::TooLarge;
+            }
+            while (buffer.size() < parsed + size + 2) {
+                const ssize_t bytes = readMore(connection, buffer);
+                if (bytes <= 0) {
+                    return bytes < 0 ? Exchange::TimedOut : Exchange::Failed;
+                }
+            }
+            body.append(buffer, parsed, size);
+            buffer.erase(0, parsed + size + 2);
+            parsed = 0;
+        }
+        // Trailer fields are dropped; the message ends at an empty line.
+        while (true) {
+            const std::size_t eol = buffer.find("\r\n", parsed);
+            if (eol == std::string::npos) {
+                const ssize_t bytes = readMore(connection, buffer);
+                if (bytes <= 0) {
+                    return bytes < 0 ? Exchange::TimedOut : Exchange::Failed;
+                }
+                continue;
+            }
+            const bool last = eol == parsed;
+            parsed = eol + 2;
+            if (last) {
+                break;
+            }
+        }
+        reusable = !closeAfter && parsed == buffer.size();
+    } else if (hasLength) {
+        if (contentLength > config_.maxResponseBody) {
+            return Exchange::TooLarge;
+        }
+        // Grown as the bytes arrive, not sized from the header, so an
+        // upstream that announces a large body and stalls holds no more
+        // memory than it has sent.
+        const std::size_t buffered = std::min(buffer.size(), contentLength);
+        body.assign(buffer, 0, buffered);
+        while (body.size() < contentLength) {
+            const ssize_t bytes = readMore(connection, body, std::min(kReadChunk, contentLength - body.size()));
+            if (bytes <= 0) {
+                return bytes < 0 ? Exchange::TimedOut : Exchange::Failed;
+            }
+        }
+        reusable = !closeAfter && buffer.size() == buffered;
+    } else {
+        // No framing: the body runs to the end of the connection.
+        body = std::move(buffer);
+        ssize_t bytes;
+        while ((bytes = readMore(connection, body)) > 0) {
+            if (body.size() > config_.maxResponseBody) {
+                return Exchange::TooLarge;
+            }
+        }
+        if (bytes < 0) {
+            return Exchange::TimedOut;
+        }
+    }
+    return Exchange::Ok;
+}
+
+bool ProxyHandler::probe(const Upstream& upstream) const {
+    try {
+        Socket connection;
+        connection.setReceiveTimeoutSeconds(kHealthTimeoutSeconds);
+        connection.connect(upstream.host, upstream.port, std::chrono::seconds(kHealthTimeoutSeconds));
+        const std::string head = "GET " + config_.healthPath + " HTTP/1.1\r\nhost: " + upstream.name +
+                                 "\r\nconnection: close\r\n\r\n";
+        if (!sendAll(connection, head)) {
+            return false;
+        }
+        std::string buffer;
+        while (buffer.find("\r\n") == std::string::npos) {
+            if (readMore(connection, buffer) <= 0 || buffer.size() > kMaxHeadSize) {
+                return false;
+            }
+        }
+        StatusLine status;
+        return parseStatusLine(std::string_view(buffer).substr(0, buffer.find("\r\n")), status) && status.code < 500;
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+void ProxyHandler::runHealthChecks() {
+    std::unique_lock<std::mutex> lock(healthMutex_);
+    while (!stopping_) {
+        lock.unlock();
+        for (auto& upstream : upstreams_) {
+            setHealthy(*upstream, probe(*upstream));
+        }
+        lock.lock();
+        healthWake_.wait_for(lock, config_.healthInterval, [this]() { return stopping_; });
+    }
+}
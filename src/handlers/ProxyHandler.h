@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "handlers/RequestHandler.h"
+#include "server/Socket.h"
+#include "utils/Metrics.h"
+
+struct ProxyConfig {
+    // Requests for `prefix` or anything below it go to the upstreams, with
+    // the URI unchanged.
+    std::string prefix;
+    // "host:port" of each backend.
+    std::vector<std::string> upstreams;
+    // Idle keep-alive connections kept per upstream.
+    std::size_t maxIdlePerUpstream{32};
+    // Limit on connecting and on the wait between upstream bytes (not on the
+    // whole exchange).
+    std::chrono::seconds timeout{30};
+    // Larger upstream bodies are answered with 502 (see ProxyHandler).
+    std::size_t maxResponseBody{4 * 1024 * 1024};
+    // Probed with GET; any status below 500 counts as healthy.
+    std::string healthPath{"/"};
+    std::chrono::milliseconds healthInterval{2000};
+};
+
+// Reverse proxy to a group of HTTP/1.1 backends. Each upstream keeps a pool
+// of persistent connections that requests borrow, so a proxied request costs
+// no connect() in the steady state. A request goes to the healthy upstream
+// with the fewest requests in flight; a background thread probes every
+// upstream, and one that refuses a connect is taken out until its next
+// successful probe. An exchange that times out is answered 504 and leaves the
+// upstream's health to the probes.
+//
+// Responses are buffered, not streamed: the upstream body (de-chunked) is
+// read into the response and relayed with Content-Length, because handlers
+// hand back a complete HttpResponse that the server serializes once for
+// HTTP/1.1, HTTP/2 and TLS. Bodies above maxResponseBody are refused rather
+// than held in memory, so proxied routes suit API-sized responses; large
+// downloads belong on the docroot or a dedicated proxy.
+class ProxyHandler : public RequestHandler {
+public:
+    // Throws std::invalid_argument on a malformed upstream address.
+    explicit ProxyHandler(ProxyConfig config);
+    ~ProxyHandler() override;
+
+    ProxyHandler(const ProxyHandler&) = delete;
+    ProxyHandler& operator=(const ProxyHandler&) = delete;
+
+    // Blocks on the upstream; runs wherever the server runs blocking handlers.
+    http::HttpResponse handle(const http::HttpRequest& request) override;
+
+    // Health checks run between start() and stop().
+    void start();
+    void stop();
+
+    const std::string& prefix() const { return config_.prefix; }
+
+    // Registers per-upstream series for every handler, grouped by name as
+    // Metrics requires; call once before serving.
+    static void registerMetrics(Metrics& metrics, const std::vector<ProxyHandler*>& handlers);
+
+private:
+    struct Upstream {
+        std::string host;
+        int port{0};
+        std::string name;
+        std::atomic<int> outstanding{0};
+        std::atomic<bool> healthy{true};
+        std::mutex mutex;
+        // Most recently used last; borrowed from the back.
+        std::vector<Socket> idle;
+        Metrics::Id requestsMetric{0};
+        Metrics::Id failuresMetric{0};
+        Metrics::Id connectsMetric{0};
+        Metrics::Id healthyMetric{0};
+    };
+
+    enum class Exchange { Ok, Stale, Failed, TimedOut, TooLarge };
+
+    Upstream* pick();
+    bool acquire(Upstream& upstream, Socket& connection, bool& reused);
+    void release(Upstream& upstream, Socket connection);
+    void setHealthy(Upstream& upstream, bool healthy);
+    Exchange exchange(Socket& connection, const std::pmr::string& head, const http::HttpRequest& request,
+                      http::HttpResponse& response, bool& reusable) const;
+    std::pmr::string buildRequest(const http::HttpRequest& request, const Upstream& upstream) const;
+    bool probe(const Upstream& upstream) const;
+    void runHealthChecks();
+    void count(Metrics::Id metric) const {
+        if (metrics_ != nullptr) {
+            metrics_->add(metric);
+        }
+    }
+
+    ProxyConfig config_;
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    std::atomic<std::size_t> next_{0};
+
+    Metrics* metrics_{nullptr};
+
+    std::mutex healthMutex_;
+    std::condition_variable healthWake_;
+    bool stopping_{false};
+    std::thread healthThread_;
+};
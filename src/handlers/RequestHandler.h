@@ -1,10 +1,16 @@
 #pragma once
 
+#include <optional>
+
 #include "http/HttpRequest.h"
 #include "http/HttpResponse.h"
 
 class RequestHandler {
 public:
     virtual http::HttpResponse handle(const http::HttpRequest& request) = 0;
+    // Answers the request only if that needs no blocking I/O (e.g. a cache
+    // hit); otherwise returns nullopt and the caller runs handle() somewhere
+    // it may block.
+    virtual std::optional<http::HttpResponse> handleNonBlocking(const http::HttpRequest&) { return std::nullopt; }
     virtual ~RequestHandler() = default;
 };
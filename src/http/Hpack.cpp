@@ -0,0 +1,460 @@
+#include "http/Hpack.h"
+
+#include <algorithm>
+#include <iterator>
+
+namespace http {
+namespace {
+
+struct StaticEntry {
+    std::string_view name;
+    std::string_view value;
+};
+
+// RFC 7541 Appendix A.
+constexpr StaticEntry kStaticTable[] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+// RFC 7541 Appendix B, indexed by symbol; 256 is EOS.
+constexpr std::uint32_t kHuffmanCodes[257] = {
+    0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+    0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+    0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+    0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+    0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+    0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+    0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+    0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+    0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+    0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+    0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+    0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+    0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+    0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+    0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+    0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+    0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+    0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+    0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+    0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+    0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+    0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+    0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+    0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+    0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+    0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+    0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+    0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+    0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+    0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+    0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+    0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+    0x3fffffff,
+};
+constexpr std::uint8_t kHuffmanLengths[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+constexpr std::size_t kEntryOverhead = 32;
+constexpr std::size_t kEncoderTableLimit = 4096;
+
+struct HuffmanNode {
+    std::int16_t next[2]{-1, -1};
+    std::int16_t symbol{-1};
+};
+
+// Binary decoding tree built from the code table: 256 symbols plus EOS need
+// 513 nodes.
+const std::vector<HuffmanNode>& huffmanTree() {
+    static const std::vector<HuffmanNode> tree = []() {
+        std::vector<HuffmanNode> nodes(1);
+        nodes.reserve(513);
+        for (std::size_t symbol = 0; symbol < 257; ++symbol) {
+            std::size_t node = 0;
+            for (int bit = kHuffmanLengths[symbol] - 1; bit >= 0; --bit) {
+                const unsigned branch = (kHuffmanCodes[symbol] >> bit) & 1u;
+                if (nodes[node].next[branch] < 0) {
+                    nodes[node].next[branch] = static_cast<std::int16_t>(nodes.size());
+                    nodes.emplace_back();
+                }
+                node = static_cast<std::size_t>(nodes[node].next[branch]);
+            }
+            nodes[node].symbol = static_cast<std::int16_t>(symbol);
+        }
+        return nodes;
+    }();
+    return tree;
+}
+
+bool readString(const std::uint8_t*& pos, const std::uint8_t* end, std::string& out) {
+    if (pos >= end) {
+        return false;
+    }
+    const bool huffman = (*pos & 0x80) != 0;
+    std::uint64_t length = 0;
+    if (!hpack::decodeInteger(pos, end, 7, length) || length > static_cast<std::uint64_t>(end - pos)) {
+        return false;
+    }
+    out.clear();
+    const std::uint8_t* data = pos;
+    pos += length;
+    if (huffman) {
+        return hpack::huffmanDecode(data, static_cast<std::size_t>(length), out);
+    }
+    out.assign(reinterpret_cast<const char*>(data), static_cast<std::size_t>(length));
+    return true;
+}
+
+void writeString(std::string_view value, std::string& out) {
+    const std::size_t huffman = hpack::huffmanLength(value);
+    if (huffman < value.size()) {
+        hpack::encodeInteger(huffman, 7, 0x80, out);
+        hpack::huffmanEncode(value, out);
+    } else {
+        hpack::encodeInteger(value.size(), 7, 0x00, out);
+        out.append(value);
+    }
+}
+
+// Values that differ on almost every response would only churn the table.
+bool worthIndexing(std::string_view name) {
+    return name != "content-length" && name != "date" && name != "etag" && name != "last-modified" &&
+           name != "age" && name != "content-range" && name != "set-cookie";
+}
+
+}  // namespace
+
+namespace hpack {
+
+void encodeInteger(std::uint64_t value, unsigned prefixBits, std::uint8_t firstByte, std::string& out) {
+    const std::uint64_t prefixMax = (1u << prefixBits) - 1;
+    if (value < prefixMax) {
+        out.push_back(static_cast<char>(firstByte | value));
+        return;
+    }
+    out.push_back(static_cast<char>(firstByte | prefixMax));
+    value -= prefixMax;
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+bool decodeInteger(const std::uint8_t*& pos, const std::uint8_t* end, unsigned prefixBits, std::uint64_t& value) {
+    if (pos >= end) {
+        return false;
+    }
+    const std::uint64_t prefixMax = (1u << prefixBits) - 1;
+    value = *pos++ & prefixMax;
+    if (value < prefixMax) {
+        return true;
+    }
+    for (unsigned shift = 0;; shift += 7) {
+        if (pos >= end || shift > 56) {
+            return false;
+        }
+        const std::uint8_t byte = *pos++;
+        value += static_cast<std::uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+}
+
+std::size_t huffmanLength(std::string_view input) {
+    std::size_t bits = 0;
+    for (const char c : input) {
+        bits += kHuffmanLengths[static_cast<std::uint8_t>(c)];
+    }
+    return (bits + 7) / 8;
+}
+
+void huffmanEncode(std::string_view input, std::string& out) {
+    std::uint64_t bits = 0;
+    unsigned pending = 0;
+    for (const char c : input) {
+        const auto symbol = static_cast<std::uint8_t>(c);
+        bits = (bits << kHuffmanLengths[symbol]) | kHuffmanCodes[symbol];
+        pending += kHuffmanLengths[symbol];
+        while (pending >= 8) {
+            pending -= 8;
+            out.push_back(static_cast<char>(bits >> pending));
+        }
+        bits &= (std::uint64_t{1} << pending) - 1;
+    }
+    if (pending > 0) {
+        // Pad with the most significant bits of EOS (all ones).
+        out.push_back(static_cast<char>((bits << (8 - pending)) | (0xffu >> pending)));
+    }
+}
+
+bool huffmanDecode(const std::uint8_t* data, std::size_t size, std::string& out) {
+    const std::vector<HuffmanNode>& tree = huffmanTree();
+    std::size_t node = 0;
+    unsigned padding = 0;
+    bool allOnes = true;
+    for (std::size_t i = 0; i < size; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            const unsigned branch = (data[i] >> bit) & 1u;
+            const std::int16_t next = tree[node].next[branch];
+            if (next < 0) {
+                return false;
+            }
+            node = static_cast<std::size_t>(next);
+            ++padding;
+            allOnes = allOnes && branch == 1;
+            const std::int16_t symbol = tree[node].symbol;
+            if (symbol >= 0) {
+                if (symbol == 256) {
+                    return false;
+                }
+                out.push_back(static_cast<char>(symbol));
+                node = 0;
+                padding = 0;
+                allOnes = true;
+            }
+        }
+    }
+    return padding <= 7 && allOnes;
+}
+
+}  // namespace hpack
+
+void HpackTable::add(std::string_view name, std::string_view value) {
+    const std::size_t entrySize = name.size() + value.size() + kEntryOverhead;
+    if (entrySize > maxSize_) {
+        evictTo(0);
+        return;
+    }
+    evictTo(maxSize_ - entrySize);
+    entries_.push_front(HeaderField{std::string(name), std::string(value)});
+    size_ += entrySize;
+}
+
+void HpackTable::setMaxSize(std::size_t maxSize) {
+    maxSize_ = maxSize;
+    evictTo(maxSize);
+}
+
+void HpackTable::evictTo(std::size_t size) {
+    while (size_ > size && !entries_.empty()) {
+        const HeaderField& oldest = entries_.back();
+        size_ -= oldest.name.size() + oldest.value.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+bool HpackDecoder::lookup(std::uint64_t index, std::string_view& name, std::string_view& value) const {
+    if (index == 0) {
+        return false;
+    }
+    if (index <= std::size(kStaticTable)) {
+        name = kStaticTable[index - 1].name;
+        value = kStaticTable[index - 1].value;
+        return true;
+    }
+    const std::uint64_t dynamicIndex = index - std::size(kStaticTable) - 1;
+    if (dynamicIndex >= table_.count()) {
+        return false;
+    }
+    const HeaderField& entry = table_.at(static_cast<std::size_t>(dynamicIndex));
+    name = entry.name;
+    value = entry.value;
+    return true;
+}
+
+bool HpackDecoder::decode(const std::uint8_t* data, std::size_t size, std::vector<HeaderField>& out,
+                          std::size_t maxListSize) {
+    const std::uint8_t* pos = data;
+    const std::uint8_t* const end = data + size;
+    std::size_t listSize = 0;
+    bool fieldSeen = false;
+    std::string name;
+    std::string value;
+    while (pos < end) {
+        const std::uint8_t first = *pos;
+        std::uint64_t index = 0;
+        if ((first & 0x80) != 0) {
+            // Indexed field.
+            std::string_view indexedName;
+            std::string_view indexedValue;
+            if (!hpack::decodeInteger(pos, end, 7, index) || !lookup(index, indexedName, indexedValue)) {
+                return false;
+            }
+            name.assign(indexedName);
+            value.assign(indexedValue);
+        } else if ((first & 0xe0) == 0x20) {
+            // Table size update; only allowed before the first field.
+            if (fieldSeen || !hpack::decodeInteger(pos, end, 5, index) || index > maxTableSize_) {
+                return false;
+            }
+            table_.setMaxSize(static_cast<std::size_t>(index));
+            continue;
+        } else {
+            // Literal: with incremental indexing (01), without (0000) or
+            // never indexed (0001).
+            const bool indexing = (first & 0x40) != 0;
+            if (!hpack::decodeInteger(pos, end, indexing ? 6 : 4, index)) {
+                return false;
+            }
+            if (index != 0) {
+                std::string_view indexedName;
+                std::string_view ignored;
+                if (!lookup(index, indexedName, ignored)) {
+                    return false;
+                }
+                name.assign(indexedName);
+            } else if (!readString(pos, end, name)) {
+                return false;
+            }
+            if (!readString(pos, end, value)) {
+                return false;
+            }
+            if (indexing) {
+                table_.add(name, value);
+            }
+        }
+        fieldSeen = true;
+        listSize += name.size() + value.size() + kEntryOverhead;
+        if (listSize > maxListSize) {
+            return false;
+        }
+        out.push_back(HeaderField{name, value});
+    }
+    return true;
+}
+
+void HpackEncoder::setMaxTableSize(std::size_t maxSize) {
+    const std::size_t size = std::min(maxSize, kEncoderTableLimit);
+    if (size != table_.maxSize()) {
+        table_.setMaxSize(size);
+        sizeUpdatePending_ = true;
+    }
+}
+
+// A pending size update is emitted before the first field encoded after
+// setMaxTableSize(), which is always the start of a block: settings are only
+// applied between blocks.
+void HpackEncoder::encode(std::string_view name, std::string_view value, std::string& out) {
+    if (sizeUpdatePending_) {
+        hpack::encodeInteger(table_.maxSize(), 5, 0x20, out);
+        sizeUpdatePending_ = false;
+    }
+
+    std::size_t nameIndex = 0;
+    for (std::size_t i = 0; i < std::size(kStaticTable); ++i) {
+        if (kStaticTable[i].name != name) {
+            continue;
+        }
+        if (kStaticTable[i].value == value) {
+            hpack::encodeInteger(i + 1, 7, 0x80, out);
+            return;
+        }
+        if (nameIndex == 0) {
+            nameIndex = i + 1;
+        }
+    }
+    for (std::size_t i = 0; i < table_.count(); ++i) {
+        const HeaderField& entry = table_.at(i);
+        if (entry.name != name) {
+            continue;
+        }
+        if (entry.value == value) {
+            hpack::encodeInteger(std::size(kStaticTable) + i + 1, 7, 0x80, out);
+            return;
+        }
+        if (nameIndex == 0) {
+            nameIndex = std::size(kStaticTable) + i + 1;
+        }
+    }
+
+    const bool indexing = worthIndexing(name);
+    hpack::encodeInteger(nameIndex, indexing ? 6 : 4, indexing ? 0x40 : 0x00, out);
+    if (nameIndex == 0) {
+        writeString(name, out);
+    }
+    writeString(value, out);
+    if (indexing) {
+        table_.add(name, value);
+    }
+}
+
+}  // namespace http
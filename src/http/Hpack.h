@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http {
+
+struct HeaderField {
+    std::string name;
+    std::string value;
+};
+
+// HPACK dynamic table (RFC 7541 section 2.3.2): newest entry first, sized as
+// name + value + 32 bytes per entry, oldest entries evicted to fit.
+class HpackTable {
+public:
+    explicit HpackTable(std::size_t maxSize) : maxSize_(maxSize) {}
+
+    void add(std::string_view name, std::string_view value);
+    void setMaxSize(std::size_t maxSize);
+    std::size_t maxSize() const { return maxSize_; }
+    std::size_t count() const { return entries_.size(); }
+    // 0-based, newest first.
+    const HeaderField& at(std::size_t index) const { return entries_[index]; }
+
+private:
+    void evictTo(std::size_t size);
+
+    std::deque<HeaderField> entries_;
+    std::size_t size_{0};
+    std::size_t maxSize_;
+};
+
+// Decodes header blocks from one peer; the dynamic table persists across
+// blocks, so every block on the connection must go through decode(), in
+// order, even for streams that are refused.
+class HpackDecoder {
+public:
+    // `maxTableSize` is the SETTINGS_HEADER_TABLE_SIZE we advertised.
+    explicit HpackDecoder(std::size_t maxTableSize = 4096) : table_(maxTableSize), maxTableSize_(maxTableSize) {}
+
+    // Appends the block's fields to `out`. Returns false on a malformed block
+    // or once the decoded list exceeds `maxListSize` (name + value + 32 per
+    // field); both are connection errors (COMPRESSION_ERROR).
+    bool decode(const std::uint8_t* data, std::size_t size, std::vector<HeaderField>& out,
+                std::size_t maxListSize = 64 * 1024);
+
+private:
+    // 1-based across the static table, then the dynamic table.
+    bool lookup(std::uint64_t index, std::string_view& name, std::string_view& value) const;
+
+    HpackTable table_;
+    std::size_t maxTableSize_;
+};
+
+// Encodes header blocks for one peer. Fields found in the static or dynamic
+// table are sent as an index; others are added to the dynamic table unless
+// their values change per response. Strings are Huffman-coded when shorter.
+class HpackEncoder {
+public:
+    HpackEncoder() : table_(4096) {}
+
+    // From the peer's SETTINGS_HEADER_TABLE_SIZE; announced at the start of
+    // the next block.
+    void setMaxTableSize(std::size_t maxSize);
+    void encode(std::string_view name, std::string_view value, std::string& out);
+
+private:
+    HpackTable table_;
+    bool sizeUpdatePending_{false};
+};
+
+namespace hpack {
+
+void encodeInteger(std::uint64_t value, unsigned prefixBits, std::uint8_t firstByte, std::string& out);
+// Returns false on truncation or overflow.
+bool decodeInteger(const std::uint8_t*& pos, const std::uint8_t* end, unsigned prefixBits, std::uint64_t& value);
+
+std::size_t huffmanLength(std::string_view input);
+void huffmanEncode(std::string_view input, std::string& out);
+// Rejects EOS, padding longer than 7 bits and padding that is not all ones.
+bool huffmanDecode(const std::uint8_t* data, std::size_t size, std::string& out);
+
+}  // namespace hpack
+
+}  // namespace http
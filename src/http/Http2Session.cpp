@@ -0,0 +1,743 @@
+#include "http/Http2Session.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <vector>
+
+namespace http {
+namespace {
+
+constexpr std::string_view kClientPreface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+constexpr std::size_t kFrameHeaderSize = 9;
+// Our SETTINGS_MAX_FRAME_SIZE and initial windows stay at the protocol
+// defaults.
+constexpr std::size_t kMaxFrameSize = 16384;
+constexpr std::int64_t kInitialWindow = 65535;
+constexpr std::int64_t kMaxWindow = 0x7fffffff;
+// Receive windows are topped up once half of them has been consumed.
+constexpr std::uint32_t kWindowUpdateThreshold = kInitialWindow / 2;
+constexpr std::size_t kMaxBufferedOutput = 256 * 1024;
+
+enum FrameType : std::uint8_t {
+    kData = 0x0,
+    kHeaders = 0x1,
+    kPriority = 0x2,
+    kRstStream = 0x3,
+    kSettings = 0x4,
+    kPushPromise = 0x5,
+    kPing = 0x6,
+    kGoAway = 0x7,
+    kWindowUpdate = 0x8,
+    kContinuation = 0x9,
+};
+
+enum Flags : std::uint8_t {
+    kEndStream = 0x1,
+    kAck = 0x1,
+    kEndHeaders = 0x4,
+    kPadded = 0x8,
+    kPriorityFlag = 0x20,
+};
+
+enum ErrorCode : std::uint32_t {
+    kProtocolError = 0x1,
+    kFlowControlError = 0x3,
+    kStreamClosed = 0x5,
+    kFrameSizeError = 0x6,
+    kRefusedStream = 0x7,
+    kCancel = 0x8,
+    kCompressionError = 0x9,
+};
+
+enum SettingId : std::uint16_t {
+    kHeaderTableSize = 0x1,
+    kEnablePush = 0x2,
+    kMaxConcurrentStreams = 0x3,
+    kInitialWindowSize = 0x4,
+    kMaxFrameSizeSetting = 0x5,
+    kMaxHeaderListSize = 0x6,
+};
+
+std::uint32_t readUint32(const std::uint8_t* data) {
+    return (static_cast<std::uint32_t>(data[0]) << 24) | (static_cast<std::uint32_t>(data[1]) << 16) |
+           (static_cast<std::uint32_t>(data[2]) << 8) | static_cast<std::uint32_t>(data[3]);
+}
+
+void appendUint32(std::string& out, std::uint32_t value) {
+    out.push_back(static_cast<char>(value >> 24));
+    out.push_back(static_cast<char>(value >> 16));
+    out.push_back(static_cast<char>(value >> 8));
+    out.push_back(static_cast<char>(value));
+}
+
+void appendFrameHeader(std::string& out, std::size_t length, std::uint8_t type, std::uint8_t flags,
+                       std::uint32_t streamId) {
+    out.push_back(static_cast<char>(length >> 16));
+    out.push_back(static_cast<char>(length >> 8));
+    out.push_back(static_cast<char>(length));
+    out.push_back(static_cast<char>(type));
+    out.push_back(static_cast<char>(flags));
+    appendUint32(out, streamId & 0x7fffffff);
+}
+
+void appendSetting(std::string& out, std::uint16_t id, std::uint32_t value) {
+    out.push_back(static_cast<char>(id >> 8));
+    out.push_back(static_cast<char>(id));
+    appendUint32(out, value);
+}
+
+void appendWindowUpdate(std::string& out, std::uint32_t streamId, std::uint32_t increment) {
+    appendFrameHeader(out, 4, kWindowUpdate, 0, streamId);
+    appendUint32(out, increment);
+}
+
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char a, char b) {
+               return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+           });
+}
+
+// Comma-separated header value containing `token`, case-insensitively.
+bool hasToken(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        const std::size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && item.front() == ' ') {
+            item.remove_prefix(1);
+        }
+        while (!item.empty() && item.back() == ' ') {
+            item.remove_suffix(1);
+        }
+        if (equalsIgnoreCase(item, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+// Connection-specific fields have no meaning in HTTP/2 (RFC 9113 8.2.2).
+bool isConnectionHeader(std::string_view name) {
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection" ||
+           name == "transfer-encoding" || name == "upgrade";
+}
+
+// HTTP2-Settings is base64url without padding; standard base64 is accepted
+// too.
+bool decodeBase64Url(std::string_view input, std::string& out) {
+    std::uint32_t bits = 0;
+    int count = 0;
+    for (const char c : input) {
+        int value = 0;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a' + 26;
+        } else if (c >= '0' && c <= '9') {
+            value = c - '0' + 52;
+        } else if (c == '-' || c == '+') {
+            value = 62;
+        } else if (c == '_' || c == '/') {
+            value = 63;
+        } else if (c == '=') {
+            break;
+        } else {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<std::uint32_t>(value);
+        count += 6;
+        if (count >= 8) {
+            count -= 8;
+            out.push_back(static_cast<char>(bits >> count));
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+Http2Session::Preface Http2Session::matchPreface(const char* data, std::size_t size) {
+    const std::size_t compared = std::min(size, kClientPreface.size());
+    if (std::string_view(data, compared) != kClientPreface.substr(0, compared)) {
+        return Preface::Mismatch;
+    }
+    return compared == kClientPreface.size() ? Preface::Match : Preface::Partial;
+}
+
+bool Http2Session::isUpgradeRequest(const HttpRequest& request) {
+    return hasToken(request.getHeader("upgrade"), "h2c") && request.hasHeader("http2-settings") &&
+           request.body.empty() && request.getContentLength() == 0;
+}
+
+Http2Session::Http2Session() : Http2Session(Settings{}) {}
+
+Http2Session::Http2Session(Settings settings) : settings_(settings) {}
+
+void Http2Session::start(std::string& output) {
+    appendFrameHeader(output, 12, kSettings, 0, 0);
+    appendSetting(output, kMaxConcurrentStreams, settings_.maxConcurrentStreams);
+    appendSetting(output, kMaxHeaderListSize, settings_.maxHeaderListSize);
+}
+
+bool Http2Session::startUpgrade(const HttpRequest& request, std::string& output) {
+    std::string payload;
+    if (!decodeBase64Url(request.getHeader("http2-settings"), payload) || payload.size() % 6 != 0 ||
+        applySettings(reinterpret_cast<const std::uint8_t*>(payload.data()), payload.size()) != 0) {
+        return false;
+    }
+    // The 101 acknowledges these settings; no SETTINGS ACK is sent.
+    start(output);
+
+    Stream& stream = streams_[1];
+    stream.sendWindow = peerInitialWindow_;
+    stream.request.method.assign(request.method);
+    stream.request.uri.assign(request.uri);
+    stream.request.version.assign("HTTP/2.0");
+    for (const auto& [name, value] : request.headers) {
+        if (!isConnectionHeader(name) && name != "http2-settings" && name != "te") {
+            stream.request.headers.emplace(name, value);
+        }
+    }
+    lastStreamId_ = 1;
+    markReady(1, stream);
+    return true;
+}
+
+bool Http2Session::receive(RecvBuffer& input, std::string& output) {
+    if (goAwaySent_) {
+        input.clear();
+        return false;
+    }
+    if (!prefaceReceived_) {
+        const Preface preface = matchPreface(input.data(), input.size());
+        if (preface == Preface::Partial) {
+            return true;
+        }
+        if (preface == Preface::Mismatch) {
+            return connectionError(kProtocolError, output);
+        }
+        input.consume(kClientPreface.size());
+        prefaceReceived_ = true;
+    }
+
+    while (input.size() >= kFrameHeaderSize) {
+        const auto* header = reinterpret_cast<const std::uint8_t*>(input.data());
+        const std::size_t length = (static_cast<std::size_t>(header[0]) << 16) |
+                                   (static_cast<std::size_t>(header[1]) << 8) | header[2];
+        const std::uint8_t type = header[3];
+        const std::uint8_t flags = header[4];
+        const std::uint32_t streamId = readUint32(header + 5) & 0x7fffffff;
+        if (length > kMaxFrameSize) {
+            return connectionError(kFrameSizeError, output);
+        }
+        if (input.size() < kFrameHeaderSize + length) {
+            break;
+        }
+        // The preface is followed by SETTINGS, and a header block by its
+        // CONTINUATION frames with nothing in between.
+        if ((!settingsReceived_ && type != kSettings) ||
+            (continuationStream_ != 0 && (type != kContinuation || streamId != continuationStream_))) {
+            return connectionError(kProtocolError, output);
+        }
+        const bool ok = handleFrame(type, flags, streamId, header + kFrameHeaderSize, length, output);
+        input.consume(kFrameHeaderSize + length);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Http2Session::handleFrame(std::uint8_t type, std::uint8_t flags, std::uint32_t streamId,
+                               const std::uint8_t* payload, std::size_t length, std::string& output) {
+    switch (type) {
+    case kData:
+        return onData(flags, streamId, payload, length, output);
+    case kHeaders:
+        return onHeaders(flags, streamId, payload, length, output);
+    case kContinuation:
+        if (continuationStream_ == 0) {
+            return connectionError(kProtocolError, output);
+        }
+        headerBlock_.append(reinterpret_cast<const char*>(payload), length);
+        if (headerBlock_.size() > settings_.maxHeaderListSize * 2) {
+            return connectionError(kProtocolError, output);
+        }
+        if ((flags & kEndHeaders) != 0) {
+            const std::uint32_t id = continuationStream_;
+            continuationStream_ = 0;
+            return onHeaderBlock(id, continuationEndStream_, output);
+        }
+        return true;
+    case kPriority:
+        if (streamId == 0) {
+            return connectionError(kProtocolError, output);
+        }
+        if (length != 5) {
+            resetStream(streamId, kFrameSizeError, output);
+        }
+        return true;
+    case kRstStream:
+        if (streamId == 0 || streamId > lastStreamId_) {
+            return connectionError(kProtocolError, output);
+        }
+        if (length != 4) {
+            return connectionError(kFrameSizeError, output);
+        }
+        closeStream(streamId);
+        return true;
+    case kSettings:
+        return onSettings(flags, streamId, payload, length, output);
+    case kPushPromise:
+        return connectionError(kProtocolError, output);
+    case kPing:
+        if (streamId != 0) {
+            return connectionError(kProtocolError, output);
+        }
+        if (length != 8) {
+            return connectionError(kFrameSizeError, output);
+        }
+        if ((flags & kAck) == 0) {
+            appendFrameHeader(output, 8, kPing, kAck, 0);
+            output.append(reinterpret_cast<const char*>(payload), 8);
+        }
+        return true;
+    case kGoAway:
+        if (streamId != 0) {
+            return connectionError(kProtocolError, output);
+        }
+        goAwayReceived_ = true;
+        return true;
+    case kWindowUpdate:
+        return onWindowUpdate(streamId, payload, length, output);
+    default:
+        // Unknown frame types are ignored.
+        return true;
+    }
+}
+
+bool Http2Session::onData(std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload,
+                          std::size_t length, std::string& output) {
+    if (streamId == 0) {
+        return connectionError(kProtocolError, output);
+    }
+    std::size_t padding = 0;
+    if ((flags & kPadded) != 0) {
+        if (length == 0 || payload[0] >= length) {
+            return connectionError(kProtocolError, output);
+        }
+        // The pad length byte plus the padding itself.
+        padding = payload[0] + 1u;
+    }
+
+    // The whole frame, padding included, counts against both windows.
+    if (static_cast<std::int64_t>(length) > recvWindow_) {
+        return connectionError(kFlowControlError, output);
+    }
+    recvWindow_ -= static_cast<std::int64_t>(length);
+    unacknowledged_ += static_cast<std::uint32_t>(length);
+    if (unacknowledged_ >= kWindowUpdateThreshold) {
+        appendWindowUpdate(output, 0, unacknowledged_);
+        recvWindow_ += unacknowledged_;
+        unacknowledged_ = 0;
+    }
+
+    const auto it = streams_.find(streamId);
+    if (it == streams_.end() || it->second.remoteClosed) {
+        if (streamId > lastStreamId_) {
+            return connectionError(kProtocolError, output);
+        }
+        resetStream(streamId, kStreamClosed, output);
+        return true;
+    }
+    Stream& stream = it->second;
+    if (static_cast<std::int64_t>(length) > stream.recvWindow) {
+        resetStream(streamId, kFlowControlError, output);
+        return true;
+    }
+    stream.recvWindow -= static_cast<std::int64_t>(length);
+    const std::size_t offset = (flags & kPadded) != 0 ? 1 : 0;
+    stream.request.body.append(reinterpret_cast<const char*>(payload) + offset, length - padding);
+    if (stream.request.body.size() > settings_.maxRequestBody) {
+        resetStream(streamId, kCancel, output);
+        return true;
+    }
+    if ((flags & kEndStream) != 0) {
+        markReady(streamId, stream);
+        return true;
+    }
+    stream.unacknowledged += static_cast<std::uint32_t>(length);
+    if (stream.unacknowledged >= kWindowUpdateThreshold) {
+        appendWindowUpdate(output, streamId, stream.unacknowledged);
+        stream.recvWindow += stream.unacknowledged;
+        stream.unacknowledged = 0;
+    }
+    return true;
+}
+
+bool Http2Session::onHeaders(std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload,
+                             std::size_t length, std::string& output) {
+    if (streamId == 0 || (streamId & 1u) == 0) {
+        return connectionError(kProtocolError, output);
+    }
+    std::size_t offset = 0;
+    std::size_t padding = 0;
+    if ((flags & kPadded) != 0) {
+        if (length < 1) {
+            return connectionError(kFrameSizeError, output);
+        }
+        padding = payload[0];
+        offset = 1;
+    }
+    if ((flags & kPriorityFlag) != 0) {
+        offset += 5;
+    }
+    if (offset + padding > length) {
+        return connectionError(kProtocolError, output);
+    }
+    headerBlock_.assign(reinterpret_cast<const char*>(payload) + offset, length - offset - padding);
+    if ((flags & kEndHeaders) == 0) {
+        continuationStream_ = streamId;
+        continuationEndStream_ = (flags & kEndStream) != 0;
+        return true;
+    }
+    return onHeaderBlock(streamId, (flags & kEndStream) != 0, output);
+}
+
+bool Http2Session::onHeaderBlock(std::uint32_t streamId, bool endStream, std::string& output) {
+    // Decoded even for streams about to be refused: the table is shared.
+    std::vector<HeaderField> fields;
+    if (!decoder_.decode(reinterpret_cast<const std::uint8_t*>(headerBlock_.data()), headerBlock_.size(), fields,
+                         settings_.maxHeaderListSize)) {
+        return connectionError(kCompressionError, output);
+    }
+
+    const auto existing = streams_.find(streamId);
+    if (existing != streams_.end()) {
+        // Trailers: must end the stream; their fields are dropped.
+        if (existing->second.remoteClosed) {
+            return connectionError(kStreamClosed, output);
+        }
+        if (!endStream) {
+            return connectionError(kProtocolError, output);
+        }
+        markReady(streamId, existing->second);
+        return true;
+    }
+    if (streamId <= lastStreamId_) {
+        return connectionError(kProtocolError, output);
+    }
+    lastStreamId_ = streamId;
+    if (goAwayReceived_ || streams_.size() >= settings_.maxConcurrentStreams) {
+        resetStream(streamId, kRefusedStream, output);
+        return true;
+    }
+
+    Stream stream;
+    stream.sendWindow = peerInitialWindow_;
+    stream.recvWindow = kInitialWindow;
+    HttpRequest& request = stream.request;
+    request.version.assign("HTTP/2.0");
+    bool regularSeen = false;
+    bool malformed = false;
+    for (const HeaderField& field : fields) {
+        if (!field.name.empty() && field.name.front() == ':') {
+            if (regularSeen) {
+                malformed = true;
+            } else if (field.name == ":method") {
+                request.method.assign(field.value);
+            } else if (field.name == ":path") {
+                request.uri.assign(field.value);
+            } else if (field.name == ":authority") {
+                request.headers.emplace("host", field.value);
+            } else if (field.name != ":scheme") {
+                malformed = true;
+            }
+            continue;
+        }
+        regularSeen = true;
+        const bool upperCase = std::any_of(field.name.begin(), field.name.end(), [](char c) {
+            return std::isupper(static_cast<unsigned char>(c)) != 0;
+        });
+        if (upperCase || isConnectionHeader(field.name) || (field.name == "te" && field.value != "trailers")) {
+            malformed = true;
+            continue;
+        }
+        // Repeated fields are joined; cookies were split for compression.
+        const auto [it, inserted] = request.headers.emplace(field.name, field.value);
+        if (!inserted) {
+            it->second.append(field.name == "cookie" ? "; " : ", ").append(field.value);
+        }
+    }
+    if (malformed || request.method.empty() || request.uri.empty()) {
+        resetStream(streamId, kProtocolError, output);
+        return true;
+    }
+
+    Stream& inserted = streams_.emplace(streamId, std::move(stream)).first->second;
+    if (endStream) {
+        markReady(streamId, inserted);
+    }
+    return true;
+}
+
+bool Http2Session::onSettings(std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload,
+                              std::size_t length, std::string& output) {
+    if (streamId != 0) {
+        return connectionError(kProtocolError, output);
+    }
+    if ((flags & kAck) != 0) {
+        return length == 0 ? true : connectionError(kFrameSizeError, output);
+    }
+    if (length % 6 != 0) {
+        return connectionError(kFrameSizeError, output);
+    }
+    if (const std::uint32_t error = applySettings(payload, length); error != 0) {
+        return connectionError(error, output);
+    }
+    settingsReceived_ = true;
+    appendFrameHeader(output, 0, kSettings, kAck, 0);
+    return true;
+}
+
+std::uint32_t Http2Session::applySettings(const std::uint8_t* payload, std::size_t length) {
+    for (std::size_t offset = 0; offset + 6 <= length; offset += 6) {
+        const auto id = static_cast<std::uint16_t>((payload[offset] << 8) | payload[offset + 1]);
+        const std::uint32_t value = readUint32(payload + offset + 2);
+        switch (id) {
+        case kHeaderTableSize:
+            encoder_.setMaxTableSize(value);
+            break;
+        case kEnablePush:
+            if (value > 1) {
+                return kProtocolError;
+            }
+            break;
+        case kInitialWindowSize: {
+            if (value > kMaxWindow) {
+                return kFlowControlError;
+            }
+            // Applies retroactively to every open stream (RFC 9113 6.9.2).
+            const std::int64_t delta = static_cast<std::int64_t>(value) - peerInitialWindow_;
+            for (auto& [id, stream] : streams_) {
+                (void)id;
+                stream.sendWindow += delta;
+                if (stream.sendWindow > kMaxWindow) {
+                    return kFlowControlError;
+                }
+            }
+            peerInitialWindow_ = value;
+            break;
+        }
+        case kMaxFrameSizeSetting:
+            if (value < 16384 || value > 16777215) {
+                return kProtocolError;
+            }
+            peerMaxFrameSize_ = value;
+            break;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+bool Http2Session::onWindowUpdate(std::uint32_t streamId, const std::uint8_t* payload, std::size_t length,
+                                  std::string& output) {
+    if (length != 4) {
+        return connectionError(kFrameSizeError, output);
+    }
+    const std::uint32_t increment = readUint32(payload) & 0x7fffffff;
+    if (streamId == 0) {
+        if (increment == 0) {
+            return connectionError(kProtocolError, output);
+        }
+        sendWindow_ += increment;
+        return sendWindow_ <= kMaxWindow ? true : connectionError(kFlowControlError, output);
+    }
+    const auto it = streams_.find(streamId);
+    if (it == streams_.end()) {
+        return streamId <= lastStreamId_ ? true : connectionError(kProtocolError, output);
+    }
+    if (increment == 0) {
+        resetStream(streamId, kProtocolError, output);
+        return true;
+    }
+    it->second.sendWindow += increment;
+    if (it->second.sendWindow > kMaxWindow) {
+        resetStream(streamId, kFlowControlError, output);
+    }
+    return true;
+}
+
+HttpRequest* Http2Session::nextRequest(std::uint32_t& streamId) {
+    while (!ready_.empty()) {
+        const std::uint32_t id = ready_.front();
+        ready_.pop_front();
+        const auto it = streams_.find(id);
+        if (it != streams_.end()) {
+            it->second.dispatched = true;
+            streamId = id;
+            return &it->second.request;
+        }
+    }
+    return nullptr;
+}
+
+std::size_t Http2Session::respond(std::uint32_t streamId, HttpResponse response, std::string& output) {
+    const auto it = streams_.find(streamId);
+    if (it == streams_.end() || goAwaySent_) {
+        return 0;
+    }
+    Stream& stream = it->second;
+    stream.dispatched = false;
+    if (stream.reset) {
+        streams_.erase(it);
+        return 0;
+    }
+    stream.response = std::move(response);
+    const HttpResponse& answer = stream.response;
+    std::string_view body = answer.bodyView.empty() ? std::string_view(answer.body) : answer.bodyView;
+    if (stream.request.method == "HEAD") {
+        body = {};
+    }
+
+    std::string block;
+    char digits[24];
+    const auto appendNumber = [&digits](std::size_t value) {
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        return std::string_view(digits, static_cast<std::size_t>(result.ptr - digits));
+    };
+    encoder_.encode(":status", appendNumber(static_cast<std::size_t>(answer.statusCode)), block);
+    bool hasLength = false;
+    std::string name;
+    const auto encodeField = [&](std::string_view key, std::string_view value) {
+        name.assign(key);
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (isConnectionHeader(name)) {
+            return;
+        }
+        hasLength = hasLength || name == "content-length";
+        encoder_.encode(name, value, block);
+    };
+    for (const auto& [key, value] : answer.headers) {
+        encodeField(key, value);
+    }
+    for (const auto& [key, value] : answer.repeatedHeaders) {
+        encodeField(key, value);
+    }
+    if (!hasLength) {
+        encoder_.encode("content-length", appendNumber(answer.bodySize()), block);
+    }
+
+    // HEADERS, then CONTINUATION frames if the block exceeds the peer's
+    // frame size.
+    const std::size_t before = output.size();
+    const bool endStream = body.empty();
+    std::string_view fragment = block;
+    std::uint8_t type = kHeaders;
+    do {
+        const std::size_t size = std::min<std::size_t>(fragment.size(), peerMaxFrameSize_);
+        std::uint8_t flags = size == fragment.size() ? kEndHeaders : 0;
+        if (type == kHeaders && endStream) {
+            flags |= kEndStream;
+        }
+        appendFrameHeader(output, size, type, flags, streamId);
+        output.append(fragment.substr(0, size));
+        fragment.remove_prefix(size);
+        type = kContinuation;
+    } while (!fragment.empty());
+    const std::size_t headerBytes = output.size() - before;
+
+    if (endStream) {
+        streams_.erase(it);
+    } else {
+        stream.remaining = body;
+        stream.responding = true;
+        flush(output);
+    }
+    return headerBytes;
+}
+
+void Http2Session::flush(std::string& output) {
+    bool progress = true;
+    while (progress && sendWindow_ > 0 && output.size() < kMaxBufferedOutput) {
+        progress = false;
+        for (auto it = streams_.begin(); it != streams_.end() && sendWindow_ > 0;) {
+            Stream& stream = it->second;
+            if (!stream.responding || stream.sendWindow <= 0) {
+                ++it;
+                continue;
+            }
+            const std::size_t chunk = std::min<std::size_t>(
+                {stream.remaining.size(), static_cast<std::size_t>(peerMaxFrameSize_),
+                 static_cast<std::size_t>(stream.sendWindow), static_cast<std::size_t>(sendWindow_)});
+            const bool last = chunk == stream.remaining.size();
+            appendFrameHeader(output, chunk, kData, last ? kEndStream : 0, it->first);
+            output.append(stream.remaining.substr(0, chunk));
+            stream.remaining.remove_prefix(chunk);
+            stream.sendWindow -= static_cast<std::int64_t>(chunk);
+            sendWindow_ -= static_cast<std::int64_t>(chunk);
+            progress = true;
+            it = last ? streams_.erase(it) : std::next(it);
+            if (output.size() >= kMaxBufferedOutput) {
+                return;
+            }
+        }
+    }
+}
+
+bool Http2Session::canSend() const {
+    if (sendWindow_ <= 0 || goAwaySent_) {
+        return false;
+    }
+    return std::any_of(streams_.begin(), streams_.end(), [](const auto& entry) {
+        return entry.second.responding && entry.second.sendWindow > 0;
+    });
+}
+
+bool Http2Session::finished() const {
+    return goAwaySent_ || (goAwayReceived_ && streams_.empty());
+}
+
+bool Http2Session::connectionError(std::uint32_t code, std::string& output) {
+    if (!goAwaySent_) {
+        appendFrameHeader(output, 8, kGoAway, 0, 0);
+        appendUint32(output, lastStreamId_);
+        appendUint32(output, code);
+        goAwaySent_ = true;
+    }
+    return false;
+}
+
+void Http2Session::resetStream(std::uint32_t streamId, std::uint32_t code, std::string& output) {
+    appendFrameHeader(output, 4, kRstStream, 0, streamId);
+    appendUint32(output, code);
+    closeStream(streamId);
+}
+
+// A dispatched stream's request may still be in use by whoever is answering
+// it, so the stream is only marked until respond() drops it.
+void Http2Session::closeStream(std::uint32_t streamId) {
+    const auto it = streams_.find(streamId);
+    if (it == streams_.end()) {
+        return;
+    }
+    if (it->second.dispatched) {
+        it->second.reset = true;
+    } else {
+        streams_.erase(it);
+    }
+}
+
+void Http2Session::markReady(std::uint32_t streamId, Stream& stream) {
+    stream.remoteClosed = true;
+    ready_.push_back(streamId);
+}
+
+}  // namespace http
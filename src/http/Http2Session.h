@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+
+#include "http/Hpack.h"
+#include "http/HttpRequest.h"
+#include "http/HttpResponse.h"
+#include "utils/RecvBuffer.h"
+
+namespace http {
+
+// Server side of one HTTP/2 connection (RFC 9113), independent of the
+// transport. receive() consumes bytes read from the socket and frames to send
+// are appended to an output string the caller writes out. Complete requests
+// come out of nextRequest() and are answered with respond() in any order;
+// response bodies go out as DATA frames interleaved across streams as the
+// peer's flow-control windows allow.
+class Http2Session {
+public:
+    struct Settings {
+        std::uint32_t maxConcurrentStreams{100};
+        std::uint32_t maxHeaderListSize{64 * 1024};
+        std::size_t maxRequestBody{10 * 1024 * 1024};
+    };
+
+    enum class Preface { Match, Partial, Mismatch };
+
+    // Whether the bytes at the start of a connection are the client preface
+    // (prior-knowledge h2c); Partial until 24 bytes have arrived.
+    static Preface matchPreface(const char* data, std::size_t size);
+    // An HTTP/1.1 request without a body carrying Upgrade: h2c and
+    // HTTP2-Settings.
+    static bool isUpgradeRequest(const HttpRequest& request);
+
+    Http2Session();
+    explicit Http2Session(Settings settings);
+
+    // Appends the server preface (our SETTINGS); call once, before receive().
+    void start(std::string& output);
+    // Upgrade: h2c. The 101 response must already be in `output`. Applies the
+    // HTTP2-Settings header, starts the session and queues the request as
+    // stream 1. Returns false if the header is malformed.
+    bool startUpgrade(const HttpRequest& request, std::string& output);
+
+    // Consumes every complete frame in `input`. Returns false after a
+    // connection error; a GOAWAY is then in `output` and the connection should
+    // close once it has been written.
+    bool receive(RecvBuffer& input, std::string& output);
+
+    // The next request with complete headers and body, or nullptr. It stays
+    // valid until respond() for its stream, across later receive() calls, so
+    // streams can be answered concurrently.
+    HttpRequest* nextRequest(std::uint32_t& streamId);
+    // Appends the response HEADERS and whatever DATA the windows allow.
+    // Returns the size of the HEADERS frames; a stream reset in the meantime
+    // is dropped here and returns 0.
+    std::size_t respond(std::uint32_t streamId, HttpResponse response, std::string& output);
+    // Appends DATA frames round-robin across streams until the windows close
+    // or about 256 KiB is buffered in `output`.
+    void flush(std::string& output);
+
+    // DATA could be sent without hearing from the peer first.
+    bool canSend() const;
+    // A GOAWAY went out, or the peer sent one and every stream is done.
+    bool finished() const;
+
+private:
+    struct Stream {
+        HttpRequest request;
+        std::int64_t sendWindow{0};
+        std::int64_t recvWindow{0};
+        // Received DATA bytes not yet returned in a WINDOW_UPDATE.
+        std::uint32_t unacknowledged{0};
+        bool remoteClosed{false};
+        // Handed out by nextRequest() and not yet answered.
+        bool dispatched{false};
+        // Reset while dispatched; kept until respond() drops it.
+        bool reset{false};
+        bool responding{false};
+        HttpResponse response;
+        std::string_view remaining;
+    };
+
+    bool handleFrame(std::uint8_t type, std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload,
+                     std::size_t length, std::string& output);
+    bool onData(std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload, std::size_t length,
+                std::string& output);
+    bool onHeaders(std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload, std::size_t length,
+                   std::string& output);
+    bool onHeaderBlock(std::uint32_t streamId, bool endStream, std::string& output);
+    bool onSettings(std::uint8_t flags, std::uint32_t streamId, const std::uint8_t* payload, std::size_t length,
+                    std::string& output);
+    bool onWindowUpdate(std::uint32_t streamId, const std::uint8_t* payload, std::size_t length, std::string& output);
+    // Returns 0 or the connection error code.
+    std::uint32_t applySettings(const std::uint8_t* payload, std::size_t length);
+
+    bool connectionError(std::uint32_t code, std::string& output);
+    void resetStream(std::uint32_t streamId, std::uint32_t code, std::string& output);
+    void closeStream(std::uint32_t streamId);
+    void markReady(std::uint32_t streamId, Stream& stream);
+
+    Settings settings_;
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+    std::map<std::uint32_t, Stream> streams_;
+    std::deque<std::uint32_t> ready_;
+
+    bool prefaceReceived_{false};
+    bool settingsReceived_{false};
+    bool goAwaySent_{false};
+    bool goAwayReceived_{false};
+    std::uint32_t lastStreamId_{0};
+
+    // A header block split over CONTINUATION frames.
+    std::uint32_t continuationStream_{0};
+    bool continuationEndStream_{false};
+    std::string headerBlock_;
+
+    std::int64_t sendWindow_{65535};
+    std::int64_t peerInitialWindow_{65535};
+    std::uint32_t peerMaxFrameSize_{16384};
+    std::int64_t recvWindow_{65535};
+    std::uint32_t unacknowledged_{0};
+};
+
+}  // namespace http
@@ -6,11 +6,13 @@
 namespace http {
 
 constexpr int HTTP_OK = 200;
+constexpr int HTTP_NOT_MODIFIED = 304;
 constexpr int HTTP_BAD_REQUEST = 400;
 constexpr int HTTP_TOO_MANY_REQUESTS = 429;
 constexpr int HTTP_NOT_FOUND = 404;
 constexpr int HTTP_METHOD_NOT_ALLOWED = 405;
 constexpr int HTTP_INTERNAL_ERROR = 500;
+constexpr int HTTP_SERVICE_UNAVAILABLE = 503;
 
 inline const std::unordered_map<std::string, std::string> MIME_TYPES = {
     {".html", "text/html"},
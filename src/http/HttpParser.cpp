@@ -12,14 +12,7 @@ constexpr std::size_t kMaxHeaderSize = 8 * 1024;
 constexpr std::size_t kMaxBodySize = 10 * 1024 * 1024;
 constexpr std::size_t kMaxUriLength = 2048;
 
-std::string toLower(std::string value) {
-    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) {
-        return static_cast<char>(std::tolower(c));
-    });
-    return value;
-}
-
-std::string trim(std::string_view sv) {
+std::string_view trim(std::string_view sv) {
     std::size_t left = 0;
     while (left < sv.size() && std::isspace(static_cast<unsigned char>(sv[left]))) {
         ++left;
@@ -28,7 +21,7 @@ std::string trim(std::string_view sv) {
     while (right > left && std::isspace(static_cast<unsigned char>(sv[right - 1]))) {
         --right;
     }
-    return std::string(sv.substr(left, right - left));
+    return sv.substr(left, right - left);
 }
 
 }  // namespace
@@ -38,6 +31,15 @@ bool HttpParser::parse(const char* buffer, std::size_t len, HttpRequest& request
     return parse(buffer, len, request, ignored);
 }
 
+bool HttpParser::parse(RecvBuffer& buffer, HttpRequest& request) const {
+    std::size_t consumed = 0;
+    if (!parse(buffer.data(), buffer.size(), request, consumed)) {
+        return false;
+    }
+    buffer.consume(consumed);
+    return true;
+}
+
 bool HttpParser::parse(const char* buffer, std::size_t len, HttpRequest& request, std::size_t& consumedBytes) const {
     enum class ParseState {
         RequestLine,
@@ -67,7 +69,7 @@ bool HttpParser::parse(const char* buffer, std::size_t len, HttpRequest& request
     std::size_t cursor = 0;
     std::size_t bodyOffset = 0;
     std::size_t contentLength = 0;
-    std::string currentHeader;
+    std::pmr::string* currentValue = nullptr;
     request.headers.clear();
 
     while (state != ParseState::Done) {
@@ -86,9 +88,9 @@ bool HttpParser::parse(const char* buffer, std::size_t len, HttpRequest& request
                     throw std::runtime_error("Malformed request line");
                 }
 
-                request.method = std::string(requestLine.substr(0, firstSpace));
-                request.uri = std::string(requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1));
-                request.version = std::string(requestLine.substr(secondSpace + 1));
+                request.method.assign(requestLine.substr(0, firstSpace));
+                request.uri.assign(requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1));
+                request.version.assign(requestLine.substr(secondSpace + 1));
                 if (request.uri.size() > kMaxUriLength) {
                     throw std::runtime_error("URI too long");
                 }
@@ -116,8 +118,8 @@ bool HttpParser::parse(const char* buffer, std::size_t len, HttpRequest& request
                     }
 
                     if (line.front() == ' ' || line.front() == '\t') {
-                        if (!currentHeader.empty()) {
-                            request.headers[currentHeader] += " " + trim(line);
+                        if (currentValue != nullptr) {
+                            currentValue->append(" ").append(trim(line));
                         }
                         continue;
                     }
@@ -127,10 +129,14 @@ bool HttpParser::parse(const char* buffer, std::size_t len, HttpRequest& request
                         throw std::runtime_error("Malformed header line");
                     }
 
-                    std::string key = toLower(trim(line.substr(0, colon)));
-                    std::string value = trim(line.substr(colon + 1));
-                    request.headers[key] = value;
-                    currentHeader = key;
+                    std::pmr::string key(trim(line.substr(0, colon)), request.headers.get_allocator());
+                    std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) {
+                        return static_cast<char>(std::tolower(c));
+                    });
+                    auto [it, inserted] = request.headers.try_emplace(std::move(key));
+                    (void)inserted;
+                    it->second.assign(trim(line.substr(colon + 1)));
+                    currentValue = &it->second;
                 }
 
                 bodyOffset = headerEnd + 4;
@@ -3,6 +3,7 @@
 #include <cstddef>
 
 #include "http/HttpRequest.h"
+#include "utils/RecvBuffer.h"
 
 namespace http {
 
@@ -10,6 +11,8 @@ class HttpParser {
 public:
     bool parse(const char* buffer, std::size_t len, HttpRequest& request) const;
     bool parse(const char* buffer, std::size_t len, HttpRequest& request, std::size_t& consumedBytes) const;
+    // Parses the request at the head of `buffer` and consumes it on success.
+    bool parse(RecvBuffer& buffer, HttpRequest& request) const;
 };
 
 }  // namespace http
@@ -2,45 +2,55 @@
 
 #include <algorithm>
 #include <cctype>
+#include <charconv>
 
 namespace http {
 namespace {
-std::string toLower(std::string value) {
-    std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) {
+bool equalsIgnoreCase(std::string_view lhs, std::string_view rhs) {
+    return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char a, char b) {
+               return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+           });
+}
+}  // namespace
+
+HeaderMap::const_iterator HttpRequest::findHeader(std::string_view key) const {
+    const bool lowerCase = std::none_of(key.begin(), key.end(), [](char c) {
+        return std::isupper(static_cast<unsigned char>(c)) != 0;
+    });
+    if (lowerCase) {
+        return headers.find(key);
+    }
+    std::string lowered(key);
+    std::transform(lowered.begin(), lowered.end(), lowered.begin(), [](unsigned char c) {
         return static_cast<char>(std::tolower(c));
     });
-    return value;
+    return headers.find(std::string_view(lowered));
 }
-}  // namespace
 
-std::string HttpRequest::getHeader(const std::string& key) const {
-    const auto it = headers.find(toLower(key));
+std::string_view HttpRequest::getHeader(std::string_view key) const {
+    const auto it = findHeader(key);
     if (it == headers.end()) {
-        return "";
+        return {};
     }
     return it->second;
 }
 
-bool HttpRequest::hasHeader(const std::string& key) const {
-    return headers.find(toLower(key)) != headers.end();
+bool HttpRequest::hasHeader(std::string_view key) const {
+    return findHeader(key) != headers.end();
 }
 
 std::size_t HttpRequest::getContentLength() const {
-    const std::string raw = getHeader("content-length");
-    if (raw.empty()) {
-        return 0;
-    }
-    try {
-        return static_cast<std::size_t>(std::stoull(raw));
-    } catch (...) {
-        return 0;
-    }
+    const std::string_view raw = getHeader("content-length");
+    std::size_t length = 0;
+    const auto [end, error] = std::from_chars(raw.data(), raw.data() + raw.size(), length);
+    (void)end;
+    return error == std::errc() ? length : 0;
 }
 
 bool HttpRequest::isKeepAlive() const {
-    const std::string connection = toLower(getHeader("connection"));
+    const std::string_view connection = getHeader("connection");
     if (!connection.empty()) {
-        return connection == "keep-alive";
+        return equalsIgnoreCase(connection, "keep-alive");
     }
     return version == "HTTP/1.1";
 }
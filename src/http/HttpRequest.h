@@ -1,27 +1,79 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+
+struct RequestTrace;
 
 namespace http {
 
+// Case-sensitive string hash usable for heterogeneous (string_view) lookups.
+struct HeaderHash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view key) const noexcept { return std::hash<std::string_view>{}(key); }
+};
+
+using HeaderMap = std::pmr::unordered_map<std::pmr::string, std::pmr::string, HeaderHash, std::equal_to<>>;
+
+// Named path segments captured by the router, as views into the request's
+// URI. Fixed capacity, so routing never allocates.
+struct RouteParams {
+    static constexpr std::size_t kCapacity = 4;
+
+    std::array<std::pair<std::string_view, std::string_view>, kCapacity> items{};
+    std::size_t size{0};
+
+    // Empty when absent.
+    std::string_view get(std::string_view name) const {
+        for (std::size_t i = 0; i < size; ++i) {
+            if (items[i].first == name) {
+                return items[i].second;
+            }
+        }
+        return {};
+    }
+};
+
+// All fields allocate from the memory resource given at construction, so a
+// request parsed into a RequestArena costs no heap allocations. Header keys
+// are stored lower-case.
 class HttpRequest {
 public:
-    std::string method;
-    std::string uri;
-    std::string version;
-    std::unordered_map<std::string, std::string> headers;
-    std::string body;
-
-    std::string getHeader(const std::string& key) const;
-    bool hasHeader(const std::string& key) const;
+    HttpRequest() = default;
+    explicit HttpRequest(std::pmr::memory_resource* resource)
+        : method(resource), uri(resource), version(resource), headers(resource), body(resource) {}
+
+    std::pmr::string method;
+    std::pmr::string uri;
+    std::pmr::string version;
+    HeaderMap headers;
+    std::pmr::string body;
+    // Phase timing for this request, when the server traces it.
+    RequestTrace* trace{nullptr};
+    // Filled in by the router before the handler runs.
+    RouteParams params;
+
+    // Empty when absent. The view is valid while the request is unchanged.
+    std::string_view getHeader(std::string_view key) const;
+    bool hasHeader(std::string_view key) const;
     std::size_t getContentLength() const;
     bool isKeepAlive() const;
 
-    const std::string& getMethod() const { return method; }
-    const std::string& getUri() const { return uri; }
-    const std::string& getVersion() const { return version; }
-    const std::string& getBody() const { return body; }
+    std::pmr::memory_resource* resource() const { return method.get_allocator().resource(); }
+
+    const std::pmr::string& getMethod() const { return method; }
+    const std::pmr::string& getUri() const { return uri; }
+    const std::pmr::string& getVersion() const { return version; }
+    const std::pmr::string& getBody() const { return body; }
+
+private:
+    HeaderMap::const_iterator findHeader(std::string_view key) const;
 };
 
 }  // namespace http
@@ -1,44 +1,85 @@
 #include "http/HttpResponse.h"
 
-#include <sstream>
+#include <charconv>
 
 namespace http {
 
-void HttpResponse::setStatus(int code, std::string message) {
+void HttpResponse::setStatus(int code, std::string_view message) {
     statusCode = code;
-    statusMessage = std::move(message);
+    statusMessage.assign(message);
 }
 
-void HttpResponse::setHeader(const std::string& key, const std::string& value) {
-    headers[key] = value;
+void HttpResponse::setHeader(std::string_view key, std::string_view value) {
+    const auto it = headers.find(key);
+    if (it != headers.end()) {
+        it->second.assign(value);
+    } else {
+        headers.emplace(key, value);
+    }
+}
+
+void HttpResponse::addHeader(std::string_view key, std::string_view value) {
+    repeatedHeaders.emplace_back(key, value);
 }
 
 void HttpResponse::setBody(std::string content) {
     body = std::move(content);
+    bodyView = {};
+    bodyOwner.reset();
 }
 
-void HttpResponse::setContentType(const std::string& mimeType) {
+void HttpResponse::setBodyView(std::string_view content, std::shared_ptr<const void> owner) {
+    body.clear();
+    bodyView = content;
+    bodyOwner = std::move(owner);
+}
+
+void HttpResponse::setContentType(std::string_view mimeType) {
     setHeader("Content-Type", mimeType);
 }
 
+std::size_t HttpResponse::bodySize() const {
+    return bodyView.empty() ? body.size() : bodyView.size();
+}
+
 std::string HttpResponse::serialize() const {
-    std::ostringstream out;
-    out << "HTTP/1.1 " << statusCode << ' ' << statusMessage << "\r\n";
+    std::string out;
+    serializeTo(out);
+    return out;
+}
+
+void HttpResponse::serializeTo(std::string& out) const {
+    char digits[24];
+    const auto appendNumber = [&out, &digits](std::size_t value) {
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        out.append(digits, result.ptr);
+    };
 
-    std::unordered_map<std::string, std::string> allHeaders = headers;
-    if (allHeaders.find("Content-Length") == allHeaders.end()) {
-        allHeaders["Content-Length"] = std::to_string(body.size());
+    const std::size_t length = bodySize();
+    out.append("HTTP/1.1 ");
+    appendNumber(static_cast<std::size_t>(statusCode));
+    out.push_back(' ');
+    out.append(statusMessage).append("\r\n");
+    for (const auto& [key, value] : headers) {
+        out.append(key).append(": ").append(value).append("\r\n");
     }
-    if (allHeaders.find("Connection") == allHeaders.end()) {
-        allHeaders["Connection"] = "close";
+    for (const auto& [key, value] : repeatedHeaders) {
+        out.append(key).append(": ").append(value).append("\r\n");
     }
-
-    for (const auto& [key, value] : allHeaders) {
-        out << key << ": " << value << "\r\n";
+    if (headers.find(std::string_view("Content-Length")) == headers.end()) {
+        out.append("Content-Length: ");
+        appendNumber(length);
+        out.append("\r\n");
+    }
+    if (headers.find(std::string_view("Connection")) == headers.end()) {
+        out.append("Connection: close\r\n");
+    }
+    out.append("\r\n");
+    if (bodyView.empty()) {
+        out.append(body);
+    } else {
+        out.append(bodyView);
     }
-    out << "\r\n";
-    out << body;
-    return out.str();
 }
 
 }  // namespace http
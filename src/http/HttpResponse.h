@@ -1,22 +1,46 @@
 #pragma once
 
+#include <memory>
+#include <memory_resource>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "http/HttpRequest.h"
 
 namespace http {
 
+// Status line and headers allocate from the memory resource given at
+// construction (a request's arena on the hot path); the body is either an
+// owned string or a view kept alive by bodyOwner.
 class HttpResponse {
 public:
+    HttpResponse() = default;
+    explicit HttpResponse(std::pmr::memory_resource* resource)
+        : statusMessage("OK", resource), headers(resource), repeatedHeaders(resource) {}
+
     int statusCode{200};
-    std::string statusMessage{"OK"};
-    std::unordered_map<std::string, std::string> headers;
+    std::pmr::string statusMessage{"OK"};
+    HeaderMap headers;
+    // Fields sent on a line of their own per value, after `headers`. For
+    // Set-Cookie, whose values cannot be joined into one comma list.
+    std::pmr::vector<std::pair<std::pmr::string, std::pmr::string>> repeatedHeaders;
     std::string body;
+    std::string_view bodyView;
+    std::shared_ptr<const void> bodyOwner;
 
-    void setStatus(int code, std::string message);
-    void setHeader(const std::string& key, const std::string& value);
+    void setStatus(int code, std::string_view message);
+    void setHeader(std::string_view key, std::string_view value);
+    // Adds another line for `key`, keeping any already set.
+    void addHeader(std::string_view key, std::string_view value);
     void setBody(std::string content);
-    void setContentType(const std::string& mimeType);
+    void setBodyView(std::string_view content, std::shared_ptr<const void> owner);
+    void setContentType(std::string_view mimeType);
+    std::size_t bodySize() const;
     std::string serialize() const;
+    // Appends the serialized response to `out` without intermediate copies.
+    void serializeTo(std::string& out) const;
 };
 
 }  // namespace http
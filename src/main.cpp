@@ -1,57 +1,185 @@
 #include "server/HttpServer.h"
+#include "utils/CpuAffinity.h"
 
+#include <algorithm>
 #include <chrono>
 #include <csignal>
 #include <iostream>
 #include <memory>
+#include <string>
 #include <thread>
 
 namespace {
 std::unique_ptr<HttpServer> g_server;
 volatile std::sig_atomic_t g_stopRequested = 0;
+volatile std::sig_atomic_t g_reloadRequested = 0;
 
 void signalHandler(int) {
     g_stopRequested = 1;
 }
+
+void reloadHandler(int) {
+    g_reloadRequested = 1;
+}
 }  // namespace
 
 int main(int argc, char* argv[]) {
-    int port = 8080;
-    std::size_t numThreads = std::thread::hardware_concurrency();
-    if (numThreads == 0) {
-        numThreads = 4;
+    ServerConfig config;
+    config.numThreads = std::thread::hardware_concurrency();
+    if (config.numThreads == 0) {
+        config.numThreads = 4;
     }
-    std::string docRoot = "./public";
-    bool useKqueue = false;
 
+    std::string proxyHealthPath = "/";
+    std::chrono::seconds proxyTimeout{30};
+    std::size_t proxyMaxBody = ProxyConfig{}.maxResponseBody;
     for (int i = 1; i < argc; ++i) {
         const std::string arg = argv[i];
         if (arg == "--port" && i + 1 < argc) {
-            port = std::stoi(argv[++i]);
+            config.port = std::stoi(argv[++i]);
         } else if (arg == "--threads" && i + 1 < argc) {
-            numThreads = static_cast<std::size_t>(std::stoull(argv[++i]));
+            config.numThreads = static_cast<std::size_t>(std::stoull(argv[++i]));
         } else if (arg == "--root" && i + 1 < argc) {
-            docRoot = argv[++i];
-        } else if (arg == "--kqueue") {
-            useKqueue = true;
+            config.docRoot = argv[++i];
+        } else if (arg == "--archive" && i + 1 < argc) {
+            config.archivePath = argv[++i];
+        } else if (arg == "--event-loop" || arg == "--kqueue") {
+            config.useEventLoop = true;
+        } else if (arg == "--worker-cpus" && i + 1 < argc) {
+            config.workerCpus = affinity::parseCpuList(argv[++i]);
+        } else if (arg == "--acceptor-cpus" && i + 1 < argc) {
+            config.acceptorCpus = affinity::parseCpuList(argv[++i]);
+        } else if (arg == "--max-threads" && i + 1 < argc) {
+            config.maxThreads = static_cast<std::size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--spawn-after-ms" && i + 1 < argc) {
+            config.spawnAfter = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--retire-after-ms" && i + 1 < argc) {
+            config.retireAfter = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--io-threads" && i + 1 < argc) {
+            config.ioThreads = static_cast<std::size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--huge-pages") {
+            config.hugePages = true;
+        } else if (arg == "--no-h2c") {
+            config.http2 = false;
+        } else if (arg == "--tls-port" && i + 1 < argc) {
+            config.tlsPort = std::stoi(argv[++i]);
+        } else if (arg == "--tls-cert" && i + 1 < argc) {
+            config.tls.certFile = argv[++i];
+        } else if (arg == "--tls-key" && i + 1 < argc) {
+            config.tls.keyFile = argv[++i];
+        } else if (arg == "--no-ktls") {
+            config.tls.kernelTls = false;
+        } else if (arg == "--proxy" && i + 1 < argc) {
+            // /prefix=host:port[,host:port...]
+            const std::string spec = argv[++i];
+            const std::size_t equals = spec.find('=');
+            ProxyConfig proxy;
+            proxy.prefix = spec.substr(0, equals);
+            std::size_t start = equals == std::string::npos ? spec.size() : equals + 1;
+            while (start < spec.size()) {
+                const std::size_t comma = std::min(spec.find(',', start), spec.size());
+                proxy.upstreams.push_back(spec.substr(start, comma - start));
+                start = comma + 1;
+            }
+            config.proxies.push_back(std::move(proxy));
+        } else if (arg == "--proxy-health-path" && i + 1 < argc) {
+            proxyHealthPath = argv[++i];
+        } else if (arg == "--proxy-timeout" && i + 1 < argc) {
+            proxyTimeout = std::chrono::seconds(std::stoll(argv[++i]));
+        } else if (arg == "--proxy-max-body-mb" && i + 1 < argc) {
+            proxyMaxBody = static_cast<std::size_t>(std::stoull(argv[++i])) * 1024 * 1024;
+        } else if (arg == "--max-conns-per-ip" && i + 1 < argc) {
+            config.ipLimits.maxConnections = static_cast<std::size_t>(std::stoull(argv[++i]));
+        } else if (arg == "--ip-rate" && i + 1 < argc) {
+            config.ipLimits.requestsPerSecond = std::stod(argv[++i]);
+        } else if (arg == "--ip-burst" && i + 1 < argc) {
+            config.ipLimits.requestBurst = std::stod(argv[++i]);
+        } else if (arg == "--ip-bandwidth" && i + 1 < argc) {
+            config.ipLimits.bytesPerSecond = std::stod(argv[++i]);
+        } else if (arg == "--ip-bandwidth-burst" && i + 1 < argc) {
+            config.ipLimits.bandwidthBurst = std::stod(argv[++i]);
+        } else if (arg == "--access-log" && i + 1 < argc) {
+            const std::string path = argv[++i];
+            config.accessLog = path != "off";
+            config.accessLogOptions.path = path == "-" || path == "off" ? "" : path;
+        } else if (arg == "--access-log-max-mb" && i + 1 < argc) {
+            config.accessLogOptions.maxBytes = static_cast<std::size_t>(std::stoull(argv[++i])) * 1024 * 1024;
+        } else if (arg == "--metrics-path" && i + 1 < argc) {
+            const std::string path = argv[++i];
+            config.metricsPath = path == "off" ? "" : path;
+        } else if (arg == "--health-path" && i + 1 < argc) {
+            const std::string path = argv[++i];
+            config.healthPath = path == "off" ? "" : path;
+        } else if (arg == "--slow-request-ms" && i + 1 < argc) {
+            config.slowRequestThreshold = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--shed" && i + 1 < argc) {
+            const std::string mode = argv[++i];
+            if (mode == "pause") {
+                config.admission.mode = AdmissionConfig::Mode::PauseAccept;
+            } else if (mode == "reject") {
+                config.admission.mode = AdmissionConfig::Mode::Reject;
+            } else if (mode == "off") {
+                config.admission.mode = AdmissionConfig::Mode::Off;
+            } else {
+                std::cerr << "Invalid --shed mode '" << mode << "'; expected off, pause or reject\n";
+                return 1;
+            }
+        } else if (arg == "--shed-target-ms" && i + 1 < argc) {
+            config.admission.target = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--shed-interval-ms" && i + 1 < argc) {
+            config.admission.interval = std::chrono::milliseconds(std::stoll(argv[++i]));
+        } else if (arg == "--retry-after" && i + 1 < argc) {
+            config.admission.retryAfterSeconds = std::stoi(argv[++i]);
         }
     }
 
+    for (ProxyConfig& proxy : config.proxies) {
+        proxy.healthPath = proxyHealthPath;
+        proxy.timeout = proxyTimeout;
+        proxy.maxResponseBody = proxyMaxBody;
+    }
+
     std::signal(SIGINT, signalHandler);
     std::signal(SIGTERM, signalHandler);
+    std::signal(SIGHUP, reloadHandler);
 
     try {
-        g_server = std::make_unique<HttpServer>(port, numThreads, docRoot, useKqueue);
+        g_server = std::make_unique<HttpServer>(config);
 
-        std::cout << "Starting HTTP server on port " << port << "\n";
-        std::cout << "Document root: " << docRoot << "\n";
-        std::cout << "Thread pool size: " << numThreads << "\n";
-        std::cout << "Mode: " << (useKqueue ? "kqueue" : "thread-pool") << "\n";
+        std::cout << "Starting HTTP server on port " << config.port << "\n";
+        if (config.archivePath.empty()) {
+            std::cout << "Document root: " << config.docRoot << "\n";
+        } else {
+            std::cout << "Docroot archive: " << config.archivePath << "\n";
+        }
+        std::cout << "Thread pool size: " << config.numThreads;
+        if (config.maxThreads > config.numThreads) {
+            std::cout << " (elastic up to " << config.maxThreads << ")";
+        }
+        std::cout << "\n";
+        for (const ProxyConfig& proxy : config.proxies) {
+            std::cout << "Proxy: " << proxy.prefix << " ->";
+            for (const std::string& upstream : proxy.upstreams) {
+                std::cout << " " << upstream;
+            }
+            std::cout << "\n";
+        }
+        std::cout << "Mode: " << (config.useEventLoop ? "event-loop" : "thread-pool") << "\n";
+        if (config.admission.mode != AdmissionConfig::Mode::Off) {
+            std::cout << "Load shedding: "
+                      << (config.admission.mode == AdmissionConfig::Mode::PauseAccept ? "pause accept" : "reject 503")
+                      << " (target " << config.admission.target.count() << "ms, interval "
+                      << config.admission.interval.count() << "ms)\n";
+        }
 
         g_server->start();
 
         while (!g_stopRequested) {
             std::this_thread::sleep_for(std::chrono::seconds(1));
+            if (g_reloadRequested) {
+                g_reloadRequested = 0;
+                g_server->reload();
+            }
         }
 
         if (g_server) {
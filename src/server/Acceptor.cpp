@@ -1,10 +1,11 @@
 #include "server/Acceptor.h"
 
 #include <cerrno>
-#include <memory>
 
-Acceptor::Acceptor(Socket listenSocket, threadpool::ThreadPool& threadPool,
-                   std::function<void(Socket, std::string)> connectionHandler)
+#include "utils/CpuAffinity.h"
+#include "utils/CycleClock.h"
+
+Acceptor::Acceptor(Socket listenSocket, threadpool::ThreadPool& threadPool, ConnectionHandler connectionHandler)
     : listenSocket_(std::move(listenSocket)),
       threadPool_(threadPool),
       connectionHandler_(std::move(connectionHandler)) {}
@@ -13,6 +14,14 @@ Acceptor::~Acceptor() {
     stop();
 }
 
+void Acceptor::setCpuAffinity(std::vector<int> cpus) {
+    cpus_ = std::move(cpus);
+}
+
+void Acceptor::setAdmissionController(AdmissionController* admission) {
+    admission_ = admission;
+}
+
 void Acceptor::start() {
     bool expected = false;
     if (!running_.compare_exchange_strong(expected, true)) {
@@ -36,19 +45,40 @@ void Acceptor::stop() {
 }
 
 void Acceptor::acceptLoop() {
+    if (!cpus_.empty()) {
+        (void)affinity::pinCurrentThread(cpus_);
+    }
+    const bool pauseWhenOverloaded =
+        admission_ != nullptr && admission_->mode() == AdmissionConfig::Mode::PauseAccept;
+    const bool rejectWhenOverloaded = admission_ != nullptr && admission_->mode() == AdmissionConfig::Mode::Reject;
     while (running_.load(std::memory_order_relaxed)) {
+        if (pauseWhenOverloaded && admission_->overloaded()) {
+            // Leave new connections in the kernel backlog until the queue drains.
+            std::this_thread::sleep_for(admission_->pollInterval());
+            continue;
+        }
         try {
-            std::string clientIp;
+            IpAddress clientIp;
             Socket client = listenSocket_.accept(&clientIp);
+            if (rejectWhenOverloaded && admission_->overloaded()) {
+                admission_->reject(client.getFd());
+                continue;
+            }
             client.setKeepAlive();
-            auto sockPtr = std::make_shared<Socket>(std::move(client));
-            threadPool_.submit([this, sockPtr, clientIp]() mutable {
-                connectionHandler_(std::move(*sockPtr), clientIp);
-            });
+            auto task = [this, client = std::move(client), clientIp, acceptedAt = CycleClock::now()]() mutable {
+                connectionHandler_(std::move(client), clientIp, acceptedAt);
+            };
+            static_assert(sizeof(task) <= threadpool::Task::kInlineSize,
+                          "connection closure must fit in Task's inline storage");
+            // New connections jump ahead of queued bulk work.
+            threadPool_.submit(std::move(task), {threadpool::Priority::High});
         } catch (...) {
             if (!running_.load(std::memory_order_relaxed)) {
                 break;
             }
+            if (exhausted(errno)) {
+                std::this_thread::sleep_for(kExhaustedBackoff);
+            }
         }
     }
 }
@@ -1,21 +1,38 @@
 #pragma once
 
 #include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <functional>
 #include <thread>
+#include <vector>
 
+#include "server/AdmissionController.h"
 #include "server/Socket.h"
 #include "threadpool/ThreadPool.h"
 
 class Acceptor {
 public:
-    Acceptor(Socket listenSocket, threadpool::ThreadPool& threadPool,
-             std::function<void(Socket, std::string)> connectionHandler);
+    // The handler also gets the CycleClock time of the accept, so it can
+    // tell how long the connection waited in the pool queue.
+    using ConnectionHandler = std::function<void(Socket, IpAddress, std::uint64_t)>;
+
+    // accept() errors that leave the connection queued and the listener
+    // readable until something is closed; retrying at once would spin.
+    static bool exhausted(int error) {
+        return error == EMFILE || error == ENFILE || error == ENOBUFS || error == ENOMEM;
+    }
+    static constexpr std::chrono::milliseconds kExhaustedBackoff{50};
+
+    Acceptor(Socket listenSocket, threadpool::ThreadPool& threadPool, ConnectionHandler connectionHandler);
     ~Acceptor();
 
     Acceptor(const Acceptor&) = delete;
     Acceptor& operator=(const Acceptor&) = delete;
 
+    void setCpuAffinity(std::vector<int> cpus);
+    void setAdmissionController(AdmissionController* admission);
     void start();
     void stop();
 
@@ -25,6 +42,8 @@ private:
     Socket listenSocket_;
     threadpool::ThreadPool& threadPool_;
     std::atomic<bool> running_{false};
-    std::function<void(Socket, std::string)> connectionHandler_;
+    ConnectionHandler connectionHandler_;
+    std::vector<int> cpus_;
+    AdmissionController* admission_{nullptr};
     std::thread acceptThread_;
 };
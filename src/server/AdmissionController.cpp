@@ -0,0 +1,56 @@
+#include "server/AdmissionController.h"
+
+#include <algorithm>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "handlers/ErrorHandler.h"
+
+AdmissionController::AdmissionController(threadpool::ThreadPool& threadPool, AdmissionConfig config)
+    : threadPool_(threadPool),
+      config_(config),
+      pollInterval_(std::max(std::chrono::milliseconds(1), config.target / 2)),
+      rejectResponse_(handlers::create503(config.retryAfterSeconds).serialize()) {}
+
+bool AdmissionController::overloaded() {
+    if (config_.mode == AdmissionConfig::Mode::Off) {
+        return false;
+    }
+    const auto now = std::chrono::steady_clock::now();
+    if (now < nextPoll_) {
+        return overloaded_;
+    }
+    nextPoll_ = now + pollInterval_;
+    // The sample is a minimum over everything started since the last poll, so
+    // an above-target sample means sojourn stayed high since then; in reject
+    // mode polls can be far apart.
+    const auto windowStart = lastPoll_ == std::chrono::steady_clock::time_point{} ? now : lastPoll_;
+    lastPoll_ = now;
+
+    const auto target = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(config_.target).count());
+    if (threadPool_.takeMinSojournNs() < target) {
+        firstAbove_ = {};
+        overloaded_ = false;
+    } else {
+        if (firstAbove_ == std::chrono::steady_clock::time_point{}) {
+            firstAbove_ = windowStart + config_.interval;
+        }
+        overloaded_ = now >= firstAbove_;
+    }
+    if (overloaded_ && config_.mode == AdmissionConfig::Mode::PauseAccept) {
+        pausedPolls_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return overloaded_;
+}
+
+void AdmissionController::reject(int fd) {
+    rejected_.fetch_add(1, std::memory_order_relaxed);
+    (void)::send(fd, rejectResponse_.data(), rejectResponse_.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    // Consume whatever request bytes already arrived so close() sends FIN
+    // rather than RST, which could discard the 503 at the client.
+    char drain[4096];
+    while (::recv(fd, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+    }
+    ::shutdown(fd, SHUT_WR);
+}
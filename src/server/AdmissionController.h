@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+#include "threadpool/ThreadPool.h"
+
+struct AdmissionConfig {
+    enum class Mode { Off, PauseAccept, Reject };
+
+    Mode mode{Mode::Off};
+    // CoDel parameters: overload is declared once the smallest queue sojourn
+    // has stayed above target for a whole interval.
+    std::chrono::milliseconds target{5};
+    std::chrono::milliseconds interval{100};
+    int retryAfterSeconds{1};
+};
+
+// Watches the pool's queue sojourn time from the accept thread. When
+// overloaded, the acceptor either stops calling accept() (the kernel backlog
+// absorbs the burst) or answers new connections with a canned 503.
+class AdmissionController {
+public:
+    AdmissionController(threadpool::ThreadPool& threadPool, AdmissionConfig config);
+
+    AdmissionConfig::Mode mode() const { return config_.mode; }
+    std::chrono::milliseconds pollInterval() const { return pollInterval_; }
+
+    // Samples the pool at most once per pollInterval(). Accept thread only.
+    bool overloaded();
+
+    // Sends the pre-serialized 503 without blocking; the caller closes fd.
+    void reject(int fd);
+
+    std::uint64_t pausedPolls() const { return pausedPolls_.load(std::memory_order_relaxed); }
+    std::uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+private:
+    threadpool::ThreadPool& threadPool_;
+    AdmissionConfig config_;
+    std::chrono::milliseconds pollInterval_;
+    std::string rejectResponse_;
+
+    std::chrono::steady_clock::time_point nextPoll_{};
+    std::chrono::steady_clock::time_point lastPoll_{};
+    std::chrono::steady_clock::time_point firstAbove_{};
+    bool overloaded_{false};
+
+    std::atomic<std::uint64_t> pausedPolls_{0};
+    std::atomic<std::uint64_t> rejected_{0};
+};
@@ -0,0 +1,341 @@
+#include "server/EventLoop.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <algorithm>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#if !defined(MSG_NOSIGNAL)
+#define MSG_NOSIGNAL 0
+#endif
+
+namespace {
+
+constexpr std::size_t kMaxPreallocatedSlots = 4096;
+
+std::uint64_t makeToken(int fd, std::uint32_t generation) {
+    return (static_cast<std::uint64_t>(generation) << 32) | static_cast<std::uint32_t>(fd);
+}
+
+}  // namespace
+
+EventLoop::EventLoop(std::chrono::seconds idleTimeout)
+    : idleTimeout_(idleTimeout), now_(std::chrono::steady_clock::now()) {
+    // Size the slab for the fd limit up front (capped); attach() grows it if
+    // the limit is raised later.
+    std::size_t slots = kMaxPreallocatedSlots;
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY) {
+        slots = std::min(slots, static_cast<std::size_t>(limit.rlim_cur));
+    }
+    slots_.resize(slots);
+}
+
+void EventLoop::run() {
+    std::vector<Poller::Event> events;
+    auto nextSweep = now_ + std::chrono::seconds(1);
+    while (running()) {
+        try {
+            poller_.wait(events, pollTimeoutMs());
+        } catch (const std::exception&) {
+            continue;
+        }
+        now_ = std::chrono::steady_clock::now();
+        for (const Poller::Event& event : events) {
+            dispatch(event);
+        }
+        runPosted();
+        runTimers(false);
+        if (now_ >= nextSweep) {
+            expireIdle();
+            nextSweep = now_ + std::chrono::seconds(1);
+        }
+    }
+
+    // Operations started from here on fail immediately (see await_ready), so
+    // one pass over the sockets that are suspended right now is enough.
+    // Index afresh each time: a resumed coroutine may attach and grow the slab.
+    for (std::size_t fd = 0; fd < highWater_; ++fd) {
+        if (slots_[fd].pending != nullptr) {
+            cancel(static_cast<int>(fd));
+        }
+    }
+    runTimers(true);
+    while (offloads_ > 0) {
+        try {
+            poller_.wait(events, 100);
+        } catch (const std::exception&) {
+        }
+        runPosted();
+    }
+}
+
+void EventLoop::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lock(postedMutex_);
+        posted_.push_back(handle);
+    }
+    poller_.wake();
+}
+
+void EventLoop::runPosted() {
+    {
+        std::lock_guard<std::mutex> lock(postedMutex_);
+        resuming_.swap(posted_);
+    }
+    for (std::coroutine_handle<> handle : resuming_) {
+        --offloads_;
+        handle.resume();
+    }
+    resuming_.clear();
+}
+
+void EventLoop::runTimers(bool all) {
+    const auto now = std::chrono::steady_clock::now();
+    while (!timers_.empty() && (all || timers_.top().deadline <= now)) {
+        const std::coroutine_handle<> handle = timers_.top().handle;
+        timers_.pop();
+        handle.resume();
+    }
+}
+
+int EventLoop::pollTimeoutMs() const {
+    constexpr int kMaxTimeoutMs = 1000;
+    if (timers_.empty()) {
+        return kMaxTimeoutMs;
+    }
+    const auto until = timers_.top().deadline - std::chrono::steady_clock::now();
+    if (until <= std::chrono::steady_clock::duration::zero()) {
+        return 0;
+    }
+    const auto ms = std::chrono::ceil<std::chrono::milliseconds>(until).count();
+    return static_cast<int>(std::min<decltype(ms)>(ms, kMaxTimeoutMs));
+}
+
+void EventLoop::stop() {
+    running_.store(false, std::memory_order_release);
+    poller_.wake();
+}
+
+void EventLoop::attach(AsyncSocket& socket, bool idleTimeout) {
+    const auto index = static_cast<std::size_t>(socket.fd_);
+    if (index >= slots_.size()) {
+        slots_.resize(std::max(slots_.size() * 2, index + 1));
+    }
+    Slot& slot = slots_[index];
+    ++slot.generation;
+    slot.pending = nullptr;
+    slot.registered = false;
+    slot.idleTimeout = idleTimeout;
+    slot.lastActive = now_;
+    slot.socket = &socket;
+    highWater_ = std::max(highWater_, index + 1);
+}
+
+void EventLoop::detach(AsyncSocket& socket) {
+    Slot& slot = slotFor(socket.fd_);
+    if (slot.socket != &socket) {
+        return;
+    }
+    if (slot.registered) {
+        poller_.remove(socket.fd_);
+    }
+    slot.pending = nullptr;
+    slot.registered = false;
+    slot.socket = nullptr;
+}
+
+bool EventLoop::arm(int fd) {
+    Slot& slot = slotFor(fd);
+    const unsigned interest = slot.pending->interest_;
+    const std::uint64_t token = makeToken(fd, slot.generation);
+    try {
+        if (slot.registered) {
+            poller_.modify(fd, token, interest, true);
+        } else {
+            poller_.add(fd, token, interest, true);
+            slot.registered = true;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+void EventLoop::dispatch(const Poller::Event& event) {
+    // The fd may have been closed and reused by a socket resumed earlier in
+    // this batch; the generation check drops the stale event.
+    const auto fd = static_cast<int>(event.token & 0xffffffffu);
+    if (static_cast<std::size_t>(fd) >= highWater_) {
+        return;
+    }
+    Slot& slot = slotFor(fd);
+    if (slot.pending == nullptr || slot.generation != static_cast<std::uint32_t>(event.token >> 32)) {
+        return;
+    }
+    AsyncSocket::Operation* operation = slot.pending;
+    if (!operation->perform()) {
+        if (!arm(fd)) {
+            cancel(fd);
+        }
+        return;
+    }
+    slot.pending = nullptr;
+    slot.lastActive = now_;
+    operation->handle_.resume();
+}
+
+void EventLoop::cancel(int fd) {
+    Slot& slot = slotFor(fd);
+    AsyncSocket::Operation* operation = slot.pending;
+    slot.pending = nullptr;
+    if (slot.registered) {
+        poller_.remove(fd);
+        slot.registered = false;
+    }
+    operation->result_ = -1;
+    operation->handle_.resume();
+}
+
+// The fd stays armed; a late readiness event finds no read pending and is
+// dropped, or drives whatever operation is pending by then.
+void EventLoop::interrupt(AsyncSocket& socket) {
+    Slot& slot = slotFor(socket.fd_);
+    AsyncSocket::Operation* operation = slot.pending;
+    if (slot.socket != &socket || operation == nullptr || !operation->interruptible_) {
+        return;
+    }
+    slot.pending = nullptr;
+    operation->result_ = AsyncSocket::kInterrupted;
+    operation->handle_.resume();
+}
+
+void EventLoop::expireIdle() {
+    for (std::size_t fd = 0; fd < highWater_; ++fd) {
+        const Slot& slot = slots_[fd];
+        if (slot.idleTimeout && slot.pending != nullptr && now_ - slot.lastActive >= idleTimeout_) {
+            cancel(static_cast<int>(fd));
+        }
+    }
+}
+
+AsyncSocket::AsyncSocket(EventLoop& loop, int fd, bool idleTimeout, TransportLayer* layer)
+    : loop_(loop), fd_(fd), layer_(layer) {
+    loop_.attach(*this, idleTimeout);
+}
+
+AsyncSocket::~AsyncSocket() {
+    loop_.detach(*this);
+}
+
+bool AsyncSocket::Operation::await_ready() {
+    if (!socket_.loop_.running()) {
+        result_ = -1;
+        return true;
+    }
+    if (perform()) {
+        EventLoop& loop = socket_.loop_;
+        loop.slotFor(socket_.fd_).lastActive = loop.now_;
+        return true;
+    }
+    return false;
+}
+
+bool AsyncSocket::Operation::await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    EventLoop& loop = socket_.loop_;
+    loop.slotFor(socket_.fd_).pending = this;
+    if (!loop.arm(socket_.fd_)) {
+        loop.slotFor(socket_.fd_).pending = nullptr;
+        result_ = -1;
+        return false;
+    }
+    return true;
+}
+
+bool AsyncSocket::ReadOperation::perform() {
+    TransportLayer* layer = socket_.layer_;
+    ssize_t bytes;
+    do {
+        bytes = layer != nullptr ? layer->recv(buffer_, size_) : ::recv(socket_.fd(), buffer_, size_, 0);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        if (layer != nullptr) {
+            waitForLayer();
+        }
+        return false;
+    }
+    result_ = bytes;
+    return true;
+}
+
+bool AsyncSocket::WriteOperation::perform() {
+    TransportLayer* layer = socket_.layer_;
+    while (written_ < size_) {
+        const ssize_t sent = layer != nullptr ? layer->send(data_ + written_, size_ - written_)
+                                              : ::send(socket_.fd(), data_ + written_, size_ - written_, MSG_NOSIGNAL);
+        if (sent > 0) {
+            written_ += static_cast<std::size_t>(sent);
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (layer != nullptr) {
+                waitForLayer();
+            }
+            return false;
+        }
+        result_ = -1;
+        return true;
+    }
+    result_ = static_cast<ssize_t>(written_);
+    return true;
+}
+
+bool AsyncSocket::HandshakeOperation::perform() {
+    TransportLayer* layer = socket_.layer_;
+    if (layer == nullptr || layer->handshake() > 0) {
+        result_ = 0;
+        return true;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        waitForLayer();
+        return false;
+    }
+    result_ = -1;
+    return true;
+}
+
+bool AsyncSocket::AcceptOperation::perform() {
+    sockaddr_storage clientAddr{};
+    socklen_t len = sizeof(clientAddr);
+    int clientFd;
+    do {
+        clientFd = ::accept(socket_.fd(), reinterpret_cast<sockaddr*>(&clientAddr), &len);
+    } while (clientFd < 0 && (errno == EINTR || errno == ECONNABORTED));
+    if (clientFd < 0) {
+        // Out of descriptors or socket memory, the pending connection stays
+        // queued and the listener stays readable, so waiting for readiness
+        // would spin: fail instead and let the caller back off. A broken
+        // listen socket fails too; anything else waits for readiness.
+        if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM || errno == EBADF ||
+            errno == EINVAL || errno == ENOTSOCK) {
+            result_ = -1;
+            return true;
+        }
+        return false;
+    }
+
+    const int flags = ::fcntl(clientFd, F_GETFL, 0);
+    (void)::fcntl(clientFd, F_SETFL, flags | O_NONBLOCK);
+    if (peerIp_ != nullptr) {
+        *peerIp_ = IpAddress::fromSockaddr(reinterpret_cast<const sockaddr*>(&clientAddr));
+    }
+    result_ = clientFd;
+    return true;
+}
@@ -0,0 +1,283 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <type_traits>
+#include <vector>
+#include <sys/types.h>
+
+#include "server/IpAddress.h"
+#include "server/Poller.h"
+#include "server/Socket.h"
+#include "threadpool/ThreadPool.h"
+
+class AsyncSocket;
+
+// Fire-and-forget coroutine: runs eagerly until its first suspension and
+// frees its frame when it finishes.
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {}
+    };
+};
+
+// Single-threaded reactor resuming coroutines suspended on AsyncSocket
+// operations. Run one per core; everything but stop() happens on the loop
+// thread. Per-socket state lives in a slab indexed by fd, and each poller
+// token carries the slot's generation so events for a closed-and-reused fd
+// are recognised and dropped.
+class EventLoop {
+public:
+    // Awaitable that runs a blocking callable on a ThreadPool and resumes the
+    // coroutine back on the loop thread. Resolves to nullopt if it threw.
+    template <typename Fn>
+    class OffloadOperation {
+    public:
+        using Result = std::invoke_result_t<Fn&>;
+
+        OffloadOperation(EventLoop& loop, threadpool::ThreadPool& pool, Fn fn)
+            : loop_(loop), pool_(pool), fn_(std::move(fn)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            ++loop_.offloads_;
+            try {
+                pool_.submit([this, handle]() {
+                    run();
+                    loop_.post(handle);
+                });
+            } catch (const std::exception&) {
+                // Pool already stopped: do the work here instead.
+                --loop_.offloads_;
+                run();
+                return false;
+            }
+            return true;
+        }
+
+        std::optional<Result> await_resume() { return std::move(result_); }
+
+    private:
+        void run() noexcept {
+            try {
+                result_.emplace(fn_());
+            } catch (...) {
+            }
+        }
+
+        EventLoop& loop_;
+        threadpool::ThreadPool& pool_;
+        Fn fn_;
+        std::optional<Result> result_;
+    };
+
+    // Awaitable pause on the loop thread. Resolves immediately once the loop
+    // is stopping, and early when it stops.
+    class SleepOperation {
+    public:
+        SleepOperation(EventLoop& loop, std::chrono::nanoseconds duration) : loop_(loop), duration_(duration) {}
+
+        bool await_ready() const noexcept { return duration_.count() <= 0 || !loop_.running(); }
+        void await_suspend(std::coroutine_handle<> handle) {
+            loop_.timers_.push({std::chrono::steady_clock::now() + duration_, handle});
+        }
+        void await_resume() const noexcept {}
+
+    private:
+        EventLoop& loop_;
+        std::chrono::nanoseconds duration_;
+    };
+
+    explicit EventLoop(std::chrono::seconds idleTimeout);
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Runs until stop(), then fails every pending operation so the suspended
+    // coroutines unwind before run() returns.
+    void run();
+    void stop();
+    bool running() const { return running_.load(std::memory_order_acquire); }
+
+    template <typename Fn>
+    OffloadOperation<Fn> offload(threadpool::ThreadPool& pool, Fn fn) {
+        return OffloadOperation<Fn>(*this, pool, std::move(fn));
+    }
+
+    SleepOperation sleep(std::chrono::nanoseconds duration) { return SleepOperation(*this, duration); }
+
+    // Thread-safe: resumes `handle` on the loop thread, waking the poller.
+    void post(std::coroutine_handle<> handle);
+
+private:
+    friend class AsyncSocket;
+
+    struct Slot;
+
+    Slot& slotFor(int fd) { return slots_[static_cast<std::size_t>(fd)]; }
+    void attach(AsyncSocket& socket, bool idleTimeout);
+    void detach(AsyncSocket& socket);
+    bool arm(int fd);
+    void dispatch(const Poller::Event& event);
+    void cancel(int fd);
+    void interrupt(AsyncSocket& socket);
+    void expireIdle();
+    void runPosted();
+    void runTimers(bool all);
+    int pollTimeoutMs() const;
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        std::coroutine_handle<> handle;
+    };
+    // Earliest deadline on top.
+    struct LaterDeadline {
+        bool operator()(const Timer& a, const Timer& b) const { return a.deadline > b.deadline; }
+    };
+
+    Poller poller_;
+    std::vector<Slot> slots_;
+    // One past the highest fd attached so far; bounds the idle sweep.
+    std::size_t highWater_{0};
+    std::chrono::seconds idleTimeout_;
+    std::chrono::steady_clock::time_point now_;
+    std::priority_queue<Timer, std::vector<Timer>, LaterDeadline> timers_;
+    std::atomic<bool> running_{true};
+
+    std::mutex postedMutex_;
+    std::vector<std::coroutine_handle<>> posted_;
+    std::vector<std::coroutine_handle<>> resuming_;
+    // Offloaded operations not yet resumed; run() waits for them on shutdown
+    // so no pool thread posts to a destroyed loop.
+    std::size_t offloads_{0};
+};
+
+// Non-owning awaitable view of a non-blocking fd bound to one EventLoop.
+// Operations resolve to the byte count (or accepted fd), 0 on EOF, and -1 on
+// error, idle timeout or loop shutdown; a read cut short by interruptRead()
+// resolves to kInterrupted. One operation at a time. With a transport layer
+// (TLS), reads and writes go through it and wait for whichever readiness it
+// asks for.
+class AsyncSocket {
+public:
+    static constexpr ssize_t kInterrupted = -2;
+
+    class Operation {
+    public:
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        ssize_t await_resume() const noexcept { return result_; }
+
+    protected:
+        Operation(AsyncSocket& socket, unsigned interest, bool interruptible = false)
+            : socket_(socket), interest_(interest), interruptible_(interruptible) {}
+        // Attempts the syscall; returns false if it would block.
+        virtual bool perform() = 0;
+        // After the layer would block: wait for the readiness it needs.
+        void waitForLayer() {
+            interest_ = socket_.layer_->wantsWrite() ? Poller::kWrite : Poller::kRead;
+        }
+
+        AsyncSocket& socket_;
+        ssize_t result_{-1};
+
+    private:
+        friend class EventLoop;
+        friend class AsyncSocket;
+
+        unsigned interest_;
+        bool interruptible_;
+        std::coroutine_handle<> handle_;
+    };
+
+    class ReadOperation : public Operation {
+    public:
+        ReadOperation(AsyncSocket& socket, char* buffer, std::size_t size)
+            : Operation(socket, Poller::kRead, true), buffer_(buffer), size_(size) {}
+
+    private:
+        bool perform() override;
+        char* buffer_;
+        std::size_t size_;
+    };
+
+    class WriteOperation : public Operation {
+    public:
+        WriteOperation(AsyncSocket& socket, const char* data, std::size_t size)
+            : Operation(socket, Poller::kWrite), data_(data), size_(size) {}
+
+    private:
+        bool perform() override;
+        const char* data_;
+        std::size_t size_;
+        std::size_t written_{0};
+    };
+
+    class HandshakeOperation : public Operation {
+    public:
+        explicit HandshakeOperation(AsyncSocket& socket) : Operation(socket, Poller::kRead) {}
+
+    private:
+        bool perform() override;
+    };
+
+    class AcceptOperation : public Operation {
+    public:
+        AcceptOperation(AsyncSocket& socket, IpAddress* peerIp) : Operation(socket, Poller::kRead), peerIp_(peerIp) {}
+
+    private:
+        bool perform() override;
+        IpAddress* peerIp_;
+    };
+
+    // Listening sockets pass idleTimeout = false. `layer`, if any, must
+    // outlive this view.
+    AsyncSocket(EventLoop& loop, int fd, bool idleTimeout = true, TransportLayer* layer = nullptr);
+    ~AsyncSocket();
+
+    AsyncSocket(const AsyncSocket&) = delete;
+    AsyncSocket& operator=(const AsyncSocket&) = delete;
+
+    ReadOperation read(char* buffer, std::size_t size) { return ReadOperation(*this, buffer, size); }
+    // Resolves once all of `size` bytes are written.
+    WriteOperation write(const char* data, std::size_t size) { return WriteOperation(*this, data, size); }
+    // Runs the layer's handshake; resolves to 0 once it is complete.
+    HandshakeOperation handshake() { return HandshakeOperation(*this); }
+    // Accepted sockets are already non-blocking. On -1, errno tells why;
+    // EMFILE, ENFILE, ENOBUFS and ENOMEM mean retry after a pause.
+    AcceptOperation accept(IpAddress* peerIp) { return AcceptOperation(*this, peerIp); }
+    // Resumes a suspended read() now with kInterrupted, so another coroutine
+    // on this loop can get the reader's attention; anything else in progress
+    // is left alone.
+    void interruptRead() { loop_.interrupt(*this); }
+
+    int fd() const { return fd_; }
+
+private:
+    friend class EventLoop;
+
+    EventLoop& loop_;
+    int fd_;
+    TransportLayer* layer_;
+};
+
+// One cache line per fd, fields touched on every event first.
+struct alignas(64) EventLoop::Slot {
+    AsyncSocket::Operation* pending{nullptr};
+    std::uint32_t generation{0};
+    bool registered{false};
+    bool idleTimeout{false};
+    std::chrono::steady_clock::time_point lastActive{};
+    AsyncSocket* socket{nullptr};
+};
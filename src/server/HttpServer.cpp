@@ -1,27 +1,90 @@
 #include "server/HttpServer.h"
 
+#include <algorithm>
 #include <cerrno>
 #include <chrono>
+#include <csignal>
+#include <cstdio>
 #include <cstring>
 #include <stdexcept>
+#include <thread>
 #include <utility>
 #include <vector>
 #include <unistd.h>
 
-#if defined(__APPLE__)
-#include <sys/event.h>
-#endif
-
 #include "handlers/ErrorHandler.h"
 #include "http/HttpParser.h"
+#include "utils/CpuAffinity.h"
+
+namespace {
+
+// Time since `started`, less the phases recorded meanwhile (queue wait,
+// cache, disk), is the handler's own.
+void chargeHandler(RequestTrace& trace, std::uint64_t started, std::uint64_t tracedBefore) {
+    trace.add(Phase::Handler, CycleClock::now() - started - (trace.total() - tracedBefore));
+}
+
+// Every other setting keeps its ServerConfig default.
+ServerConfig defaultConfig(int port, std::size_t numThreads, std::string docRoot, bool useEventLoop) {
+    ServerConfig config;
+    config.port = port;
+    config.numThreads = numThreads;
+    config.docRoot = std::move(docRoot);
+    config.useEventLoop = useEventLoop;
+    return config;
+}
 
-HttpServer::HttpServer(int port, std::size_t numThreads, std::string docRoot, bool useKqueue)
-    : port_(port),
-      docRoot_(std::move(docRoot)),
-      useKqueue_(useKqueue),
-      threadPool_(numThreads),
+}  // namespace
+
+HttpServer::HttpServer(ServerConfig config)
+    : port_(config.port),
+      docRoot_(std::move(config.docRoot)),
+      archivePath_(std::move(config.archivePath)),
+      useEventLoop_(config.useEventLoop),
+      numLoops_(config.numThreads == 0 ? 1 : config.numThreads),
+      workerCpus_(config.workerCpus),
+      acceptorCpus_(std::move(config.acceptorCpus)),
+      http2_(config.http2),
+      tlsPort_(config.tlsPort),
+      ipLimiter_(config.ipLimits),
+      accessLog_(config.accessLog ? std::make_unique<AccessLog>(std::move(config.accessLogOptions)) : nullptr),
+      // In event-loop mode the pool is the blocking-I/O pool; the loops own
+      // the worker CPUs.
+      threadPool_(threadpool::ThreadPoolOptions{
+          config.useEventLoop ? config.ioThreads : config.numThreads,
+          config.useEventLoop ? std::vector<int>{} : std::move(config.workerCpus), config.maxThreads,
+          config.spawnAfter, config.retireAfter}),
       fileCache_(1024),
-      fileHandler_(docRoot_, &fileCache_) {}
+      fileHandler_(docRoot_, &fileCache_),
+      handler_(&fileHandler_),
+      metricsHandler_(metrics_),
+      slowRequestNs_(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(config.slowRequestThreshold).count())) {
+    BufferPool::setHugePages(config.hugePages);
+    // Before any thread takes a timestamp.
+    CycleClock::calibrate();
+    if (config.admission.mode != AdmissionConfig::Mode::Off) {
+        admission_ = std::make_unique<AdmissionController>(threadPool_, config.admission);
+    }
+    if (!archivePath_.empty()) {
+        archiveHandler_ = std::make_unique<ArchiveHandler>(archivePath_);
+        handler_ = archiveHandler_.get();
+    }
+    if (tlsPort_ != 0) {
+        config.tls.http2 = http2_;
+        tlsContext_ = std::make_unique<TlsContext>(config.tls);
+        // OpenSSL writes to the socket without MSG_NOSIGNAL.
+        std::signal(SIGPIPE, SIG_IGN);
+    }
+    for (ProxyConfig& proxy : config.proxies) {
+        proxies_.push_back(std::make_unique<ProxyHandler>(std::move(proxy)));
+    }
+    buildRoutes(config.metricsPath, config.healthPath);
+    registerMetrics();
+}
+
+HttpServer::HttpServer(int port, std::size_t numThreads, std::string docRoot, bool useEventLoop)
+    : HttpServer(defaultConfig(port, numThreads, std::move(docRoot), useEventLoop)) {}
 
 HttpServer::~HttpServer() {
     stop();
@@ -36,25 +99,76 @@ void HttpServer::start() {
     listenSocket_->setReuseAddr();
     listenSocket_->bind(port_);
     listenSocket_->listen(128);
+    if (tlsContext_) {
+        tlsListenSocket_ = std::make_unique<Socket>();
+        tlsListenSocket_->setReuseAddr();
+        tlsListenSocket_->bind(tlsPort_);
+        tlsListenSocket_->listen(128);
+    }
+    for (const auto& proxy : proxies_) {
+        proxy->start();
+    }
 
-    if (useKqueue_) {
-#if !defined(__APPLE__)
-        throw std::runtime_error("kqueue mode is only supported on macOS/BSD platforms");
-#else
+    if (useEventLoop_) {
+        // One loop per worker thread, all accepting from the shared
+        // non-blocking listen sockets.
         listenSocket_->setNonBlocking();
-        ioThread_ = std::thread([this]() { runKqueueLoop(); });
-        logger_.log("Server started on port " + std::to_string(port_) + " (kqueue mode)");
-#endif
+        if (tlsListenSocket_) {
+            tlsListenSocket_->setNonBlocking();
+        }
+        for (std::size_t i = 0; i < numLoops_; ++i) {
+            eventLoops_.push_back(std::make_unique<EventLoop>(std::chrono::seconds(60)));
+        }
+        for (std::size_t i = 0; i < numLoops_; ++i) {
+            loopThreads_.emplace_back([this, i]() {
+                if (!workerCpus_.empty()) {
+                    (void)affinity::pinCurrentThread({workerCpus_[i % workerCpus_.size()]});
+                }
+                EventLoop& loop = *eventLoops_[i];
+                acceptAsync(loop, listenSocket_->getFd(), false);
+                if (tlsListenSocket_) {
+                    acceptAsync(loop, tlsListenSocket_->getFd(), true);
+                }
+                loop.run();
+            });
+        }
+        logger_.log("Server started on port " + std::to_string(port_) + " (event-loop mode, " +
+                    std::to_string(numLoops_) + " loops)");
+        if (tlsListenSocket_) {
+            logger_.log("TLS on port " + std::to_string(tlsPort_));
+        }
         return;
     }
 
+    idlePoller_ = std::make_unique<IdlePoller>(
+        [this](Socket socket, IpLimiter::Lease lease, std::unique_ptr<http::Http2Session> http2) {
+            resumeConnection(std::move(socket), std::move(lease), std::move(http2));
+        },
+        std::chrono::seconds(60));
+    idlePoller_->start();
     acceptor_ = std::make_unique<Acceptor>(std::move(*listenSocket_), threadPool_,
-                                           [this](Socket socket, std::string clientIp) {
-                                               handleConnection(std::move(socket), std::move(clientIp));
+                                           [this](Socket socket, IpAddress clientIp, std::uint64_t acceptedAt) {
+                                               handleConnection(std::move(socket), clientIp, acceptedAt, false);
                                            });
     listenSocket_.reset();
+    acceptor_->setCpuAffinity(acceptorCpus_);
+    acceptor_->setAdmissionController(admission_.get());
     acceptor_->start();
     logger_.log("Server started on port " + std::to_string(port_) + " (thread-pool mode)");
+    if (tlsListenSocket_) {
+        tlsAcceptor_ = std::make_unique<Acceptor>(std::move(*tlsListenSocket_), threadPool_,
+                                                  [this](Socket socket, IpAddress clientIp, std::uint64_t acceptedAt) {
+                                                      handleConnection(std::move(socket), clientIp, acceptedAt, true);
+                                                  });
+        tlsListenSocket_.reset();
+        tlsAcceptor_->setCpuAffinity(acceptorCpus_);
+        // The canned 503 is plain text; TLS clients are only ever paused.
+        if (admission_ && admission_->mode() == AdmissionConfig::Mode::PauseAccept) {
+            tlsAcceptor_->setAdmissionController(admission_.get());
+        }
+        tlsAcceptor_->start();
+        logger_.log("TLS on port " + std::to_string(tlsPort_));
+    }
 }
 
 void HttpServer::stop() {
@@ -65,454 +179,1030 @@ void HttpServer::stop() {
     if (acceptor_) {
         acceptor_->stop();
     }
-    if (listenSocket_) {
-        listenSocket_->shutdownReadWrite();
-        listenSocket_->close();
+    if (tlsAcceptor_) {
+        tlsAcceptor_->stop();
+    }
+    if (idlePoller_) {
+        idlePoller_->stop();
+    }
+    for (auto& loop : eventLoops_) {
+        loop->stop();
+    }
+    for (auto& thread : loopThreads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
     }
-    if (ioThread_.joinable()) {
-        ioThread_.join();
+    for (auto* listener : {listenSocket_.get(), tlsListenSocket_.get()}) {
+        if (listener != nullptr) {
+            listener->shutdownReadWrite();
+            listener->close();
+        }
     }
     threadPool_.shutdown();
+    for (const auto& proxy : proxies_) {
+        proxy->stop();
+    }
+    if (admission_) {
+        logger_.log("Load shedding: " + std::to_string(admission_->rejected()) + " connections rejected, " +
+                    std::to_string(admission_->pausedPolls()) + " paused accept polls");
+    }
+    if (ipLimiter_.rejectedConnections() != 0 || ipLimiter_.throttledRequests() != 0) {
+        logger_.log("Per-IP limits: " + std::to_string(ipLimiter_.rejectedConnections()) + " connections refused, " +
+                    std::to_string(ipLimiter_.throttledRequests()) + " requests throttled");
+    }
+    if (accessLog_) {
+        accessLog_->stop();
+        if (accessLog_->dropped() != 0) {
+            logger_.log("Access log: " + std::to_string(accessLog_->dropped()) + " records dropped");
+        }
+    }
     logger_.log("Server stopped");
 }
 
-void HttpServer::runKqueueLoop() {
-#if defined(__APPLE__)
-    constexpr std::size_t kBufferSize = 8192;
-    constexpr std::size_t kMaxRequestBytes = 10 * 1024 * 1024;
-    constexpr auto kIdleTimeout = std::chrono::seconds(60);
-
-    struct ConnectionState {
-        Socket socket;
-        std::string clientIp;
-        std::string readBuffer;
-        std::string writeBuffer;
-        bool closeAfterWrite{false};
-        std::chrono::steady_clock::time_point lastActive;
-    };
-
-    auto registerEvent = [](int kq, int fd, int16_t filter, uint16_t flags) {
-        struct kevent ev;
-        EV_SET(&ev, fd, filter, flags, 0, 0, nullptr);
-        return ::kevent(kq, &ev, 1, nullptr, 0, nullptr);
-    };
-
-    int kq = ::kqueue();
-    if (kq < 0) {
-        logger_.error("kqueue() failed: " + std::string(std::strerror(errno)));
-        running_.store(false);
+void HttpServer::reload() {
+    if (accessLog_) {
+        accessLog_->reopen();
+    }
+    if (!archiveHandler_) {
         return;
     }
+    try {
+        archiveHandler_->reload();
+        logger_.log("Reloaded docroot archive " + archivePath_);
+    } catch (const std::exception& ex) {
+        logger_.error(std::string("Archive reload failed: ") + ex.what());
+    }
+}
 
-    if (registerEvent(kq, listenSocket_->getFd(), EVFILT_READ, EV_ADD | EV_ENABLE) < 0) {
-        logger_.error("kevent register listen socket failed: " + std::string(std::strerror(errno)));
-        ::close(kq);
-        running_.store(false);
-        return;
+DetachedTask HttpServer::acceptAsync(EventLoop& loop, int listenFd, bool tls) {
+    AsyncSocket listener(loop, listenFd, false);
+    while (loop.running()) {
+        IpAddress clientIp;
+        const ssize_t clientFd = co_await listener.accept(&clientIp);
+        if (clientFd < 0) {
+            if (Acceptor::exhausted(errno)) {
+                co_await loop.sleep(Acceptor::kExhaustedBackoff);
+            }
+            continue;
+        }
+        Socket client(static_cast<int>(clientFd));
+        IpLimiter::Lease lease;
+        if (!ipLimiter_.tryAcquire(clientIp, lease)) {
+            if (!tls) {
+                refuse(client);
+            }
+            continue;
+        }
+        metrics_.add(connectionsMetric_);
+        try {
+            client.setKeepAlive();
+            if (tls) {
+                client.setNoDelay();
+            }
+        } catch (const std::exception&) {
+        }
+        serveAsync(loop, std::move(client), std::move(lease), tls);
     }
+}
 
-    std::unordered_map<int, ConnectionState> connections;
-    connections.reserve(2048);
-    http::HttpParser parser;
-    std::vector<char> ioBuffer(kBufferSize);
-
-    auto closeConnection = [&](int fd) {
-        const auto it = connections.find(fd);
-        if (it == connections.end()) {
-            return;
-        }
-        releaseIpSlot(it->second.clientIp);
-        (void)registerEvent(kq, fd, EVFILT_READ, EV_DELETE);
-        (void)registerEvent(kq, fd, EVFILT_WRITE, EV_DELETE);
-        it->second.socket.shutdownReadWrite();
-        it->second.socket.close();
-        connections.erase(it);
-    };
+DetachedTask HttpServer::serveAsync(EventLoop& loop, Socket clientSocket, IpLimiter::Lease lease, bool tls) {
+    constexpr std::size_t kMinRead = 4096;
+    constexpr std::size_t kPacingChunk = 16 * 1024;
 
-    while (running_.load(std::memory_order_relaxed)) {
-        struct kevent events[256];
-        timespec timeout{};
-        timeout.tv_sec = 1;
-        timeout.tv_nsec = 0;
+    // The handshake is bounded by the loop's idle timeout like any read.
+    TlsConnection* tlsConnection = nullptr;
+    if (tls) {
+        std::unique_ptr<TlsConnection> layer = tlsContext_->accept(clientSocket.getFd());
+        if (!layer) {
+            metrics_.add(tlsFailuresMetric_);
+            co_return;
+        }
+        tlsConnection = layer.get();
+        clientSocket.setLayer(std::move(layer));
+    }
+    AsyncSocket connection(loop, clientSocket.getFd(), true, clientSocket.layer());
+    if (tlsConnection != nullptr) {
+        if (co_await connection.handshake() < 0) {
+            metrics_.add(tlsFailuresMetric_);
+            co_return;
+        }
+        countHandshake(*tlsConnection);
+    }
+    RecvBuffer requestBuffer;
+    RequestArena arena;
+    std::string responseBuffer;
+    ConnectionTrace connectionTrace;
+    std::unique_ptr<http::Http2Session> http2;
+    Http2Streams streams{connection};
 
-        const int eventCount = ::kevent(kq, nullptr, 0, events, 256, &timeout);
-        if (eventCount < 0) {
-            if (errno == EINTR) {
+    bool keepOpen = true;
+    while (keepOpen) {
+        // An HTTP/2 connection with DATA still allowed out, or with answered
+        // streams to write, does that first. A stream answered while this
+        // waits interrupts the read.
+        if ((!http2 || !http2->canSend()) && streams.answered.empty()) {
+            char* tail = requestBuffer.prepare(kMinRead);
+            const ssize_t bytesRead = co_await connection.read(tail, requestBuffer.writableBytes());
+            if (bytesRead == AsyncSocket::kInterrupted) {
                 continue;
             }
-            logger_.error("kevent wait failed: " + std::string(std::strerror(errno)));
-            break;
+            if (bytesRead <= 0) {
+                break;
+            }
+            requestBuffer.commit(static_cast<std::size_t>(bytesRead));
         }
 
-        for (int i = 0; i < eventCount; ++i) {
-            const auto& ev = events[i];
-            const int fd = static_cast<int>(ev.ident);
-
-            if ((ev.flags & EV_ERROR) != 0) {
-                if (fd != listenSocket_->getFd()) {
-                    closeConnection(fd);
-                }
+        if (!http2 && http2_) {
+            const auto preface = http::Http2Session::matchPreface(requestBuffer.data(), requestBuffer.size());
+            if (preface == http::Http2Session::Preface::Partial) {
                 continue;
             }
-
-            if (fd == listenSocket_->getFd() && ev.filter == EVFILT_READ) {
-                while (running_.load(std::memory_order_relaxed)) {
-                    std::string clientIp;
-                    Socket client( -1 );
-                    try {
-                        client = listenSocket_->accept(&clientIp);
-                    } catch (const std::exception&) {
-                        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                            break;
-                        }
-                        break;
-                    }
-
-                    if (!tryAcquireIpSlot(clientIp)) {
-                        http::HttpResponse response = handlers::create429();
-                        response.setHeader("Connection", "close");
-                        const std::string payload = response.serialize();
-                        try {
-                            (void)client.send(payload.c_str(), payload.size());
-                        } catch (const std::exception&) {
-                        }
-                        continue;
-                    }
-
-                    try {
-                        client.setNonBlocking();
-                        client.setKeepAlive();
-                    } catch (const std::exception&) {
-                        releaseIpSlot(clientIp);
-                        continue;
-                    }
-
-                    const int clientFd = client.getFd();
-                    ConnectionState state{std::move(client), clientIp, "", "", false,
-                                          std::chrono::steady_clock::now()};
-                    state.readBuffer.reserve(kBufferSize);
-                    connections.emplace(clientFd, std::move(state));
-                    (void)registerEvent(kq, clientFd, EVFILT_READ, EV_ADD | EV_ENABLE);
-                }
-                continue;
+            if (preface == http::Http2Session::Preface::Match) {
+                metrics_.add(http2ConnectionsMetric_);
+                http2 = std::make_unique<http::Http2Session>();
+                http2->start(responseBuffer);
             }
+        }
 
-            auto it = connections.find(fd);
-            if (it == connections.end()) {
-                continue;
+        while (!http2) {
+            // The previous request and response are gone; recycle their memory.
+            arena.reset();
+            http::HttpRequest request(arena.resource());
+            RequestTrace trace;
+            request.trace = &trace;
+            const ParseStep step = nextRequest(requestBuffer, lease, request, responseBuffer);
+            if (step != ParseStep::Request) {
+                keepOpen = step == ParseStep::NeedMore;
+                break;
             }
-            auto& conn = it->second;
-
-            if (ev.filter == EVFILT_READ) {
-                bool shouldClose = false;
-                while (true) {
-                    ssize_t bytesRead = 0;
-                    try {
-                        bytesRead = conn.socket.recv(ioBuffer.data(), ioBuffer.size());
-                    } catch (const std::exception&) {
-                        shouldClose = true;
-                        break;
-                    }
-                    if (bytesRead > 0) {
-                        conn.readBuffer.append(ioBuffer.data(), static_cast<std::size_t>(bytesRead));
-                        conn.lastActive = std::chrono::steady_clock::now();
-                        if (conn.readBuffer.size() > kMaxRequestBytes) {
-                            http::HttpResponse bad = handlers::create400("Request too large");
-                            bad.setHeader("Connection", "close");
-                            conn.writeBuffer += bad.serialize();
-                            conn.closeAfterWrite = true;
-                            break;
-                        }
-                        continue;
-                    }
-                    if (bytesRead == 0) {
-                        shouldClose = true;
-                    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        // Non-blocking socket drained.
-                    } else if (errno == EINTR) {
-                        continue;
-                    } else {
-                        shouldClose = true;
-                    }
+            if (http2_ && http::Http2Session::isUpgradeRequest(request)) {
+                http2 = upgradeToHttp2(request, responseBuffer);
+                if (http2) {
                     break;
                 }
+            }
 
-                while (!conn.readBuffer.empty() && !conn.closeAfterWrite) {
-                    http::HttpRequest request;
-                    std::size_t consumed = 0;
-                    bool parsed = false;
-                    try {
-                        parsed = parser.parse(conn.readBuffer.data(), conn.readBuffer.size(), request, consumed);
-                    } catch (const std::exception& ex) {
-                        http::HttpResponse bad = handlers::create400(ex.what());
-                        bad.setHeader("Connection", "close");
-                        conn.writeBuffer += bad.serialize();
-                        conn.closeAfterWrite = true;
-                        conn.readBuffer.clear();
-                        break;
-                    }
-                    if (!parsed) {
-                        break;
-                    }
-
-                    http::HttpResponse response;
-                    try {
-                        response = fileHandler_.handle(request);
-                    } catch (const std::exception& ex) {
-                        response = handlers::create500(ex.what());
-                    }
-                    response.setHeader("Connection", request.isKeepAlive() ? "keep-alive" : "close");
-                    conn.writeBuffer += response.serialize();
-                    logger_.log(request.method + " " + request.uri + " " + std::to_string(response.statusCode));
-                    conn.lastActive = std::chrono::steady_clock::now();
-
-                    conn.readBuffer.erase(0, consumed);
-                    if (!request.isKeepAlive()) {
-                        conn.closeAfterWrite = true;
-                    }
-                }
-
-                if (!conn.writeBuffer.empty()) {
-                    (void)registerEvent(kq, fd, EVFILT_WRITE, EV_ADD | EV_ENABLE);
-                }
-                if (shouldClose && conn.writeBuffer.empty()) {
-                    closeConnection(fd);
-                    continue;
-                }
+            // Cache hits are answered on the loop; anything that may block
+            // (cold file reads) runs on the I/O pool while this coroutine waits.
+            http::HttpResponse response = co_await respondAsync(loop, request);
+            if (!finishResponse(request, std::move(response), responseBuffer, connectionTrace)) {
+                keepOpen = false;
+                break;
             }
+        }
 
-            if (ev.filter == EVFILT_WRITE) {
-                while (!conn.writeBuffer.empty()) {
-                    ssize_t sent = 0;
-                    try {
-                        sent = conn.socket.send(conn.writeBuffer.data(), conn.writeBuffer.size());
-                    } catch (const std::exception&) {
-                        closeConnection(fd);
-                        break;
-                    }
-                    if (sent > 0) {
-                        conn.writeBuffer.erase(0, static_cast<std::size_t>(sent));
-                        conn.lastActive = std::chrono::steady_clock::now();
-                        continue;
-                    }
-                    if (sent < 0 && errno == EINTR) {
-                        continue;
-                    }
-                    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-                        break;
-                    }
-                    closeConnection(fd);
+        if (http2) {
+            keepOpen = http2->receive(requestBuffer, responseBuffer);
+            std::uint32_t streamId = 0;
+            while (keepOpen) {
+                http::HttpRequest* request = http2->nextRequest(streamId);
+                if (request == nullptr) {
                     break;
                 }
+                // Each stream gets its own coroutine, so one waiting on the
+                // I/O pool does not hold up the others; a fast-path answer
+                // is filed before this call returns.
+                ++streams.inFlight;
+                answerStreamAsync(loop, lease, *request, streamId, streams);
+            }
+            for (Http2Streams::Answer& answer : streams.answered) {
+                finishHttp2Response(*http2, answer.streamId, *answer.request, std::move(answer.response),
+                                    responseBuffer, answer.trace);
+            }
+            streams.answered.clear();
+            http2->flush(responseBuffer);
+            keepOpen = keepOpen && !http2->finished();
+        }
 
-                if (connections.find(fd) == connections.end()) {
-                    continue;
-                }
-                if (conn.writeBuffer.empty()) {
-                    (void)registerEvent(kq, fd, EVFILT_WRITE, EV_DELETE);
-                    if (conn.closeAfterWrite) {
-                        closeConnection(fd);
-                    }
+        if (!responseBuffer.empty()) {
+            const std::uint64_t sendStarted = CycleClock::now();
+            bool failed = false;
+            if (!lease.limitsBandwidth()) {
+                failed = co_await connection.write(responseBuffer.data(), responseBuffer.size()) < 0;
+            } else {
+                // Over-budget clients are paced chunk by chunk on the loop.
+                for (std::size_t offset = 0; offset < responseBuffer.size() && !failed; offset += kPacingChunk) {
+                    const std::size_t chunk = std::min(kPacingChunk, responseBuffer.size() - offset);
+                    co_await loop.sleep(lease.reserveBytes(chunk));
+                    failed = co_await connection.write(responseBuffer.data() + offset, chunk) < 0;
                 }
             }
+            finishSend(connectionTrace, sendStarted);
+            if (failed) {
+                break;
+            }
+            responseBuffer.clear();
+        }
+    }
+    // Streams still being answered use the session and the lease.
+    co_await streams.drained();
+}
+
+DetachedTask HttpServer::answerStreamAsync(EventLoop& loop, IpLimiter::Lease& lease, http::HttpRequest& request,
+                                           std::uint32_t streamId, Http2Streams& streams) {
+    Http2Streams::Answer answer{streamId, &request, {}, {}};
+    request.trace = &answer.trace;
+    std::optional<http::HttpResponse> response = admitHttp2(lease);
+    if (!response) {
+        response = co_await respondAsync(loop, request);
+    }
+    answer.response = std::move(*response);
+    streams.finish(std::move(answer));
+}
+
+// The connection is reading, waiting for the last stream, or busy (it then
+// sees the answer before its next read). It may finish inside this call, so
+// nothing here touches `this` after resuming it.
+void HttpServer::Http2Streams::finish(Answer answer) {
+    answered.push_back(std::move(answer));
+    --inFlight;
+    if (waiter) {
+        if (inFlight == 0) {
+            std::exchange(waiter, nullptr).resume();
         }
+    } else {
+        connection.interruptRead();
+    }
+}
 
-        const auto now = std::chrono::steady_clock::now();
-        std::vector<int> staleFds;
-        staleFds.reserve(connections.size());
-        for (const auto& [fd, conn] : connections) {
-            if (now - conn.lastActive >= kIdleTimeout) {
-                staleFds.push_back(fd);
+// Parses and answers every complete request in `input`, appending the
+// serialized responses to `output`. Each request and its response live in
+// `arena`, which is reset between requests. Returns false when the
+// connection must close once `output` is flushed. An Upgrade: h2c request
+// stops processing with the session in `upgraded`; it is answered over
+// HTTP/2.
+bool HttpServer::processRequests(RecvBuffer& input, RequestArena& arena, IpLimiter::Lease& lease,
+                                 std::string& output, ConnectionTrace& connectionTrace,
+                                 std::unique_ptr<http::Http2Session>& upgraded) {
+    while (true) {
+        arena.reset();
+        http::HttpRequest request(arena.resource());
+        RequestTrace trace;
+        request.trace = &trace;
+        const ParseStep step = nextRequest(input, lease, request, output);
+        if (step != ParseStep::Request) {
+            return step == ParseStep::NeedMore;
+        }
+        if (connectionTrace.queued != 0) {
+            trace.add(Phase::Queue, connectionTrace.queued);
+            connectionTrace.queued = 0;
+        }
+        if (http2_ && http::Http2Session::isUpgradeRequest(request)) {
+            upgraded = upgradeToHttp2(request, output);
+            if (upgraded) {
+                return true;
             }
         }
-        for (int fd : staleFds) {
-            closeConnection(fd);
+        if (!finishResponse(request, respond(request), output, connectionTrace)) {
+            return false;
         }
     }
+}
 
-    for (const auto& [fd, _] : connections) {
-        (void)fd;
+// Takes the next complete request off the front of `input`. Malformed or
+// oversized input appends a 400 to `output`, and a client over its request
+// rate gets a 429; both yield Close.
+HttpServer::ParseStep HttpServer::nextRequest(RecvBuffer& input, IpLimiter::Lease& lease, http::HttpRequest& request,
+                                              std::string& output) {
+    constexpr std::size_t kMaxRequestBytes = 10 * 1024 * 1024;
+    if (input.empty()) {
+        return ParseStep::NeedMore;
+    }
+
+    http::HttpParser parser;
+    bool parsed = false;
+    try {
+        PhaseTimer timer(request.trace, Phase::Parse);
+        parsed = parser.parse(input, request);
+    } catch (const std::exception& ex) {
+        http::HttpResponse bad = handlers::create400(ex.what());
+        bad.setHeader("Connection", "close");
+        const std::size_t before = output.size();
+        bad.serializeTo(output);
+        countResponse(bad.statusCode, output.size() - before);
+        return ParseStep::Close;
     }
-    std::vector<int> remainingFds;
-    remainingFds.reserve(connections.size());
-    for (const auto& [fd, _] : connections) {
-        remainingFds.push_back(fd);
+
+    if (!parsed) {
+        if (input.size() > kMaxRequestBytes) {
+            http::HttpResponse bad = handlers::create400("Request too large");
+            bad.setHeader("Connection", "close");
+            const std::size_t before = output.size();
+            bad.serializeTo(output);
+            countResponse(bad.statusCode, output.size() - before);
+            return ParseStep::Close;
+        }
+        return ParseStep::NeedMore;
     }
-    for (int fd : remainingFds) {
-        closeConnection(fd);
+    if (!lease.admitRequest()) {
+        http::HttpResponse throttled = handlers::create429();
+        throttled.setHeader("Retry-After", "1");
+        throttled.setHeader("Connection", "close");
+        const std::size_t before = output.size();
+        throttled.serializeTo(output);
+        countResponse(throttled.statusCode, output.size() - before);
+        return ParseStep::Close;
     }
+    return ParseStep::Request;
+}
 
-    ::close(kq);
-#endif
+// Routes the request and tries the handler's non-blocking fast path (cache
+// hits, built-in endpoints), which also answers unrouted requests. On
+// nullopt, `match` carries the route for respondBlocking().
+std::optional<http::HttpResponse> HttpServer::respondFast(http::HttpRequest& request, Router::Match& match) {
+    match = route(request);
+    if (match.handler == nullptr) {
+        return match.methodNotAllowed ? handlers::create405() : handlers::create404();
+    }
+    try {
+        return match.handler->handleNonBlocking(request);
+    } catch (const std::exception& ex) {
+        return handlers::create500(ex.what());
+    }
 }
 
-void HttpServer::handleConnection(Socket clientSocket, std::string clientIp) {
-    constexpr std::size_t kBufferSize = 8192;
-    constexpr std::size_t kMaxRequestBytes = 10 * 1024 * 1024;
-    constexpr auto kIdleTimeout = std::chrono::seconds(60);
+http::HttpResponse HttpServer::respondBlocking(http::HttpRequest& request, const Router::Match& match) {
+    try {
+        return match.handler->handle(request);
+    } catch (const std::exception& ex) {
+        return handlers::create500(ex.what());
+    }
+}
+
+// Answers the request on this thread, blocking if its handler does.
+http::HttpResponse HttpServer::respond(http::HttpRequest& request) {
+    const std::uint64_t started = CycleClock::now();
+    const std::uint64_t tracedBefore = request.trace->total();
+    Router::Match match;
+    std::optional<http::HttpResponse> response = respondFast(request, match);
+    if (!response) {
+        response = respondBlocking(request, match);
+    }
+    chargeHandler(*request.trace, started, tracedBefore);
+    return std::move(*response);
+}
+
+HttpServer::AsyncResponse::AsyncResponse(HttpServer& server, EventLoop& loop, http::HttpRequest& request)
+    : server_(server),
+      loop_(loop),
+      request_(request),
+      started_(CycleClock::now()),
+      tracedBefore_(request.trace->total()) {}
+
+bool HttpServer::AsyncResponse::await_ready() {
+    response_ = server_.respondFast(request_, match_);
+    return response_.has_value();
+}
+
+bool HttpServer::AsyncResponse::await_suspend(std::coroutine_handle<> handle) {
+    offload_.emplace(loop_, server_.threadPool_, BlockingCall{&server_, &request_, match_, CycleClock::now()});
+    return offload_->await_suspend(handle);
+}
+
+http::HttpResponse HttpServer::AsyncResponse::await_resume() {
+    if (offload_) {
+        response_ = offload_->await_resume();
+    }
+    if (!response_) {
+        response_ = handlers::create500("Request handler failed");
+    }
+    chargeHandler(*request_.trace, started_, tracedBefore_);
+    return std::move(*response_);
+}
+
+http::HttpResponse HttpServer::AsyncResponse::BlockingCall::operator()() {
+    request->trace->add(Phase::Queue, CycleClock::now() - queuedAt);
+    return server->respondBlocking(*request, match);
+}
+
+Router::Match HttpServer::route(http::HttpRequest& request) const {
+    const std::string_view path = std::string_view(request.uri).substr(0, request.uri.find('?'));
+    return router_.match(request.method, path, request.params);
+}
+
+// Built-in endpoints and proxies first; being more specific, they shadow
+// docroot files of the same path. The docroot takes everything else.
+void HttpServer::buildRoutes(const std::string& metricsPath, const std::string& healthPath) {
+    if (!metricsPath.empty()) {
+        router_.add("GET", metricsPath, metricsHandler_);
+    }
+    if (!healthPath.empty()) {
+        router_.add("GET", healthPath, healthHandler_);
+        router_.add("HEAD", healthPath, healthHandler_);
+    }
+    for (const auto& proxy : proxies_) {
+        std::string_view prefix = proxy->prefix();
+        while (!prefix.empty() && prefix.back() == '/') {
+            prefix.remove_suffix(1);
+        }
+        if (!router_.add("", std::string(prefix) + "/*", *proxy)) {
+            throw std::invalid_argument("Proxy prefix " + proxy->prefix() + " is mounted twice");
+        }
+    }
+    // Unless a proxy already took "/".
+    router_.add("", "/*", *handler_);
+}
+
+// Appends the response; returns whether the connection stays open.
+bool HttpServer::finishResponse(const http::HttpRequest& request, http::HttpResponse response, std::string& output,
+                                ConnectionTrace& trace) {
+    response.setHeader("Connection", request.isKeepAlive() ? "keep-alive" : "close");
+    const std::size_t before = output.size();
+    {
+        PhaseTimer timer(request.trace, Phase::Serialize);
+        response.serializeTo(output);
+    }
+    const std::size_t bytes = output.size() - before;
+    countResponse(response.statusCode, bytes);
+    if (accessLog_) {
+        accessLog_->record(request.method, request.uri, response.statusCode, bytes);
+    }
+
+    // Pipelined responses share one send, which is charged to the last.
+    if (trace.pending) {
+        recordTrace(trace.last);
+    }
+    trace.last = *request.trace;
+    trace.last.describe(request.method, request.uri, response.statusCode);
+    trace.pending = true;
+    return request.isKeepAlive();
+}
+
+void HttpServer::finishSend(ConnectionTrace& trace, std::uint64_t sendStarted) {
+    if (!trace.pending) {
+        return;
+    }
+    trace.last.add(Phase::Send, CycleClock::now() - sendStarted);
+    trace.pending = false;
+    recordTrace(trace.last);
+}
 
-    if (!tryAcquireIpSlot(clientIp)) {
-        http::HttpResponse response = handlers::create429();
-        response.setHeader("Connection", "close");
-        const std::string payload = response.serialize();
+// Switching needs the 101 and the server preface in `output`; a malformed
+// HTTP2-Settings header leaves the request to be served over HTTP/1.1.
+std::unique_ptr<http::Http2Session> HttpServer::upgradeToHttp2(const http::HttpRequest& request,
+                                                                std::string& output) {
+    auto session = std::make_unique<http::Http2Session>();
+    const std::size_t before = output.size();
+    output.append("HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    if (!session->startUpgrade(request, output)) {
+        output.resize(before);
+        return nullptr;
+    }
+    metrics_.add(http2ConnectionsMetric_);
+    return session;
+}
+
+// Streams over the client's request rate get a 429; the connection stays up.
+std::optional<http::HttpResponse> HttpServer::admitHttp2(IpLimiter::Lease& lease) {
+    if (lease.admitRequest()) {
+        return std::nullopt;
+    }
+    http::HttpResponse throttled = handlers::create429();
+    throttled.setHeader("Retry-After", "1");
+    return throttled;
+}
+
+// Answers every stream whose request is complete and writes each response
+// as soon as it is ready. Fast-path answers go out first; the rest are
+// offered to the pool one task per stream, and this worker runs whichever
+// nobody has claimed yet. Returns false if a send failed.
+bool HttpServer::answerHttp2(Socket& clientSocket, http::Http2Session& session, IpLimiter::Lease& lease,
+                             std::string& output) {
+    // Shared with the offered tasks, which may run after this returns.
+    auto batch = std::make_shared<Http2Batch>();
+    std::vector<std::size_t> blocking;
+    std::uint32_t streamId = 0;
+    while (http::HttpRequest* request = session.nextRequest(streamId)) {
+        Http2Batch::Job& job = batch->jobs.emplace_back();
+        job.streamId = streamId;
+        job.request = request;
+        job.started = CycleClock::now();
+        request->trace = &job.trace;
+        std::optional<http::HttpResponse> response = admitHttp2(lease);
+        if (!response) {
+            response = respondFast(*request, job.match);
+            if (!response) {
+                job.queuedAt = CycleClock::now();
+                blocking.push_back(batch->jobs.size() - 1);
+                continue;
+            }
+            chargeHandler(job.trace, job.started, 0);
+        }
+        job.claimed.store(true, std::memory_order_relaxed);
+        finishHttp2Response(session, streamId, *request, std::move(*response), output, job.trace);
+    }
+
+    bool sent = true;
+    auto send = [&]() {
+        session.flush(output);
+        if (sent && !output.empty()) {
+            sent = sendAll(clientSocket, output, lease);
+        }
+        output.clear();
+    };
+    std::size_t unwritten = blocking.size();
+    auto write = [&](std::size_t index) {
+        Http2Batch::Job& job = batch->jobs[index];
+        finishHttp2Response(session, job.streamId, *job.request, std::move(*job.response), output, job.trace);
+        send();
+        --unwritten;
+    };
+    auto writeFinished = [&]() {
+        std::vector<std::size_t> finished;
+        {
+            std::lock_guard<std::mutex> lock(batch->mutex);
+            finished.swap(batch->finished);
+        }
+        for (const std::size_t index : finished) {
+            write(index);
+        }
+    };
+
+    // The first is run here straight away, so it is not offered.
+    for (std::size_t i = 1; i < blocking.size(); ++i) {
         try {
-            (void)clientSocket.send(payload.c_str(), payload.size());
+            threadPool_.submit([this, batch, index = blocking[i]]() { (void)runHttp2Job(*batch, index, true); });
         } catch (const std::exception&) {
+            // Full or stopping; this worker runs the rest itself.
+            break;
+        }
+    }
+    send();
+    for (const std::size_t index : blocking) {
+        if (runHttp2Job(*batch, index, false)) {
+            write(index);
+        }
+        writeFinished();
+    }
+    while (unwritten > 0) {
+        {
+            threadpool::ThreadPool::BlockingScope waiting;
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->done.wait(lock, [&batch]() { return !batch->finished.empty(); });
+        }
+        writeFinished();
+    }
+    return sent;
+}
+
+// Runs a job unless another thread claimed it first. A pooled run files the
+// job for the connection's worker to write.
+bool HttpServer::runHttp2Job(Http2Batch& batch, std::size_t index, bool pooled) {
+    Http2Batch::Job& job = batch.jobs[index];
+    if (job.claimed.exchange(true, std::memory_order_acq_rel)) {
+        return false;
+    }
+    job.trace.add(Phase::Queue, CycleClock::now() - job.queuedAt);
+    job.response = respondBlocking(*job.request, job.match);
+    chargeHandler(job.trace, job.started, 0);
+    if (pooled) {
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.finished.push_back(index);
+        }
+        batch.done.notify_one();
+    }
+    return true;
+}
+
+// The stream, and `request` with it, may be gone once respond() returns, so
+// the log and trace use the trace's copies of the request line. Streams are
+// interleaved on the wire, so no Send phase is recorded.
+void HttpServer::finishHttp2Response(http::Http2Session& session, std::uint32_t streamId,
+                                     const http::HttpRequest& request, http::HttpResponse response,
+                                     std::string& output, RequestTrace& trace) {
+    const int statusCode = response.statusCode;
+    const std::size_t bodyBytes = request.method == "HEAD" ? 0 : response.bodySize();
+    trace.describe(request.method, request.uri, statusCode);
+    std::size_t headerBytes = 0;
+    {
+        PhaseTimer timer(&trace, Phase::Serialize);
+        headerBytes = session.respond(streamId, std::move(response), output);
+    }
+    countResponse(statusCode, headerBytes + bodyBytes);
+    if (accessLog_) {
+        accessLog_->record(std::string_view(trace.method, trace.methodLength),
+                           std::string_view(trace.uri, trace.uriLength), statusCode, headerBytes + bodyBytes);
+    }
+    recordTrace(trace);
+}
+
+void HttpServer::recordTrace(const RequestTrace& trace) {
+    std::uint64_t phaseNs[kPhaseCount];
+    std::uint64_t totalNs = 0;
+    for (std::size_t i = 0; i < kPhaseCount; ++i) {
+        phaseNs[i] = CycleClock::toNanoseconds(trace.ticks[i]);
+        totalNs += phaseNs[i];
+        if (trace.has(static_cast<Phase>(i))) {
+            metrics_.observe(phaseMetrics_[i], phaseNs[i]);
         }
+    }
+    metrics_.observe(requestDurationMetric_, totalNs);
+    if (slowRequestNs_ == 0 || totalNs < slowRequestNs_) {
         return;
     }
-    struct IpSlotGuard {
-        HttpServer* server;
-        std::string ip;
-        ~IpSlotGuard() { server->releaseIpSlot(ip); }
-    } ipSlotGuard{this, clientIp};
 
+    std::string line = "Slow request: ";
+    line.append(trace.method, trace.methodLength).append(" ").append(trace.uri, trace.uriLength);
+    char number[64];
+    std::snprintf(number, sizeof(number), " %d in %.3f ms (", trace.status, static_cast<double>(totalNs) / 1e6);
+    line.append(number);
+    const char* separator = "";
+    for (std::size_t i = 0; i < kPhaseCount; ++i) {
+        if (!trace.has(static_cast<Phase>(i))) {
+            continue;
+        }
+        std::snprintf(number, sizeof(number), "%s%.*s %.3f", separator, static_cast<int>(kPhaseNames[i].size()),
+                      kPhaseNames[i].data(), static_cast<double>(phaseNs[i]) / 1e6);
+        line.append(number);
+        separator = ", ";
+    }
+    line.append(" ms)");
+    logger_.log(line);
+}
+
+void HttpServer::countResponse(int statusCode, std::size_t bytes) {
+    const bool known = statusCode >= 0 && static_cast<std::size_t>(statusCode) < responsesMetric_.size();
+    metrics_.add(known ? responsesMetric_[static_cast<std::size_t>(statusCode)] : otherResponsesMetric_);
+    metrics_.add(responseBytesMetric_, bytes);
+}
+
+void HttpServer::registerMetrics() {
+    constexpr int kTrackedCodes[] = {200, 206, 304, 400, 403, 404, 405, 413, 429, 500, 502, 503, 504};
+    const char* help = "HTTP responses by status code";
+    otherResponsesMetric_ = metrics_.counter("http_responses_total", help, "code=\"other\"");
+    responsesMetric_.fill(otherResponsesMetric_);
+    for (const int code : kTrackedCodes) {
+        responsesMetric_[static_cast<std::size_t>(code)] =
+            metrics_.counter("http_responses_total", help, "code=\"" + std::to_string(code) + "\"");
+    }
+    responseBytesMetric_ = metrics_.counter("http_response_bytes_total", "Serialized response bytes, headers included");
+    connectionsMetric_ = metrics_.counter("http_connections_total", "Client connections accepted");
+    http2ConnectionsMetric_ = metrics_.counter("http2_connections_total", "Connections served over HTTP/2");
+    if (tlsContext_) {
+        tlsHandshakesMetric_ = metrics_.counter("tls_handshakes_total", "TLS handshakes completed");
+        tlsResumedMetric_ = metrics_.counter("tls_resumed_handshakes_total", "TLS handshakes resuming a session");
+        tlsFailuresMetric_ = metrics_.counter("tls_handshake_failures_total", "TLS handshakes failed or timed out");
+        tlsKernelMetric_ =
+            metrics_.counter("tls_kernel_offload_total", "TLS connections whose records the kernel encrypts (kTLS)");
+    }
+    requestDurationMetric_ = metrics_.histogram("http_request_duration_seconds",
+                                                "Sum of a request's phases, from pool queue to send");
+    for (std::size_t i = 0; i < kPhaseCount; ++i) {
+        phaseMetrics_[i] = metrics_.histogram("http_request_phase_seconds", "Time spent per request phase",
+                                              "phase=\"" + std::string(kPhaseNames[i]) + "\"");
+    }
+    fileCache_.setMetrics(&metrics_);
+    fileHandler_.setMetrics(&metrics_);
+    if (!proxies_.empty()) {
+        std::vector<ProxyHandler*> proxies;
+        for (const auto& proxy : proxies_) {
+            proxies.push_back(proxy.get());
+        }
+        ProxyHandler::registerMetrics(metrics_, proxies);
+    }
+    metrics_.addCollector([this](std::string& out) { collectMetrics(out); });
+}
+
+// Values that already live elsewhere, read only when scraped.
+void HttpServer::collectMetrics(std::string& out) const {
+    Metrics::appendGauge(out, "http_connections_active", "Open client connections",
+                         static_cast<double>(ipLimiter_.activeConnections()));
+    Metrics::appendCounter(out, "ip_limit_refused_connections_total", "Connections refused by the per-IP cap",
+                           ipLimiter_.rejectedConnections());
+    Metrics::appendCounter(out, "ip_limit_throttled_requests_total", "Requests refused by the per-IP rate",
+                           ipLimiter_.throttledRequests());
+    if (admission_) {
+        Metrics::appendCounter(out, "admission_rejected_connections_total", "Connections shed by admission control",
+                               admission_->rejected());
+    }
+    if (accessLog_) {
+        Metrics::appendCounter(out, "access_log_dropped_total", "Access log records dropped on a full ring",
+                               accessLog_->dropped());
+    }
+
+    const threadpool::ThreadPoolStats stats = threadPool_.stats();
+    std::uint64_t tasksRun = 0;
+    std::uint64_t steals = 0;
+    std::size_t active = 0;
+    std::size_t blocked = 0;
+    for (const threadpool::WorkerStats& worker : stats.workers) {
+        tasksRun += worker.tasksRun;
+        steals += worker.steals;
+        active += worker.active ? 1 : 0;
+        blocked += worker.blocked ? 1 : 0;
+    }
+    Metrics::appendGauge(out, "threadpool_workers", "Live pool workers", static_cast<double>(active));
+    Metrics::appendGauge(out, "threadpool_workers_blocked", "Pool workers blocked in I/O",
+                         static_cast<double>(blocked));
+    Metrics::appendGauge(out, "threadpool_pending_tasks", "Tasks queued in the pool",
+                         static_cast<double>(stats.pendingTasks));
+    Metrics::appendCounter(out, "threadpool_tasks_total", "Tasks run by the pool", tasksRun);
+    Metrics::appendCounter(out, "threadpool_steals_total", "Tasks stolen between workers", steals);
+    Metrics::appendCounter(out, "threadpool_dropped_tasks_total", "Tasks dropped past their deadline",
+                           stats.droppedTasks);
+    Metrics::appendHistogram(out, "threadpool_queue_wait_seconds", "Time tasks waited in the queue", stats.waitNs);
+}
+
+void HttpServer::handleConnection(Socket clientSocket, IpAddress clientIp, std::uint64_t acceptedAt, bool tls) {
+    IpLimiter::Lease lease;
+    if (!ipLimiter_.tryAcquire(clientIp, lease)) {
+        // A TLS client could not read the plain 429; it is just closed.
+        if (!tls) {
+            refuse(clientSocket);
+        }
+        return;
+    }
+    metrics_.add(connectionsMetric_);
     try {
         clientSocket.setReceiveTimeoutSeconds(1);
     } catch (const std::exception& ex) {
         logger_.error(std::string("Failed to set receive timeout: ") + ex.what());
     }
+    if (tls && !acceptTls(clientSocket)) {
+        return;
+    }
+    serveConnection(std::move(clientSocket), std::move(lease), acceptedAt, nullptr);
+}
 
-    std::vector<char> buffer(kBufferSize);
-    std::string requestBuffer;
-    requestBuffer.reserve(kBufferSize);
-    http::HttpParser parser;
-    auto lastActive = std::chrono::steady_clock::now();
-
-    while (running_.load(std::memory_order_relaxed)) {
-        bool progressed = false;
+// Blocking handshake on the worker. The 1s receive timeout lets it notice a
+// stop; the client gets 10 seconds to finish.
+bool HttpServer::acceptTls(Socket& clientSocket) {
+    constexpr auto kHandshakeTimeout = std::chrono::seconds(10);
+    try {
+        // Each TLS record is its own write; Nagle would hold the tail of a
+        // response back until the client's delayed ACK.
+        clientSocket.setNoDelay();
+    } catch (const std::exception&) {
+    }
+    std::unique_ptr<TlsConnection> tls = tlsContext_->accept(clientSocket.getFd());
+    if (!tls) {
+        metrics_.add(tlsFailuresMetric_);
+        return false;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + kHandshakeTimeout;
+    while (true) {
+        int result = 0;
+        {
+            threadpool::ThreadPool::BlockingScope blocking;
+            result = tls->handshake();
+        }
+        if (result > 0) {
+            break;
+        }
+        const bool retry = errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        if (!retry || std::chrono::steady_clock::now() >= deadline || !running_.load(std::memory_order_relaxed)) {
+            metrics_.add(tlsFailuresMetric_);
+            return false;
+        }
+    }
+    countHandshake(*tls);
+    clientSocket.setLayer(std::move(tls));
+    return true;
+}
 
-        while (!requestBuffer.empty()) {
-            http::HttpRequest request;
-            std::size_t consumed = 0;
-            bool parsed = false;
+void HttpServer::countHandshake(const TlsConnection& connection) {
+    metrics_.add(tlsHandshakesMetric_);
+    if (connection.resumed()) {
+        metrics_.add(tlsResumedMetric_);
+    }
+    if (connection.kernelSend()) {
+        metrics_.add(tlsKernelMetric_);
+    }
+}
 
-            try {
-                parsed = parser.parse(requestBuffer.data(), requestBuffer.size(), request, consumed);
-            } catch (const std::exception& ex) {
-                http::HttpResponse bad = handlers::create400(ex.what());
-                bad.setHeader("Connection", "close");
-                const std::string payload = bad.serialize();
-                try {
-                    (void)clientSocket.send(payload.c_str(), payload.size());
-                } catch (const std::exception&) {
-                }
-                return;
-            }
+// The lease is released when the connection closes; an idle connection keeps
+// it, and an HTTP/2 connection its session, while parked in the idle poller.
+void HttpServer::serveConnection(Socket clientSocket, IpLimiter::Lease lease, std::uint64_t queuedAt,
+                                 std::unique_ptr<http::Http2Session> http2) {
+    bool idle = false;
+    if (http2) {
+        RecvBuffer input;
+        std::string output;
+        idle = serveHttp2(clientSocket, lease, input, *http2, output);
+    } else {
+        idle = processConnection(clientSocket, lease, queuedAt, http2);
+    }
+    if (idle && idlePoller_) {
+        (void)idlePoller_->park(clientSocket, lease, http2);
+    }
+}
 
-            if (!parsed) {
-                break;
-            }
-            progressed = true;
+void HttpServer::resumeConnection(Socket clientSocket, IpLimiter::Lease lease,
+                                  std::unique_ptr<http::Http2Session> http2) {
+    auto task = [this, clientSocket = std::move(clientSocket), lease = std::move(lease), http2 = std::move(http2),
+                 queuedAt = CycleClock::now()]() mutable {
+        serveConnection(std::move(clientSocket), std::move(lease), queuedAt, std::move(http2));
+    };
+    static_assert(sizeof(task) <= threadpool::Task::kInlineSize,
+                  "connection closure must fit in Task's inline storage");
+    try {
+        threadPool_.submit(std::move(task));
+    } catch (const std::exception&) {
+        // Only during shutdown; the connection is dropped.
+    }
+}
 
-            http::HttpResponse response;
-            try {
-                response = fileHandler_.handle(request);
-            } catch (const std::exception& ex) {
-                response = handlers::create500(ex.what());
-            }
-            response.setHeader("Connection", request.isKeepAlive() ? "keep-alive" : "close");
-
-            const std::string responseStr = response.serialize();
-            std::size_t totalSent = 0;
-            while (totalSent < responseStr.size()) {
-                ssize_t sent = 0;
-                try {
-                    sent = clientSocket.send(responseStr.data() + totalSent, responseStr.size() - totalSent);
-                } catch (const std::exception&) {
-                    return;
-                }
-                if (sent < 0) {
-                    if (errno == EINTR) {
-                        continue;
-                    }
-                    return;
-                }
-                if (sent == 0) {
-                    return;
-                }
-                totalSent += static_cast<std::size_t>(sent);
-            }
+// Over the per-IP connection limit: answer 429 and close.
+void HttpServer::refuse(Socket& clientSocket) {
+    http::HttpResponse response = handlers::create429();
+    response.setHeader("Connection", "close");
+    const std::string payload = response.serialize();
+    try {
+        (void)clientSocket.send(payload.c_str(), payload.size());
+    } catch (const std::exception&) {
+    }
+}
 
-            logger_.log(request.method + " " + request.uri + " " + std::to_string(response.statusCode));
-            lastActive = std::chrono::steady_clock::now();
+// Serves requests until the connection should close (returns false) or has
+// no buffered bytes left after a keep-alive response or a receive timeout
+// (returns true, only when an idle poller can take it). A connection that
+// switches to HTTP/2 leaves its session in `http2`.
+bool HttpServer::processConnection(Socket& clientSocket, IpLimiter::Lease& lease, std::uint64_t queuedAt,
+                                   std::unique_ptr<http::Http2Session>& http2) {
+    constexpr std::size_t kMinRead = 4096;
+    constexpr auto kIdleTimeout = std::chrono::seconds(60);
+    const bool canPark = idlePoller_ != nullptr;
 
-            if (consumed > requestBuffer.size()) {
-                return;
-            }
-            requestBuffer.erase(0, consumed);
+    RecvBuffer requestBuffer;
+    RequestArena arena;
+    std::string responseBuffer;
+    auto lastActive = std::chrono::steady_clock::now();
+    ConnectionTrace connectionTrace;
+    connectionTrace.queued = CycleClock::now() - queuedAt;
 
-            if (!request.isKeepAlive()) {
-                return;
+    while (running_.load(std::memory_order_relaxed)) {
+        auto preface = http::Http2Session::Preface::Mismatch;
+        if (http2_ && !requestBuffer.empty()) {
+            preface = http::Http2Session::matchPreface(requestBuffer.data(), requestBuffer.size());
+            if (preface == http::Http2Session::Preface::Match) {
+                metrics_.add(http2ConnectionsMetric_);
+                http2 = std::make_unique<http::Http2Session>();
+                http2->start(responseBuffer);
+                return serveHttp2(clientSocket, lease, requestBuffer, *http2, responseBuffer);
             }
         }
-
-        if (requestBuffer.size() > kMaxRequestBytes) {
-            http::HttpResponse bad = handlers::create400("Request too large");
-            bad.setHeader("Connection", "close");
-            const std::string payload = bad.serialize();
-            try {
-                (void)clientSocket.send(payload.c_str(), payload.size());
-            } catch (const std::exception&) {
+        if (!requestBuffer.empty() && preface != http::Http2Session::Preface::Partial) {
+            const bool keepOpen =
+                processRequests(requestBuffer, arena, lease, responseBuffer, connectionTrace, http2);
+            if (http2) {
+                return serveHttp2(clientSocket, lease, requestBuffer, *http2, responseBuffer);
+            }
+            if (!responseBuffer.empty()) {
+                const std::uint64_t sendStarted = CycleClock::now();
+                const bool sent = sendAll(clientSocket, responseBuffer, lease);
+                finishSend(connectionTrace, sendStarted);
+                if (!sent) {
+                    return false;
+                }
+                responseBuffer.clear();
+                lastActive = std::chrono::steady_clock::now();
+                if (keepOpen && canPark && requestBuffer.empty() && !clientSocket.hasPendingInput()) {
+                    return true;
+                }
+            }
+            if (!keepOpen) {
+                return false;
             }
-            return;
         }
 
         ssize_t bytesRead = 0;
         try {
-            bytesRead = clientSocket.recv(buffer.data(), buffer.size());
+            threadpool::ThreadPool::BlockingScope blocking;
+            char* tail = requestBuffer.prepare(kMinRead);
+            bytesRead = clientSocket.recv(tail, requestBuffer.writableBytes());
         } catch (const std::exception&) {
-            return;
+            return false;
         }
         if (bytesRead == 0) {
-            return;
+            return false;
         }
         if (bytesRead < 0) {
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (canPark && requestBuffer.empty()) {
+                    return true;
+                }
                 if (std::chrono::steady_clock::now() - lastActive >= kIdleTimeout) {
-                    return;
+                    return false;
                 }
                 continue;
             }
             if (errno == EINTR) {
                 continue;
             }
-            return;
+            return false;
         }
 
-        requestBuffer.append(buffer.data(), static_cast<std::size_t>(bytesRead));
+        requestBuffer.commit(static_cast<std::size_t>(bytesRead));
         lastActive = std::chrono::steady_clock::now();
-        if (!progressed && bytesRead == 0) {
-            return;
-        }
     }
+    return false;
 }
 
-bool HttpServer::tryAcquireIpSlot(const std::string& clientIp) {
-    if (clientIp.empty()) {
-        return true;
-    }
-    std::lock_guard<std::mutex> lock(ipMutex_);
-    std::size_t& count = ipConnections_[clientIp];
-    if (count >= maxConnectionsPerIp_) {
-        return false;
+// Serves an upgraded or prior-knowledge HTTP/2 connection. Like
+// processConnection(), returns true when it has gone quiet with nothing
+// buffered and an idle poller can take it; the session travels with the
+// parked socket, so the worker is free between frames.
+bool HttpServer::serveHttp2(Socket& clientSocket, IpLimiter::Lease& lease, RecvBuffer& input,
+                            http::Http2Session& session, std::string& output) {
+    constexpr std::size_t kMinRead = 4096;
+    constexpr auto kIdleTimeout = std::chrono::seconds(60);
+    const bool canPark = idlePoller_ != nullptr;
+    auto lastActive = std::chrono::steady_clock::now();
+
+    while (running_.load(std::memory_order_relaxed)) {
+        const bool open = session.receive(input, output);
+        if (open && !answerHttp2(clientSocket, session, lease, output)) {
+            return false;
+        }
+        session.flush(output);
+        const bool wrote = !output.empty();
+        if (wrote) {
+            if (!sendAll(clientSocket, output, lease)) {
+                return false;
+            }
+            output.clear();
+            lastActive = std::chrono::steady_clock::now();
+        }
+        if (!open || session.finished()) {
+            return false;
+        }
+        if (session.canSend()) {
+            continue;
+        }
+        if (wrote && canPark && input.empty() && !clientSocket.hasPendingInput()) {
+            return true;
+        }
+
+        ssize_t bytesRead = 0;
+        try {
+            threadpool::ThreadPool::BlockingScope blocking;
+            char* tail = input.prepare(kMinRead);
+            bytesRead = clientSocket.recv(tail, input.writableBytes());
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (bytesRead == 0) {
+            return false;
+        }
+        if (bytesRead < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                return false;
+            }
+            if (errno != EINTR && canPark && input.empty()) {
+                return true;
+            }
+            if (std::chrono::steady_clock::now() - lastActive >= kIdleTimeout) {
+                return false;
+            }
+            continue;
+        }
+        input.commit(static_cast<std::size_t>(bytesRead));
+        lastActive = std::chrono::steady_clock::now();
     }
-    ++count;
-    return true;
+    return false;
 }
 
-void HttpServer::releaseIpSlot(const std::string& clientIp) {
-    if (clientIp.empty()) {
-        return;
-    }
-    std::lock_guard<std::mutex> lock(ipMutex_);
-    const auto it = ipConnections_.find(clientIp);
-    if (it == ipConnections_.end()) {
-        return;
-    }
-    if (it->second > 1) {
-        --it->second;
-    } else {
-        ipConnections_.erase(it);
+// Blocking send of the whole buffer. Clients over their bandwidth budget are
+// paced chunk by chunk; the worker counts as blocked while it waits.
+bool HttpServer::sendAll(Socket& clientSocket, const std::string& data, IpLimiter::Lease& lease) {
+    constexpr std::size_t kPacingChunk = 16 * 1024;
+    const bool paced = lease.limitsBandwidth();
+
+    std::size_t totalSent = 0;
+    while (totalSent < data.size()) {
+        std::size_t end = data.size();
+        if (paced) {
+            end = totalSent + std::min(kPacingChunk, data.size() - totalSent);
+            const auto delay = lease.reserveBytes(end - totalSent);
+            if (delay.count() > 0) {
+                threadpool::ThreadPool::BlockingScope blocking;
+                std::this_thread::sleep_for(delay);
+            }
+            if (!running_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+        }
+        while (totalSent < end) {
+            ssize_t sent = 0;
+            try {
+                threadpool::ThreadPool::BlockingScope blocking;
+                sent = clientSocket.send(data.data() + totalSent, end - totalSent);
+            } catch (const std::exception&) {
+                return false;
+            }
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            if (sent == 0) {
+                return false;
+            }
+            totalSent += static_cast<std::size_t>(sent);
+        }
     }
+    return true;
 }
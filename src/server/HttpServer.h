@@ -1,22 +1,83 @@
 #pragma once
 
+#include <array>
 #include <atomic>
-#include <mutex>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <thread>
-#include <unordered_map>
+#include <vector>
 
+#include "handlers/ArchiveHandler.h"
 #include "handlers/FileHandler.h"
+#include "handlers/HealthHandler.h"
+#include "handlers/MetricsHandler.h"
+#include "handlers/ProxyHandler.h"
+#include "http/Http2Session.h"
 #include "server/Acceptor.h"
+#include "server/AdmissionController.h"
+#include "server/EventLoop.h"
+#include "server/IdlePoller.h"
+#include "server/IpAddress.h"
+#include "server/IpLimiter.h"
+#include "server/Router.h"
 #include "server/Socket.h"
+#include "server/TlsContext.h"
 #include "threadpool/ThreadPool.h"
+#include "utils/AccessLog.h"
 #include "utils/FileCache.h"
 #include "utils/Logger.h"
+#include "utils/Metrics.h"
+#include "utils/RecvBuffer.h"
+#include "utils/RequestArena.h"
+#include "utils/RequestTrace.h"
+
+struct ServerConfig {
+    int port{8080};
+    std::size_t numThreads{4};
+    std::string docRoot{"./public"};
+    std::string archivePath;
+    // Per-core coroutine event loops instead of the thread pool.
+    bool useEventLoop{false};
+    std::vector<int> workerCpus;
+    std::vector<int> acceptorCpus;
+    std::size_t maxThreads{0};
+    std::chrono::milliseconds spawnAfter{50};
+    std::chrono::milliseconds retireAfter{10000};
+    AdmissionConfig admission;
+    // Event-loop mode: threads for blocking handler work (cold file reads).
+    std::size_t ioThreads{4};
+    // Back pooled I/O buffers with huge pages (explicit, else THP).
+    bool hugePages{false};
+    IpLimitConfig ipLimits;
+    // Request lines go to the asynchronous access log (stdout without a path).
+    bool accessLog{true};
+    AccessLog::Options accessLogOptions;
+    // Prometheus text exposition; an empty path disables it.
+    std::string metricsPath{"/metrics"};
+    // Liveness endpoint answering 200 "ok"; an empty path disables it.
+    std::string healthPath{"/healthz"};
+    // Log the phase breakdown of requests slower than this; 0 disables.
+    std::chrono::milliseconds slowRequestThreshold{0};
+    // HTTP/2 over cleartext: prior knowledge and Upgrade: h2c.
+    bool http2{true};
+    // TLS listener next to the plain one; 0 disables it.
+    int tlsPort{0};
+    TlsConfig tls;
+    // Path prefixes forwarded to upstream servers instead of the docroot.
+    std::vector<ProxyConfig> proxies;
+};
 
 class HttpServer {
 public:
-    HttpServer(int port, std::size_t numThreads, std::string docRoot, bool useKqueue = false);
+    explicit HttpServer(ServerConfig config);
+    HttpServer(int port, std::size_t numThreads, std::string docRoot, bool useEventLoop = false);
     ~HttpServer();
 
     HttpServer(const HttpServer&) = delete;
@@ -24,26 +85,186 @@ public:
 
     void start();
     void stop();
+    void reload();
 
 private:
-    void runKqueueLoop();
-    void handleConnection(Socket clientSocket, std::string clientIp);
-    bool tryAcquireIpSlot(const std::string& clientIp);
-    void releaseIpSlot(const std::string& clientIp);
+    enum class ParseStep { NeedMore, Request, Close };
+
+    // Phase timing carried across the requests of one connection. The last
+    // answered request waits in `last` until its response has been sent.
+    struct ConnectionTrace {
+        RequestTrace last;
+        bool pending{false};
+        // Pool queue wait, charged to the next request.
+        std::uint64_t queued{0};
+    };
+
+    // Awaitable respond() for the event loop: the fast path runs on the loop,
+    // the blocking path on the I/O pool with its wait charged to Phase::Queue.
+    class AsyncResponse {
+    public:
+        AsyncResponse(HttpServer& server, EventLoop& loop, http::HttpRequest& request);
+
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        http::HttpResponse await_resume();
+
+    private:
+        struct BlockingCall {
+            HttpServer* server;
+            http::HttpRequest* request;
+            Router::Match match;
+            std::uint64_t queuedAt;
+            http::HttpResponse operator()();
+        };
+
+        HttpServer& server_;
+        EventLoop& loop_;
+        http::HttpRequest& request_;
+        std::uint64_t started_;
+        std::uint64_t tracedBefore_;
+        Router::Match match_;
+        std::optional<http::HttpResponse> response_;
+        std::optional<EventLoop::OffloadOperation<BlockingCall>> offload_;
+    };
+
+    // HTTP/2 streams of one event-loop connection being answered side by
+    // side. Lives in the connection's coroutine frame; each stream's
+    // coroutine files its response here and gets the connection's attention.
+    struct Http2Streams {
+        struct Answer {
+            std::uint32_t streamId;
+            http::HttpRequest* request;
+            http::HttpResponse response;
+            RequestTrace trace;
+        };
+
+        // Resolves once no stream is in flight.
+        struct Drain {
+            Http2Streams& streams;
+            bool await_ready() const noexcept { return streams.inFlight == 0; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { streams.waiter = handle; }
+            void await_resume() const noexcept {}
+        };
+
+        void finish(Answer answer);
+        Drain drained() { return Drain{*this}; }
+
+        AsyncSocket& connection;
+        std::vector<Answer> answered{};
+        std::size_t inFlight{0};
+        std::coroutine_handle<> waiter{};
+    };
+
+    // HTTP/2 streams of one thread-pool connection whose handlers may block.
+    // Each job is offered to the pool, and whichever thread claims it first
+    // runs it, so the connection's worker never waits on queued work.
+    struct Http2Batch {
+        struct Job {
+            std::uint32_t streamId{0};
+            http::HttpRequest* request{nullptr};
+            Router::Match match;
+            RequestTrace trace;
+            std::uint64_t started{0};
+            std::uint64_t queuedAt{0};
+            std::optional<http::HttpResponse> response;
+            std::atomic<bool> claimed{false};
+        };
+
+        std::deque<Job> jobs;
+        std::mutex mutex;
+        std::condition_variable done;
+        // Jobs finished by other workers, not yet written.
+        std::vector<std::size_t> finished;
+    };
+
+    DetachedTask acceptAsync(EventLoop& loop, int listenFd, bool tls);
+    DetachedTask serveAsync(EventLoop& loop, Socket clientSocket, IpLimiter::Lease lease, bool tls);
+    bool processRequests(RecvBuffer& input, RequestArena& arena, IpLimiter::Lease& lease, std::string& output,
+                         ConnectionTrace& trace, std::unique_ptr<http::Http2Session>& upgraded);
+    ParseStep nextRequest(RecvBuffer& input, IpLimiter::Lease& lease, http::HttpRequest& request,
+                          std::string& output);
+    std::optional<http::HttpResponse> respondFast(http::HttpRequest& request, Router::Match& match);
+    http::HttpResponse respondBlocking(http::HttpRequest& request, const Router::Match& match);
+    http::HttpResponse respond(http::HttpRequest& request);
+    AsyncResponse respondAsync(EventLoop& loop, http::HttpRequest& request) { return {*this, loop, request}; }
+    Router::Match route(http::HttpRequest& request) const;
+    void buildRoutes(const std::string& metricsPath, const std::string& healthPath);
+    bool finishResponse(const http::HttpRequest& request, http::HttpResponse response, std::string& output,
+                        ConnectionTrace& trace);
+    void finishSend(ConnectionTrace& trace, std::uint64_t sendStarted);
+    std::unique_ptr<http::Http2Session> upgradeToHttp2(const http::HttpRequest& request, std::string& output);
+    std::optional<http::HttpResponse> admitHttp2(IpLimiter::Lease& lease);
+    DetachedTask answerStreamAsync(EventLoop& loop, IpLimiter::Lease& lease, http::HttpRequest& request,
+                                   std::uint32_t streamId, Http2Streams& streams);
+    bool answerHttp2(Socket& clientSocket, http::Http2Session& session, IpLimiter::Lease& lease, std::string& output);
+    bool runHttp2Job(Http2Batch& batch, std::size_t index, bool pooled);
+    void finishHttp2Response(http::Http2Session& session, std::uint32_t streamId, const http::HttpRequest& request,
+                             http::HttpResponse response, std::string& output, RequestTrace& trace);
+    void recordTrace(const RequestTrace& trace);
+    void countResponse(int statusCode, std::size_t bytes);
+    void registerMetrics();
+    void collectMetrics(std::string& out) const;
+    void handleConnection(Socket clientSocket, IpAddress clientIp, std::uint64_t acceptedAt, bool tls);
+    bool acceptTls(Socket& clientSocket);
+    void countHandshake(const TlsConnection& connection);
+    void serveConnection(Socket clientSocket, IpLimiter::Lease lease, std::uint64_t queuedAt,
+                         std::unique_ptr<http::Http2Session> http2);
+    bool processConnection(Socket& clientSocket, IpLimiter::Lease& lease, std::uint64_t queuedAt,
+                           std::unique_ptr<http::Http2Session>& http2);
+    bool serveHttp2(Socket& clientSocket, IpLimiter::Lease& lease, RecvBuffer& input, http::Http2Session& session,
+                    std::string& output);
+    bool sendAll(Socket& clientSocket, const std::string& data, IpLimiter::Lease& lease);
+    void resumeConnection(Socket clientSocket, IpLimiter::Lease lease, std::unique_ptr<http::Http2Session> http2);
+    static void refuse(Socket& clientSocket);
 
     int port_;
     std::string docRoot_;
-    bool useKqueue_;
+    std::string archivePath_;
+    bool useEventLoop_;
+    std::size_t numLoops_;
+    std::vector<int> workerCpus_;
+    std::vector<int> acceptorCpus_;
+    bool http2_;
+    int tlsPort_;
 
+    // Outlive everything that can hold a lease or record a request.
+    Metrics metrics_;
+    IpLimiter ipLimiter_;
+    std::unique_ptr<AccessLog> accessLog_;
+    std::unique_ptr<TlsContext> tlsContext_;
     threadpool::ThreadPool threadPool_;
+    std::unique_ptr<AdmissionController> admission_;
     std::unique_ptr<Acceptor> acceptor_;
+    std::unique_ptr<Acceptor> tlsAcceptor_;
+    std::unique_ptr<IdlePoller> idlePoller_;
     std::unique_ptr<Socket> listenSocket_;
-    std::thread ioThread_;
+    std::unique_ptr<Socket> tlsListenSocket_;
+    std::vector<std::unique_ptr<EventLoop>> eventLoops_;
+    std::vector<std::thread> loopThreads_;
     FileCache fileCache_;
     FileHandler fileHandler_;
+    std::unique_ptr<ArchiveHandler> archiveHandler_;
+    // Serves the docroot (or archive) behind every other route.
+    RequestHandler* handler_;
+    std::vector<std::unique_ptr<ProxyHandler>> proxies_;
+    MetricsHandler metricsHandler_;
+    HealthHandler healthHandler_;
+    Router router_;
     Logger logger_;
     std::atomic<bool> running_{false};
-    std::mutex ipMutex_;
-    std::unordered_map<std::string, std::size_t> ipConnections_;
-    const std::size_t maxConnectionsPerIp_{100};
+
+    // Indexed by status code; codes without their own series share "other".
+    std::array<Metrics::Id, 600> responsesMetric_{};
+    Metrics::Id otherResponsesMetric_{0};
+    Metrics::Id responseBytesMetric_{0};
+    Metrics::Id connectionsMetric_{0};
+    Metrics::Id http2ConnectionsMetric_{0};
+    Metrics::Id tlsHandshakesMetric_{0};
+    Metrics::Id tlsResumedMetric_{0};
+    Metrics::Id tlsFailuresMetric_{0};
+    Metrics::Id tlsKernelMetric_{0};
+    Metrics::Id requestDurationMetric_{0};
+    Metrics::Id phaseMetrics_[kPhaseCount]{};
+    std::uint64_t slowRequestNs_{0};
 };
@@ -0,0 +1,130 @@
+#include "server/IdlePoller.h"
+
+#include <vector>
+
+IdlePoller::IdlePoller(ResumeCallback resume, std::chrono::seconds idleTimeout)
+    : resume_(std::move(resume)), idleTimeout_(idleTimeout) {}
+
+IdlePoller::~IdlePoller() {
+    stop();
+}
+
+void IdlePoller::start() {
+    bool expected = false;
+    if (!running_.compare_exchange_strong(expected, true)) {
+        return;
+    }
+    thread_ = std::thread([this]() { run(); });
+}
+
+void IdlePoller::stop() {
+    bool expected = true;
+    if (!running_.compare_exchange_strong(expected, false)) {
+        return;
+    }
+    poller_.wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+
+    std::unordered_map<int, Entry> remaining;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        remaining.swap(entries_);
+    }
+    for (auto& [fd, entry] : remaining) {
+        poller_.remove(fd);
+    }
+}
+
+bool IdlePoller::park(Socket& socket, IpLimiter::Lease& lease, std::unique_ptr<http::Http2Session>& http2) {
+    if (!running_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    const int fd = socket.getFd();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.count(fd) != 0) {
+        return false;
+    }
+    // Insert before arming: the event may fire as soon as add() returns.
+    auto it = entries_
+                  .emplace(fd, Entry{std::move(socket), std::move(lease), std::move(http2),
+                                     std::chrono::steady_clock::now()})
+                  .first;
+    try {
+        poller_.add(fd, static_cast<std::uint64_t>(fd), Poller::kRead, true);
+    } catch (const std::exception&) {
+        socket = std::move(it->second.socket);
+        lease = std::move(it->second.lease);
+        http2 = std::move(it->second.http2);
+        entries_.erase(it);
+        return false;
+    }
+    return true;
+}
+
+std::size_t IdlePoller::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void IdlePoller::run() {
+    std::vector<Poller::Event> events;
+    auto nextSweep = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    while (running_.load(std::memory_order_acquire)) {
+        try {
+            poller_.wait(events, 1000);
+        } catch (const std::exception&) {
+            continue;
+        }
+
+        for (const Poller::Event& event : events) {
+            const int fd = static_cast<int>(event.token);
+            Socket socket(-1);
+            IpLimiter::Lease lease;
+            std::unique_ptr<http::Http2Session> http2;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                auto it = entries_.find(fd);
+                if (it == entries_.end()) {
+                    continue;
+                }
+                // Deregister while the fd is still open so a later park of the
+                // same fd number starts from a clean registration.
+                poller_.remove(fd);
+                socket = std::move(it->second.socket);
+                lease = std::move(it->second.lease);
+                http2 = std::move(it->second.http2);
+                entries_.erase(it);
+            }
+            // EOF and errors are resumed too; the worker's recv sees them.
+            resume_(std::move(socket), std::move(lease), std::move(http2));
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= nextSweep) {
+            expireIdle(now);
+            nextSweep = now + std::chrono::seconds(1);
+        }
+    }
+}
+
+void IdlePoller::expireIdle(std::chrono::steady_clock::time_point now) {
+    std::vector<Entry> stale;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            if (now - it->second.parkedAt >= idleTimeout_) {
+                poller_.remove(it->first);
+                stale.push_back(std::move(it->second));
+                it = entries_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    for (Entry& entry : stale) {
+        entry.socket.close();
+        entry.lease.release();
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "http/Http2Session.h"
+#include "server/IpLimiter.h"
+#include "server/Poller.h"
+#include "server/Socket.h"
+
+// Holds keep-alive connections that have no buffered request while they wait
+// for the client's next bytes, so they do not occupy pool workers. An HTTP/2
+// connection parks between frames with its session. A single thread watches
+// them and hands each one back through `resume` once it is readable (or hung
+// up); connections idle past the timeout are closed, which also drops their
+// per-IP lease. `resume` runs on the poller thread and must not throw.
+class IdlePoller {
+public:
+    using ResumeCallback = std::function<void(Socket, IpLimiter::Lease, std::unique_ptr<http::Http2Session>)>;
+
+    IdlePoller(ResumeCallback resume, std::chrono::seconds idleTimeout);
+    ~IdlePoller();
+
+    IdlePoller(const IdlePoller&) = delete;
+    IdlePoller& operator=(const IdlePoller&) = delete;
+
+    void start();
+    void stop();
+
+    // Takes ownership of an idle connection, its lease and its HTTP/2
+    // session, if any. Returns false (leaving all three untouched) if the
+    // poller is stopped or the fd cannot be watched.
+    bool park(Socket& socket, IpLimiter::Lease& lease, std::unique_ptr<http::Http2Session>& http2);
+
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        Socket socket;
+        IpLimiter::Lease lease;
+        std::unique_ptr<http::Http2Session> http2;
+        std::chrono::steady_clock::time_point parkedAt;
+    };
+
+    void run();
+    void expireIdle(std::chrono::steady_clock::time_point now);
+
+    ResumeCallback resume_;
+    std::chrono::seconds idleTimeout_;
+    Poller poller_;
+    mutable std::mutex mutex_;
+    std::unordered_map<int, Entry> entries_;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
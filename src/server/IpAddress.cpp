@@ -0,0 +1,40 @@
+#include "server/IpAddress.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+IpAddress IpAddress::fromSockaddr(const sockaddr* addr) {
+    IpAddress address;
+    if (addr == nullptr) {
+        return address;
+    }
+    if (addr->sa_family == AF_INET) {
+        const auto* in = reinterpret_cast<const sockaddr_in*>(addr);
+        address.bytes_[10] = 0xff;
+        address.bytes_[11] = 0xff;
+        std::memcpy(address.bytes_.data() + 12, &in->sin_addr, 4);
+        address.valid_ = true;
+    } else if (addr->sa_family == AF_INET6) {
+        const auto* in6 = reinterpret_cast<const sockaddr_in6*>(addr);
+        std::memcpy(address.bytes_.data(), &in6->sin6_addr, 16);
+        address.valid_ = true;
+    }
+    return address;
+}
+
+bool IpAddress::isV4() const {
+    static constexpr std::uint8_t kMappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xff, 0xff};
+    return valid_ && std::memcmp(bytes_.data(), kMappedPrefix, sizeof(kMappedPrefix)) == 0;
+}
+
+std::string IpAddress::toString() const {
+    if (!valid_) {
+        return {};
+    }
+    char buffer[INET6_ADDRSTRLEN] = {0};
+    const char* text = isV4() ? inet_ntop(AF_INET, bytes_.data() + 12, buffer, sizeof(buffer))
+                              : inet_ntop(AF_INET6, bytes_.data(), buffer, sizeof(buffer));
+    return text != nullptr ? std::string(text) : std::string();
+}
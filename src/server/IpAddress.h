@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct sockaddr;
+
+// Binary peer address. IPv4 is stored IPv4-mapped (::ffff:a.b.c.d) so both
+// families share one 16-byte representation that hashes and compares
+// without allocating.
+class IpAddress {
+public:
+    IpAddress() = default;
+
+    // Accepts AF_INET and AF_INET6; anything else yields an empty address.
+    static IpAddress fromSockaddr(const sockaddr* addr);
+
+    bool empty() const { return !valid_; }
+    bool isV4() const;
+    const std::array<std::uint8_t, 16>& bytes() const { return bytes_; }
+    std::string toString() const;
+
+    std::size_t hash() const noexcept {
+        std::uint64_t hi = 0;
+        std::uint64_t lo = 0;
+        for (std::size_t i = 0; i < 8; ++i) {
+            hi = (hi << 8) | bytes_[i];
+            lo = (lo << 8) | bytes_[i + 8];
+        }
+        std::uint64_t h = (hi * 0x9E3779B97F4A7C15ull) ^ lo;
+        h ^= h >> 29;
+        h *= 0xBF58476D1CE4E5B9ull;
+        return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+
+    friend bool operator==(const IpAddress&, const IpAddress&) = default;
+
+private:
+    std::array<std::uint8_t, 16> bytes_{};
+    bool valid_{false};
+};
+
+struct IpAddressHash {
+    std::size_t operator()(const IpAddress& address) const noexcept { return address.hash(); }
+};
@@ -0,0 +1,216 @@
+#include "server/IpLimiter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+IpLimiter::IpLimiter(IpLimitConfig config)
+    : maxConnections_(static_cast<std::uint32_t>(
+          std::min<std::size_t>(config.maxConnections, std::numeric_limits<std::uint32_t>::max()))),
+      slots_(new Slot[kShards * kSlotsPerShard]) {
+    if (config.requestsPerSecond > 0) {
+        requestInterval_ = std::max<std::int64_t>(1, static_cast<std::int64_t>(1e9 / config.requestsPerSecond));
+        requestTolerance_ = static_cast<std::int64_t>(static_cast<double>(requestInterval_) *
+                                                      std::max(config.requestBurst, 1.0));
+    }
+    if (config.bytesPerSecond > 0) {
+        nsPerByte_ = 1e9 / config.bytesPerSecond;
+        bandwidthTolerance_ = static_cast<std::int64_t>(nsPerByte_ * std::max(config.bandwidthBurst, 0.0));
+    }
+}
+
+std::int64_t IpLimiter::nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// A Busy slot is being (re)initialised by another thread for a handful of
+// stores; wait for it rather than risk inserting the same address twice.
+std::uint64_t IpLimiter::waitUntilSettled(Slot& slot) {
+    std::uint64_t control = slot.control.load(std::memory_order_acquire);
+    for (unsigned spins = 0; stateOf(control) == kBusy; ++spins) {
+        if (spins > 64) {
+            std::this_thread::yield();
+        }
+        control = slot.control.load(std::memory_order_acquire);
+    }
+    return control;
+}
+
+bool IpLimiter::tryAcquire(const IpAddress& address, Lease& lease) {
+    lease.release();
+    if (address.empty()) {
+        admitUntracked(lease);
+        return true;
+    }
+    std::uint64_t high;
+    std::uint64_t low;
+    std::memcpy(&high, address.bytes().data(), sizeof(high));
+    std::memcpy(&low, address.bytes().data() + sizeof(high), sizeof(low));
+    const std::size_t hash = address.hash();
+    Slot* shard = slots_.get() + (hash % kShards) * kSlotsPerShard;
+    const std::size_t start = (hash / kShards) % kSlotsPerShard;
+
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        switch (probe(shard, start, high, low, lease)) {
+            case Probe::Acquired:
+                return true;
+            case Probe::Full:
+                rejectedConnections_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            case Probe::Untracked:
+                admitUntracked(lease);
+                return true;
+            case Probe::Retry:
+                break;
+        }
+    }
+    admitUntracked(lease);
+    return true;
+}
+
+// Untracked leases carry no slot but still count as open connections.
+void IpLimiter::admitUntracked(Lease& lease) {
+    untrackedConnections_.fetch_add(1, std::memory_order_relaxed);
+    untrackedActive_.fetch_add(1, std::memory_order_relaxed);
+    lease = Lease(this, nullptr);
+}
+
+std::uint64_t IpLimiter::activeConnections() const {
+    std::uint64_t total = untrackedActive_.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < kShards * kSlotsPerShard; ++i) {
+        const std::uint64_t control = slots_[i].control.load(std::memory_order_relaxed);
+        if (stateOf(control) == kLive) {
+            total += countOf(control);
+        }
+    }
+    return total;
+}
+
+IpLimiter::Probe IpLimiter::probe(Slot* shard, std::size_t start, std::uint64_t high, std::uint64_t low,
+                                  Lease& lease) {
+    const std::int64_t now = nowNs();
+    Slot* reusable = nullptr;
+    std::uint64_t reusableControl = 0;
+
+    for (std::size_t i = 0; i < kMaxProbe; ++i) {
+        Slot& slot = shard[(start + i) % kSlotsPerShard];
+        std::uint64_t control = waitUntilSettled(slot);
+
+        if (stateOf(control) == kEmpty) {
+            // Slots never return to Empty, so the address is not further on.
+            if (!slot.control.compare_exchange_strong(control, makeControl(kBusy, 0, 0),
+                                                      std::memory_order_acquire)) {
+                return Probe::Retry;
+            }
+            claim(slot, 0, high, low, now);
+            lease = Lease(this, &slot);
+            return Probe::Acquired;
+        }
+
+        // Re-validated by the CAS below: a recycled slot changes its epoch.
+        const bool match = slot.keyHigh.load(std::memory_order_relaxed) == high &&
+                           slot.keyLow.load(std::memory_order_relaxed) == low;
+        if (match) {
+            const std::uint64_t epoch = epochOf(control);
+            while (true) {
+                if (stateOf(control) != kLive || epochOf(control) != epoch) {
+                    return Probe::Retry;
+                }
+                if (countOf(control) >= maxConnections_) {
+                    return Probe::Full;
+                }
+                if (slot.control.compare_exchange_weak(control, control + 1, std::memory_order_acquire)) {
+                    lease = Lease(this, &slot);
+                    return Probe::Acquired;
+                }
+            }
+        }
+
+        if (countOf(control) == 0 &&
+            (reusable == nullptr ||
+             slot.lastActive.load(std::memory_order_relaxed) < reusable->lastActive.load(std::memory_order_relaxed))) {
+            reusable = &slot;
+            reusableControl = control;
+        }
+    }
+
+    if (reusable == nullptr) {
+        return Probe::Untracked;
+    }
+    const std::uint64_t epoch = epochOf(reusableControl) + 1;
+    if (!reusable->control.compare_exchange_strong(reusableControl, makeControl(kBusy, epoch, 0),
+                                                   std::memory_order_acquire)) {
+        return Probe::Retry;
+    }
+    claim(*reusable, epoch, high, low, now);
+    lease = Lease(this, reusable);
+    return Probe::Acquired;
+}
+
+void IpLimiter::claim(Slot& slot, std::uint64_t epoch, std::uint64_t high, std::uint64_t low, std::int64_t now) {
+    slot.keyHigh.store(high, std::memory_order_relaxed);
+    slot.keyLow.store(low, std::memory_order_relaxed);
+    slot.requestTat.store(now, std::memory_order_relaxed);
+    slot.bandwidthTat.store(now, std::memory_order_relaxed);
+    slot.lastActive.store(now, std::memory_order_relaxed);
+    slot.control.store(makeControl(kLive, epoch, 1), std::memory_order_release);
+}
+
+IpLimiter::Lease& IpLimiter::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        limiter_ = other.limiter_;
+        slot_ = other.slot_;
+        other.limiter_ = nullptr;
+        other.slot_ = nullptr;
+    }
+    return *this;
+}
+
+void IpLimiter::Lease::release() {
+    if (slot_ == nullptr) {
+        if (limiter_ != nullptr) {
+            limiter_->untrackedActive_.fetch_sub(1, std::memory_order_relaxed);
+            limiter_ = nullptr;
+        }
+        return;
+    }
+    slot_->lastActive.store(nowNs(), std::memory_order_relaxed);
+    slot_->control.fetch_sub(1, std::memory_order_release);
+    slot_ = nullptr;
+    limiter_ = nullptr;
+}
+
+bool IpLimiter::Lease::admitRequest() {
+    if (slot_ == nullptr || limiter_->requestInterval_ == 0) {
+        return true;
+    }
+    const std::int64_t now = nowNs();
+    std::int64_t tat = slot_->requestTat.load(std::memory_order_relaxed);
+    while (true) {
+        const std::int64_t next = std::max(tat, now) + limiter_->requestInterval_;
+        if (next - now > limiter_->requestTolerance_) {
+            limiter_->throttledRequests_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        if (slot_->requestTat.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+std::chrono::nanoseconds IpLimiter::Lease::reserveBytes(std::size_t bytes) {
+    if (!limitsBandwidth()) {
+        return std::chrono::nanoseconds(0);
+    }
+    const std::int64_t now = nowNs();
+    const auto cost = static_cast<std::int64_t>(limiter_->nsPerByte_ * static_cast<double>(bytes));
+    std::int64_t tat = slot_->bandwidthTat.load(std::memory_order_relaxed);
+    std::int64_t next;
+    do {
+        next = std::max(tat, now) + cost;
+    } while (!slot_->bandwidthTat.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+    return std::chrono::nanoseconds(std::max<std::int64_t>(0, next - now - limiter_->bandwidthTolerance_));
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "server/IpAddress.h"
+
+struct IpLimitConfig {
+    // Concurrent connections per client address.
+    std::size_t maxConnections{100};
+    // Request rate per address; 0 disables. A client may run `requestBurst`
+    // requests ahead of the rate before it is refused.
+    double requestsPerSecond{0};
+    double requestBurst{20};
+    // Response bandwidth per address; 0 disables. Bytes beyond the burst are
+    // delayed, not refused.
+    double bytesPerSecond{0};
+    double bandwidthBurst{256 * 1024};
+};
+
+// Per-client connection counts and token buckets in a sharded, lock-free
+// open-addressing table keyed by binary address. A connection holds a Lease
+// pointing straight at its entry, so the rate checks and the release on close
+// never hash the address again. Entries with no connections are recycled
+// (oldest first) only when a probe window is full; if nothing can be
+// recycled the client is admitted untracked rather than refused.
+class IpLimiter {
+public:
+    static constexpr std::size_t kShards = 64;
+    static constexpr std::size_t kSlotsPerShard = 256;
+    static constexpr std::size_t kMaxProbe = 32;
+
+private:
+    // Token buckets are GCRA "theoretical arrival times" (steady-clock ns),
+    // each a single atomic updated by CAS.
+    struct alignas(64) Slot {
+        // state (2 bits) | epoch (30 bits) | connection count (32 bits)
+        std::atomic<std::uint64_t> control{0};
+        std::atomic<std::uint64_t> keyHigh{0};
+        std::atomic<std::uint64_t> keyLow{0};
+        std::atomic<std::int64_t> requestTat{0};
+        std::atomic<std::int64_t> bandwidthTat{0};
+        std::atomic<std::int64_t> lastActive{0};
+    };
+
+public:
+    class Lease {
+    public:
+        Lease() = default;
+        ~Lease() { release(); }
+
+        Lease(Lease&& other) noexcept : limiter_(other.limiter_), slot_(other.slot_) {
+            other.limiter_ = nullptr;
+            other.slot_ = nullptr;
+        }
+        Lease& operator=(Lease&& other) noexcept;
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        // Takes one request token; false means the client is over its rate.
+        bool admitRequest();
+        // Charges `bytes` against the bandwidth bucket and returns how long
+        // to wait before sending them.
+        std::chrono::nanoseconds reserveBytes(std::size_t bytes);
+        bool limitsBandwidth() const { return slot_ != nullptr && limiter_->nsPerByte_ > 0; }
+
+        void release();
+
+    private:
+        friend class IpLimiter;
+        Lease(IpLimiter* limiter, Slot* slot) : limiter_(limiter), slot_(slot) {}
+
+        IpLimiter* limiter_{nullptr};
+        Slot* slot_{nullptr};
+    };
+
+    explicit IpLimiter(IpLimitConfig config);
+
+    IpLimiter(const IpLimiter&) = delete;
+    IpLimiter& operator=(const IpLimiter&) = delete;
+
+    // Returns false when `address` is at its connection limit. An empty
+    // address is always admitted without tracking.
+    bool tryAcquire(const IpAddress& address, Lease& lease);
+
+    std::uint64_t rejectedConnections() const { return rejectedConnections_.load(std::memory_order_relaxed); }
+    std::uint64_t throttledRequests() const { return throttledRequests_.load(std::memory_order_relaxed); }
+    std::uint64_t untrackedConnections() const { return untrackedConnections_.load(std::memory_order_relaxed); }
+    // Open connections, tracked or not; scans the table, so meant for scrapes.
+    std::uint64_t activeConnections() const;
+
+private:
+    enum : std::uint64_t { kEmpty = 0, kBusy = 1, kLive = 2 };
+
+    static std::uint64_t stateOf(std::uint64_t control) { return control >> 62; }
+    static std::uint64_t epochOf(std::uint64_t control) { return (control >> 32) & 0x3fffffffu; }
+    static std::uint32_t countOf(std::uint64_t control) { return static_cast<std::uint32_t>(control); }
+    static std::uint64_t makeControl(std::uint64_t state, std::uint64_t epoch, std::uint32_t count) {
+        return (state << 62) | ((epoch & 0x3fffffffu) << 32) | count;
+    }
+
+    static std::int64_t nowNs();
+    static std::uint64_t waitUntilSettled(Slot& slot);
+
+    enum class Probe { Acquired, Full, Retry, Untracked };
+    Probe probe(Slot* shard, std::size_t start, std::uint64_t high, std::uint64_t low, Lease& lease);
+    void claim(Slot& slot, std::uint64_t epoch, std::uint64_t high, std::uint64_t low, std::int64_t now);
+    void admitUntracked(Lease& lease);
+
+    std::uint32_t maxConnections_;
+    std::int64_t requestInterval_{0};
+    std::int64_t requestTolerance_{0};
+    double nsPerByte_{0};
+    std::int64_t bandwidthTolerance_{0};
+
+    std::unique_ptr<Slot[]> slots_;
+    std::atomic<std::uint64_t> rejectedConnections_{0};
+    std::atomic<std::uint64_t> throttledRequests_{0};
+    std::atomic<std::uint64_t> untrackedConnections_{0};
+    std::atomic<std::uint64_t> untrackedActive_{0};
+};
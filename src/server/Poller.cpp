@@ -0,0 +1,201 @@
+#include "server/Poller.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#else
+#include <sys/event.h>
+#endif
+
+namespace {
+constexpr std::size_t kMaxEvents = 256;
+#if !defined(__linux__)
+constexpr uintptr_t kWakeIdent = 0;
+#endif
+}  // namespace
+
+#if defined(__linux__)
+
+Poller::Poller() : fd_(::epoll_create1(EPOLL_CLOEXEC)) {
+    if (fd_ < 0) {
+        throw makeError("epoll_create1() failed");
+    }
+    wakeFd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0) {
+        ::close(fd_);
+        throw makeError("eventfd() failed");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    if (::epoll_ctl(fd_, EPOLL_CTL_ADD, wakeFd_, &ev) < 0) {
+        ::close(wakeFd_);
+        ::close(fd_);
+        throw makeError("epoll_ctl(wake) failed");
+    }
+}
+
+Poller::~Poller() {
+    ::close(wakeFd_);
+    ::close(fd_);
+}
+
+namespace {
+epoll_event makeEvent(std::uint64_t token, unsigned interest, bool oneShot) {
+    epoll_event ev{};
+    ev.events = EPOLLRDHUP;
+    if ((interest & Poller::kRead) != 0) {
+        ev.events |= EPOLLIN;
+    }
+    if ((interest & Poller::kWrite) != 0) {
+        ev.events |= EPOLLOUT;
+    }
+    if (oneShot) {
+        ev.events |= EPOLLONESHOT;
+    }
+    // Token 0 in data.u64 would be indistinguishable from the wake fd's
+    // nullptr, so tokens are stored offset by one.
+    ev.data.u64 = token + 1;
+    return ev;
+}
+}  // namespace
+
+void Poller::add(int fd, std::uint64_t token, unsigned interest, bool oneShot) {
+    epoll_event ev = makeEvent(token, interest, oneShot);
+    if (::epoll_ctl(fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        throw makeError("epoll_ctl(ADD) failed");
+    }
+}
+
+void Poller::modify(int fd, std::uint64_t token, unsigned interest, bool oneShot) {
+    epoll_event ev = makeEvent(token, interest, oneShot);
+    if (::epoll_ctl(fd_, EPOLL_CTL_MOD, fd, &ev) < 0) {
+        throw makeError("epoll_ctl(MOD) failed");
+    }
+}
+
+void Poller::remove(int fd) {
+    (void)::epoll_ctl(fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+std::size_t Poller::wait(std::vector<Event>& events, int timeoutMs) {
+    epoll_event raw[kMaxEvents];
+    int n;
+    do {
+        n = ::epoll_wait(fd_, raw, static_cast<int>(kMaxEvents), timeoutMs);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        throw makeError("epoll_wait() failed");
+    }
+
+    events.clear();
+    for (int i = 0; i < n; ++i) {
+        if (raw[i].data.u64 == 0) {
+            std::uint64_t drained = 0;
+            (void)::read(wakeFd_, &drained, sizeof(drained));
+            continue;
+        }
+        Event event;
+        event.token = raw[i].data.u64 - 1;
+        event.readable = (raw[i].events & EPOLLIN) != 0;
+        event.writable = (raw[i].events & EPOLLOUT) != 0;
+        event.hangup = (raw[i].events & (EPOLLHUP | EPOLLRDHUP | EPOLLERR)) != 0;
+        events.push_back(event);
+    }
+    return events.size();
+}
+
+void Poller::wake() {
+    const std::uint64_t one = 1;
+    (void)::write(wakeFd_, &one, sizeof(one));
+}
+
+#else
+
+Poller::Poller() : fd_(::kqueue()) {
+    if (fd_ < 0) {
+        throw makeError("kqueue() failed");
+    }
+    struct kevent ev;
+    EV_SET(&ev, kWakeIdent, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    if (::kevent(fd_, &ev, 1, nullptr, 0, nullptr) < 0) {
+        ::close(fd_);
+        throw makeError("kevent(EVFILT_USER) failed");
+    }
+}
+
+Poller::~Poller() {
+    ::close(fd_);
+}
+
+void Poller::add(int fd, std::uint64_t token, unsigned interest, bool oneShot) {
+    modify(fd, token, interest, oneShot);
+}
+
+void Poller::modify(int fd, std::uint64_t token, unsigned interest, bool oneShot) {
+    const auto udata = reinterpret_cast<void*>(static_cast<uintptr_t>(token));
+    const unsigned short oneShotFlag = oneShot ? EV_ONESHOT : 0;
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, (interest & kRead) != 0 ? EV_ADD | EV_ENABLE | oneShotFlag : EV_DELETE, 0,
+           0, udata);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, (interest & kWrite) != 0 ? EV_ADD | EV_ENABLE | oneShotFlag : EV_DELETE,
+           0, 0, udata);
+    for (auto& change : changes) {
+        if (::kevent(fd_, &change, 1, nullptr, 0, nullptr) < 0 && !(change.flags == EV_DELETE && errno == ENOENT)) {
+            throw makeError("kevent() failed");
+        }
+    }
+}
+
+void Poller::remove(int fd) {
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    for (auto& change : changes) {
+        (void)::kevent(fd_, &change, 1, nullptr, 0, nullptr);
+    }
+}
+
+std::size_t Poller::wait(std::vector<Event>& events, int timeoutMs) {
+    struct kevent raw[kMaxEvents];
+    timespec timeout{};
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = static_cast<long>(timeoutMs % 1000) * 1000000L;
+    int n;
+    do {
+        n = ::kevent(fd_, nullptr, 0, raw, static_cast<int>(kMaxEvents), timeoutMs < 0 ? nullptr : &timeout);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        throw makeError("kevent() wait failed");
+    }
+
+    events.clear();
+    for (int i = 0; i < n; ++i) {
+        if (raw[i].filter == EVFILT_USER) {
+            continue;
+        }
+        Event event;
+        event.token = static_cast<std::uint64_t>(reinterpret_cast<uintptr_t>(raw[i].udata));
+        event.readable = raw[i].filter == EVFILT_READ;
+        event.writable = raw[i].filter == EVFILT_WRITE;
+        event.hangup = (raw[i].flags & (EV_EOF | EV_ERROR)) != 0;
+        events.push_back(event);
+    }
+    return events.size();
+}
+
+void Poller::wake() {
+    struct kevent ev;
+    EV_SET(&ev, kWakeIdent, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    (void)::kevent(fd_, &ev, 1, nullptr, 0, nullptr);
+}
+
+#endif
+
+std::runtime_error Poller::makeError(const std::string& prefix) {
+    return std::runtime_error(prefix + ": " + std::strerror(errno));
+}
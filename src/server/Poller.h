@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Readiness notification over epoll (Linux) or kqueue (macOS/BSD). Each fd is
+// registered with a caller-chosen token that comes back in its events.
+class Poller {
+public:
+    enum Interest : unsigned { kRead = 1u << 0, kWrite = 1u << 1 };
+
+    struct Event {
+        std::uint64_t token{0};
+        bool readable{false};
+        bool writable{false};
+        bool hangup{false};
+    };
+
+    Poller();
+    ~Poller();
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    // One-shot registrations report a single event and are then disarmed
+    // until modify() re-arms them.
+    void add(int fd, std::uint64_t token, unsigned interest, bool oneShot = false);
+    void modify(int fd, std::uint64_t token, unsigned interest, bool oneShot = false);
+    void remove(int fd);
+
+    // Blocks for up to timeoutMs (-1 = forever). Returns the number of events
+    // written to `events`; a wake() ends the wait without producing one.
+    std::size_t wait(std::vector<Event>& events, int timeoutMs);
+    void wake();
+
+private:
+    static std::runtime_error makeError(const std::string& prefix);
+
+    int fd_{-1};
+#if defined(__linux__)
+    int wakeFd_{-1};
+#endif
+};
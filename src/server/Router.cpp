@@ -0,0 +1,260 @@
+#include "server/Router.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+// Pointer-linked trie the routes are inserted into before being flattened.
+struct Router::BuildNode {
+    std::string label;
+    std::vector<std::unique_ptr<BuildNode>> children;
+    std::unique_ptr<BuildNode> param;
+    std::string paramName;
+    // Spec indices; `true` marks the "/prefix" route implied by "/prefix/*",
+    // which yields to an explicit route for the same path and method.
+    std::vector<std::pair<bool, std::size_t>> routes;
+    std::vector<std::size_t> rest;
+    std::string restName;
+};
+
+namespace {
+
+bool isName(std::string_view name) {
+    return name.find_first_of("/:*") == std::string_view::npos;
+}
+
+}  // namespace
+
+// Walks (and extends) the static edges below `node` for `text`, splitting
+// an edge where the text diverges from it; returns the node `text` ends at.
+Router::BuildNode* Router::insertStatic(BuildNode* node, std::string_view text) {
+    while (!text.empty()) {
+        auto slot = std::find_if(node->children.begin(), node->children.end(),
+                                 [&text](const auto& child) { return child->label.front() == text.front(); });
+        if (slot == node->children.end()) {
+            node->children.push_back(std::make_unique<BuildNode>());
+            node->children.back()->label = text;
+            return node->children.back().get();
+        }
+        std::unique_ptr<BuildNode>& child = *slot;
+        const auto diverge = std::mismatch(child->label.begin(), child->label.end(), text.begin(), text.end());
+        const auto common = static_cast<std::size_t>(diverge.first - child->label.begin());
+        if (common < child->label.size()) {
+            auto middle = std::make_unique<BuildNode>();
+            middle->label = child->label.substr(0, common);
+            child->label.erase(0, common);
+            middle->children.push_back(std::move(child));
+            child = std::move(middle);
+        }
+        node = child.get();
+        text.remove_prefix(common);
+    }
+    return node;
+}
+
+bool Router::add(std::string_view method, std::string_view pattern, RequestHandler& handler) {
+    const bool routed = std::any_of(specs_.begin(), specs_.end(), [&](const Spec& spec) {
+        return spec.method == method && spec.pattern == pattern;
+    });
+    if (routed) {
+        return false;
+    }
+    specs_.push_back({std::string(method), std::string(pattern), &handler});
+    try {
+        rebuild();
+    } catch (...) {
+        specs_.pop_back();
+        rebuild();
+        throw;
+    }
+    return true;
+}
+
+// Startup only: recompiles the whole trie from the route list.
+void Router::rebuild() {
+    BuildNode root;
+    for (std::size_t index = 0; index < specs_.size(); ++index) {
+        const std::string_view pattern = specs_[index].pattern;
+        if (pattern.empty() || pattern.front() != '/') {
+            throw std::invalid_argument("Route pattern must start with '/': " + std::string(pattern));
+        }
+        BuildNode* node = &root;
+        std::size_t captures = 0;
+        bool rest = false;
+        std::size_t pos = 0;
+        while (pos < pattern.size()) {
+            if (pattern[pos] == ':') {
+                const std::size_t end = std::min(pattern.find('/', pos), pattern.size());
+                const std::string_view name = pattern.substr(pos + 1, end - pos - 1);
+                if (pattern[pos - 1] != '/' || name.empty() || !isName(name)) {
+                    throw std::invalid_argument("Malformed parameter in route " + std::string(pattern));
+                }
+                if (!node->param) {
+                    node->param = std::make_unique<BuildNode>();
+                    node->paramName = name;
+                } else if (node->paramName != name) {
+                    throw std::invalid_argument("Route " + std::string(pattern) + " renames parameter :" +
+                                                node->paramName);
+                }
+                node = node->param.get();
+                ++captures;
+                pos = end;
+            } else if (pattern[pos] == '*') {
+                const std::string_view name = pattern.substr(pos + 1);
+                if (!isName(name)) {
+                    throw std::invalid_argument("'*' must end route " + std::string(pattern));
+                }
+                if (!node->rest.empty() && node->restName != name) {
+                    throw std::invalid_argument("Route " + std::string(pattern) + " renames *" + node->restName);
+                }
+                node->restName = name;
+                node->rest.push_back(index);
+                captures += name.empty() ? 0 : 1;
+                rest = true;
+                pos = pattern.size();
+            } else {
+                const std::size_t end = std::min(pattern.find_first_of(":*", pos), pattern.size());
+                const std::string_view piece = pattern.substr(pos, end - pos);
+                if (end < pattern.size() && pattern[end] == '*' && piece.back() == '/') {
+                    BuildNode* prefix = insertStatic(node, piece.substr(0, piece.size() - 1));
+                    if (prefix != &root) {
+                        prefix->routes.emplace_back(true, index);
+                    }
+                    node = insertStatic(prefix, "/");
+                } else {
+                    node = insertStatic(node, piece);
+                }
+                pos = end;
+            }
+        }
+        if (!rest) {
+            node->routes.emplace_back(false, index);
+        }
+        if (captures > http::RouteParams::kCapacity) {
+            throw std::invalid_argument("Route " + std::string(pattern) + " captures more than " +
+                                        std::to_string(http::RouteParams::kCapacity) + " parameters");
+        }
+    }
+
+    // Breadth-first, so every node's static children are contiguous.
+    nodes_.assign(1, Node{});
+    routes_.clear();
+    text_.clear();
+    std::vector<std::pair<BuildNode*, std::uint32_t>> queue{{&root, 0}};
+    for (std::size_t i = 0; i < queue.size(); ++i) {
+        BuildNode& build = *queue[i].first;
+        Node node;
+        node.label = intern(build.label);
+
+        std::sort(build.children.begin(), build.children.end(),
+                  [](const auto& lhs, const auto& rhs) { return lhs->label.front() < rhs->label.front(); });
+        node.firstChild = static_cast<std::uint32_t>(nodes_.size());
+        node.childCount = static_cast<std::uint32_t>(build.children.size());
+        for (const auto& child : build.children) {
+            queue.emplace_back(child.get(), static_cast<std::uint32_t>(nodes_.size()));
+            nodes_.emplace_back();
+        }
+        if (build.param) {
+            node.paramChild = static_cast<std::uint32_t>(nodes_.size());
+            node.paramName = intern(build.paramName);
+            queue.emplace_back(build.param.get(), node.paramChild);
+            nodes_.emplace_back();
+        }
+
+        std::stable_sort(build.routes.begin(), build.routes.end(),
+                         [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+        node.firstRoute = static_cast<std::uint32_t>(routes_.size());
+        node.routeCount = static_cast<std::uint32_t>(build.routes.size());
+        for (const auto& [implied, index] : build.routes) {
+            routes_.push_back({intern(specs_[index].method), specs_[index].handler});
+        }
+        node.firstRest = static_cast<std::uint32_t>(routes_.size());
+        node.restCount = static_cast<std::uint32_t>(build.rest.size());
+        node.restName = intern(build.restName);
+        for (const std::size_t index : build.rest) {
+            routes_.push_back({intern(specs_[index].method), specs_[index].handler});
+        }
+        nodes_[queue[i].second] = node;
+    }
+}
+
+Router::Text Router::intern(std::string_view text) {
+    if (text.empty()) {
+        return {};
+    }
+    std::size_t offset = text_.find(text);
+    if (offset == std::string::npos) {
+        offset = text_.size();
+        text_.append(text);
+    }
+    return {static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(text.size())};
+}
+
+Router::Match Router::match(std::string_view method, std::string_view path, http::RouteParams& params) const {
+    Match match;
+    params.size = 0;
+    if (!nodes_.empty()) {
+        matchFrom(0, method, path, params, match);
+    }
+    return match;
+}
+
+// `path` is what remains after the node's label. Returns true once a pattern
+// has claimed the path, whether or not it routes the method.
+bool Router::matchFrom(std::uint32_t index, std::string_view method, std::string_view path,
+                       http::RouteParams& params, Match& match) const {
+    const Node& node = nodes_[index];
+    if (path.empty() && node.routeCount != 0) {
+        return resolve(node.firstRoute, node.routeCount, method, match);
+    }
+
+    if (!path.empty() && node.childCount != 0) {
+        const Node* first = nodes_.data() + node.firstChild;
+        const Node* last = first + node.childCount;
+        const Node* child = std::lower_bound(first, last, path.front(), [this](const Node& candidate, char c) {
+            return text_[candidate.label.offset] < c;
+        });
+        if (child != last && text_[child->label.offset] == path.front()) {
+            const std::string_view label = view(child->label);
+            if (path.substr(0, label.size()) == label &&
+                matchFrom(static_cast<std::uint32_t>(child - nodes_.data()), method, path.substr(label.size()),
+                          params, match)) {
+                return true;
+            }
+        }
+    }
+
+    if (node.paramChild != kNone) {
+        const std::string_view segment = path.substr(0, path.find('/'));
+        if (!segment.empty()) {
+            const std::size_t saved = params.size;
+            params.items[params.size++] = {view(node.paramName), segment};
+            if (matchFrom(node.paramChild, method, path.substr(segment.size()), params, match)) {
+                return true;
+            }
+            params.size = saved;
+        }
+    }
+
+    if (node.restCount != 0) {
+        if (node.restName.size != 0) {
+            params.items[params.size++] = {view(node.restName), path};
+        }
+        return resolve(node.firstRest, node.restCount, method, match);
+    }
+    return false;
+}
+
+bool Router::resolve(std::uint32_t first, std::uint32_t count, std::string_view method, Match& match) const {
+    for (std::uint32_t i = first; i < first + count; ++i) {
+        const std::string_view routed = view(routes_[i].method);
+        if (routed.empty() || routed == method) {
+            match.handler = routes_[i].handler;
+            match.methodNotAllowed = false;
+            return true;
+        }
+    }
+    match.methodNotAllowed = true;
+    return true;
+}
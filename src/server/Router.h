@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "handlers/RequestHandler.h"
+#include "http/HttpRequest.h"
+
+// Maps method + path patterns to handlers. Routes are compiled into a radix
+// trie laid out in three flat arrays (nodes with contiguous, sorted children;
+// routes; and one string holding every label and name), so a lookup walks
+// the path once, compares each byte at most once per branch tried, and never
+// allocates.
+//
+// Patterns are literal text plus:
+//   :name   one path segment (up to the next '/'), captured as `name`
+//   *name   the rest of the path, captured as `name` (`*` captures nothing);
+//           only at the end. "/prefix/*" also matches "/prefix" itself.
+//
+// Literal text beats a parameter, which beats a rest-of-path match, with
+// backtracking when the more specific branch fails further on. The most
+// specific pattern that matches the path decides: if it has no route for
+// the method the result is "method not allowed", not a less specific route.
+//
+// Routes are added at startup; match() may then run on any thread.
+class Router {
+public:
+    struct Match {
+        RequestHandler* handler{nullptr};
+        // The path matched a pattern, but not one routed for this method.
+        bool methodNotAllowed{false};
+    };
+
+    // An empty `method` matches any method. Returns false if the method and
+    // pattern are already routed; throws std::invalid_argument on a
+    // malformed pattern or one whose parameter names conflict with an
+    // existing route.
+    bool add(std::string_view method, std::string_view pattern, RequestHandler& handler);
+
+    // `path` excludes the query string. Captures land in `params`, as views
+    // into `path`.
+    Match match(std::string_view method, std::string_view path, http::RouteParams& params) const;
+
+    bool empty() const { return specs_.empty(); }
+
+private:
+    static constexpr std::uint32_t kNone = ~std::uint32_t{0};
+
+    struct Spec {
+        std::string method;
+        std::string pattern;
+        RequestHandler* handler;
+    };
+
+    // Offset and length into text_.
+    struct Text {
+        std::uint32_t offset{0};
+        std::uint32_t size{0};
+    };
+
+    struct Node {
+        Text label;
+        // Static children are nodes_[firstChild, firstChild + childCount),
+        // sorted by the first byte of their label.
+        std::uint32_t firstChild{0};
+        std::uint32_t childCount{0};
+        std::uint32_t paramChild{kNone};
+        Text paramName;
+        // Routes for a path ending here, and for one continuing past here.
+        std::uint32_t firstRoute{0};
+        std::uint32_t routeCount{0};
+        std::uint32_t firstRest{0};
+        std::uint32_t restCount{0};
+        Text restName;
+    };
+
+    struct Route {
+        Text method;
+        RequestHandler* handler;
+    };
+
+    struct BuildNode;
+
+    static BuildNode* insertStatic(BuildNode* node, std::string_view text);
+    void rebuild();
+    std::string_view view(Text text) const { return std::string_view(text_).substr(text.offset, text.size); }
+    Text intern(std::string_view text);
+    bool matchFrom(std::uint32_t index, std::string_view method, std::string_view path, http::RouteParams& params,
+                   Match& match) const;
+    bool resolve(std::uint32_t first, std::uint32_t count, std::string_view method, Match& match) const;
+
+    std::vector<Spec> specs_;
+    std::vector<Node> nodes_;
+    std::vector<Route> routes_;
+    std::string text_;
+};
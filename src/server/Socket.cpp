@@ -1,14 +1,19 @@
 #include "server/Socket.h"
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cerrno>
 #include <cstring>
 #include <fcntl.h>
+#include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <stdexcept>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <utility>
 
 Socket::Socket() : fd_(::socket(AF_INET, SOCK_STREAM, 0)) {
     if (fd_ < 0) {
@@ -22,7 +27,7 @@ Socket::~Socket() {
     closeIfValid();
 }
 
-Socket::Socket(Socket&& other) noexcept : fd_(other.fd_) {
+Socket::Socket(Socket&& other) noexcept : fd_(other.fd_), layer_(std::move(other.layer_)) {
     other.fd_ = -1;
 }
 
@@ -30,6 +35,7 @@ Socket& Socket::operator=(Socket&& other) noexcept {
     if (this != &other) {
         closeIfValid();
         fd_ = other.fd_;
+        layer_ = std::move(other.layer_);
         other.fd_ = -1;
     }
     return *this;
@@ -52,8 +58,8 @@ void Socket::listen(int backlog) const {
     }
 }
 
-Socket Socket::accept(std::string* peerIp) const {
-    sockaddr_in clientAddr{};
+Socket Socket::accept(IpAddress* peerIp) const {
+    sockaddr_storage clientAddr{};
     socklen_t len = sizeof(clientAddr);
 
     int clientFd;
@@ -66,21 +72,80 @@ Socket Socket::accept(std::string* peerIp) const {
     }
 
     if (peerIp != nullptr) {
-        char ipBuffer[INET_ADDRSTRLEN] = {0};
-        if (inet_ntop(AF_INET, &clientAddr.sin_addr, ipBuffer, sizeof(ipBuffer)) != nullptr) {
-            *peerIp = ipBuffer;
-        } else {
-            peerIp->clear();
-        }
+        *peerIp = IpAddress::fromSockaddr(reinterpret_cast<const sockaddr*>(&clientAddr));
     }
 
     return Socket(clientFd);
 }
 
+void Socket::connect(const std::string& host, int port, std::chrono::milliseconds timeout) const {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1) {
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* result = nullptr;
+        const int status = ::getaddrinfo(host.c_str(), nullptr, &hints, &result);
+        if (status != 0 || result == nullptr) {
+            throw std::runtime_error("getaddrinfo(" + host + ") failed: " + ::gai_strerror(status));
+        }
+        addr.sin_addr = reinterpret_cast<const sockaddr_in*>(result->ai_addr)->sin_addr;
+        ::freeaddrinfo(result);
+    }
+
+    if (timeout.count() <= 0) {
+        int status;
+        do {
+            status = ::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+        } while (status < 0 && errno == EINTR);
+        if (status < 0) {
+            throw makeError("connect() failed");
+        }
+        return;
+    }
+
+    // Non-blocking connect, then wait for writability up to the deadline.
+    const int flags = fcntl(fd_, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+        throw makeError("fcntl() failed");
+    }
+    int error = 0;
+    if (::connect(fd_, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        error = errno;
+    }
+    if (error == EINPROGRESS || error == EINTR) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        pollfd pfd{fd_, POLLOUT, 0};
+        int ready;
+        do {
+            const auto remaining =
+                std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            ready = ::poll(&pfd, 1, static_cast<int>(std::max<std::chrono::milliseconds::rep>(remaining.count(), 0)));
+        } while (ready < 0 && errno == EINTR);
+        if (ready < 0) {
+            error = errno;
+        } else if (ready == 0) {
+            error = ETIMEDOUT;
+        } else {
+            socklen_t length = sizeof(error);
+            if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+                error = errno;
+            }
+        }
+    }
+    fcntl(fd_, F_SETFL, flags);
+    if (error != 0) {
+        errno = error;
+        throw makeError("connect() failed");
+    }
+}
+
 ssize_t Socket::send(const char* data, std::size_t len) const {
     ssize_t sent;
     do {
-        sent = ::send(fd_, data, len, MSG_NOSIGNAL);
+        sent = layer_ ? layer_->send(data, len) : ::send(fd_, data, len, MSG_NOSIGNAL);
     } while (sent < 0 && errno == EINTR);
     if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         throw makeError("send() failed");
@@ -91,7 +156,7 @@ ssize_t Socket::send(const char* data, std::size_t len) const {
 ssize_t Socket::recv(char* buffer, std::size_t size) const {
     ssize_t bytes;
     do {
-        bytes = ::recv(fd_, buffer, size, 0);
+        bytes = layer_ ? layer_->recv(buffer, size) : ::recv(fd_, buffer, size, 0);
     } while (bytes < 0 && errno == EINTR);
     if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         throw makeError("recv() failed");
@@ -99,6 +164,10 @@ ssize_t Socket::recv(char* buffer, std::size_t size) const {
     return bytes;
 }
 
+void Socket::setLayer(std::unique_ptr<TransportLayer> layer) {
+    layer_ = std::move(layer);
+}
+
 void Socket::setNonBlocking() const {
     const int flags = fcntl(fd_, F_GETFL, 0);
     if (flags < 0) {
@@ -123,6 +192,13 @@ void Socket::setKeepAlive() const {
     }
 }
 
+void Socket::setNoDelay() const {
+    int opt = 1;
+    if (setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt)) < 0) {
+        throw makeError("setsockopt(TCP_NODELAY) failed");
+    }
+}
+
 void Socket::setReceiveTimeoutSeconds(int seconds) const {
     timeval tv{};
     tv.tv_sec = seconds;
@@ -147,6 +223,7 @@ std::runtime_error Socket::makeError(const std::string& prefix) {
 }
 
 void Socket::closeIfValid() {
+    layer_.reset();
     if (fd_ >= 0) {
         ::close(fd_);
         fd_ = -1;
@@ -1,10 +1,32 @@
 #pragma once
 
+#include <chrono>
 #include <cstddef>
+#include <memory>
 #include <stdexcept>
 #include <string>
 #include <sys/types.h>
 
+#include "server/IpAddress.h"
+
+// A protocol running over a connected socket, such as TLS. send() and recv()
+// follow the plain calls: a byte count, 0 on EOF, or -1 with errno set. On
+// EAGAIN, wantsWrite() says which readiness the layer is waiting for (a TLS
+// read may need to write first).
+class TransportLayer {
+public:
+    virtual ~TransportLayer() = default;
+
+    // The layer's opening exchange: 1 once complete, else -1 with errno set.
+    virtual int handshake() = 0;
+    virtual ssize_t send(const char* data, std::size_t len) = 0;
+    virtual ssize_t recv(char* buffer, std::size_t size) = 0;
+    // Input already read from the fd but not yet returned by recv(); the fd
+    // will not poll readable for it.
+    virtual bool hasPendingInput() const = 0;
+    virtual bool wantsWrite() const = 0;
+};
+
 class Socket {
 public:
     Socket();
@@ -19,14 +41,25 @@ public:
 
     void bind(int port) const;
     void listen(int backlog = 128) const;
-    Socket accept(std::string* peerIp = nullptr) const;
+    Socket accept(IpAddress* peerIp = nullptr) const;
+    // Blocking connect to an IPv4 address or host name. With a timeout, gives
+    // up (errno ETIMEDOUT) once it expires; the socket stays blocking.
+    void connect(const std::string& host, int port,
+                 std::chrono::milliseconds timeout = std::chrono::milliseconds(0)) const;
 
     ssize_t send(const char* data, std::size_t len) const;
     ssize_t recv(char* buffer, std::size_t size) const;
 
+    // send() and recv() go through `layer` from now on; it is destroyed
+    // before the fd is closed.
+    void setLayer(std::unique_ptr<TransportLayer> layer);
+    TransportLayer* layer() const { return layer_.get(); }
+    bool hasPendingInput() const { return layer_ != nullptr && layer_->hasPendingInput(); }
+
     void setNonBlocking() const;
     void setReuseAddr() const;
     void setKeepAlive() const;
+    void setNoDelay() const;
     void setReceiveTimeoutSeconds(int seconds) const;
     void shutdownReadWrite() const;
     void close();
@@ -39,4 +72,5 @@ private:
     void closeIfValid();
 
     int fd_{-1};
+    std::unique_ptr<TransportLayer> layer_;
 };
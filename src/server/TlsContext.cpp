@@ -0,0 +1,187 @@
+#include "server/TlsContext.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+namespace {
+
+constexpr unsigned char kSessionContext[] = "http-server";
+
+// ALPN lists in wire format, in order of preference.
+struct Protocols {
+    const unsigned char* data;
+    unsigned int length;
+};
+constexpr unsigned char kH2AndHttp11[] = "\x02h2\x08http/1.1";
+constexpr unsigned char kHttp11[] = "\x08http/1.1";
+const Protocols kWithH2{kH2AndHttp11, sizeof(kH2AndHttp11) - 1};
+const Protocols kWithoutH2{kHttp11, sizeof(kHttp11) - 1};
+
+// Picks our first protocol the client offers; clients without a match
+// continue without ALPN (HTTP/1.1).
+int selectProtocol(SSL*, const unsigned char** out, unsigned char* outLength, const unsigned char* in,
+                   unsigned int inLength, void* arg) {
+    const auto* ours = static_cast<const Protocols*>(arg);
+    unsigned char* selected = nullptr;
+    if (SSL_select_next_proto(&selected, outLength, ours->data, ours->length, in, inLength) !=
+        OPENSSL_NPN_NEGOTIATED) {
+        return SSL_TLSEXT_ERR_NOACK;
+    }
+    *out = selected;
+    return SSL_TLSEXT_ERR_OK;
+}
+
+std::runtime_error makeError(const std::string& prefix) {
+    std::string message = prefix;
+    char buffer[256];
+    while (const unsigned long code = ERR_get_error()) {
+        ERR_error_string_n(code, buffer, sizeof(buffer));
+        message += ": ";
+        message += buffer;
+    }
+    return std::runtime_error(message);
+}
+
+}  // namespace
+
+TlsConnection::~TlsConnection() {
+    SSL_free(ssl_);
+}
+
+int TlsConnection::handshake() {
+    ERR_clear_error();
+    const int result = SSL_do_handshake(ssl_);
+    if (result == 1) {
+        return 1;
+    }
+    if (fail(result) == 0) {
+        errno = ECONNRESET;
+    }
+    return -1;
+}
+
+ssize_t TlsConnection::send(const char* data, std::size_t len) {
+    ERR_clear_error();
+    const int sent = SSL_write(ssl_, data, static_cast<int>(std::min<std::size_t>(len, INT_MAX)));
+    if (sent > 0) {
+        return sent;
+    }
+    if (fail(sent) == 0) {
+        errno = EPIPE;
+    }
+    return -1;
+}
+
+ssize_t TlsConnection::recv(char* buffer, std::size_t size) {
+    ERR_clear_error();
+    const int bytes = SSL_read(ssl_, buffer, static_cast<int>(std::min<std::size_t>(size, INT_MAX)));
+    if (bytes > 0) {
+        return bytes;
+    }
+    return fail(bytes);
+}
+
+bool TlsConnection::hasPendingInput() const {
+    return SSL_has_pending(ssl_) == 1;
+}
+
+bool TlsConnection::resumed() const {
+    return SSL_session_reused(ssl_) == 1;
+}
+
+bool TlsConnection::kernelSend() const {
+    return BIO_get_ktls_send(SSL_get_wbio(ssl_));
+}
+
+bool TlsConnection::kernelRecv() const {
+    return BIO_get_ktls_recv(SSL_get_rbio(ssl_));
+}
+
+ssize_t TlsConnection::fail(int result) {
+    const int savedErrno = errno;
+    switch (SSL_get_error(ssl_, result)) {
+        case SSL_ERROR_WANT_READ:
+            wantsWrite_ = false;
+            errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_WANT_WRITE:
+            wantsWrite_ = true;
+            errno = EAGAIN;
+            return -1;
+        case SSL_ERROR_ZERO_RETURN:
+            return 0;
+        case SSL_ERROR_SYSCALL:
+            ERR_clear_error();
+            errno = savedErrno != 0 ? savedErrno : ECONNRESET;
+            return -1;
+        default:
+            ERR_clear_error();
+            errno = EPROTO;
+            return -1;
+    }
+}
+
+TlsContext::TlsContext(const TlsConfig& config) : ctx_(SSL_CTX_new(TLS_server_method())) {
+    if (ctx_ == nullptr) {
+        throw makeError("SSL_CTX_new() failed");
+    }
+
+    std::uint64_t options = SSL_OP_NO_RENEGOTIATION | SSL_OP_CIPHER_SERVER_PREFERENCE |
+                            // Clients may close without close_notify; every
+                            // response is length-delimited.
+                            SSL_OP_IGNORE_UNEXPECTED_EOF;
+    if (config.kernelTls) {
+        options |= SSL_OP_ENABLE_KTLS;
+    }
+    SSL_CTX_set_options(ctx_, options);
+    SSL_CTX_set_min_proto_version(ctx_, TLS1_2_VERSION);
+    // send() semantics: return after each record instead of the whole buffer.
+    SSL_CTX_set_mode(ctx_, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    if (SSL_CTX_use_certificate_chain_file(ctx_, config.certFile.c_str()) != 1) {
+        SSL_CTX_free(ctx_);
+        throw makeError("Cannot load TLS certificate " + config.certFile);
+    }
+    if (SSL_CTX_use_PrivateKey_file(ctx_, config.keyFile.c_str(), SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(ctx_) != 1) {
+        SSL_CTX_free(ctx_);
+        throw makeError("Cannot load TLS key " + config.keyFile);
+    }
+
+    // Resumption: TLS 1.3 and 1.2 clients get a stateless ticket (one per
+    // full handshake is enough for a browser); 1.2 clients without ticket
+    // support fall back to the session cache. Ticket keys are per process.
+    SSL_CTX_set_session_id_context(ctx_, kSessionContext, sizeof(kSessionContext) - 1);
+    SSL_CTX_set_session_cache_mode(ctx_, SSL_SESS_CACHE_SERVER);
+    SSL_CTX_set_num_tickets(ctx_, 1);
+
+    SSL_CTX_set_alpn_select_cb(ctx_, selectProtocol,
+                               const_cast<Protocols*>(config.http2 ? &kWithH2 : &kWithoutH2));
+}
+
+TlsContext::~TlsContext() {
+    SSL_CTX_free(ctx_);
+}
+
+std::unique_ptr<TlsConnection> TlsContext::accept(int fd) const {
+    SSL* ssl = SSL_new(ctx_);
+    if (ssl == nullptr) {
+        ERR_clear_error();
+        return nullptr;
+    }
+    if (SSL_set_fd(ssl, fd) != 1) {
+        ERR_clear_error();
+        SSL_free(ssl);
+        return nullptr;
+    }
+    SSL_set_accept_state(ssl);
+    return std::make_unique<TlsConnection>(ssl);
+}
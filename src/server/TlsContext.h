@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <sys/types.h>
+
+#include "server/Socket.h"
+
+struct ssl_st;
+struct ssl_ctx_st;
+
+struct TlsConfig {
+    // PEM certificate chain and private key.
+    std::string certFile;
+    std::string keyFile;
+    // Ask OpenSSL to hand record encryption to the kernel (kTLS); connections
+    // fall back to user-space records where the kernel or cipher lacks it.
+    bool kernelTls{true};
+    // Offer h2 ahead of http/1.1 through ALPN.
+    bool http2{true};
+};
+
+// Server side of one TLS connection, installed as its socket's transport
+// layer. Works on blocking sockets (with a receive timeout) and on
+// non-blocking ones.
+class TlsConnection : public TransportLayer {
+public:
+    explicit TlsConnection(ssl_st* ssl) : ssl_(ssl) {}
+    ~TlsConnection() override;
+
+    TlsConnection(const TlsConnection&) = delete;
+    TlsConnection& operator=(const TlsConnection&) = delete;
+
+    int handshake() override;
+    ssize_t send(const char* data, std::size_t len) override;
+    ssize_t recv(char* buffer, std::size_t size) override;
+    bool hasPendingInput() const override;
+    bool wantsWrite() const override { return wantsWrite_; }
+
+    // After the handshake: whether it resumed an earlier session (ticket or
+    // session cache), and whether the kernel encrypts and decrypts records.
+    bool resumed() const;
+    bool kernelSend() const;
+    bool kernelRecv() const;
+
+private:
+    // Maps an OpenSSL failure onto errno; always returns -1, or 0 for a
+    // clean close on recv().
+    ssize_t fail(int result);
+
+    ssl_st* ssl_;
+    bool wantsWrite_{false};
+};
+
+// Certificate, key and session state shared by every connection of a TLS
+// listener. Session tickets and the server-side session cache let returning
+// clients resume without a full handshake.
+class TlsContext {
+public:
+    // Throws std::runtime_error if the certificate or key cannot be loaded.
+    explicit TlsContext(const TlsConfig& config);
+    ~TlsContext();
+
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    // The server end of a new connection on `fd`; call handshake() on it
+    // before anything else. Returns nullptr if OpenSSL fails to allocate it.
+    std::unique_ptr<TlsConnection> accept(int fd) const;
+
+private:
+    ssl_ctx_st* ctx_{nullptr};
+};
@@ -0,0 +1,90 @@
+#include "threadpool/InjectionQueue.h"
+
+namespace threadpool {
+
+InjectionQueue::InjectionQueue(std::size_t capacity) {
+    std::size_t rounded = 2;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    mask_ = rounded - 1;
+    slots_ = std::make_unique<Slot[]>(rounded);
+    for (std::size_t i = 0; i < rounded; ++i) {
+        slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void InjectionQueue::push(Task task) {
+    if (overflowSize_.load(std::memory_order_acquire) == 0 && tryPushRing(task)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(overflowMutex_);
+    overflow_.push_back(std::move(task));
+    overflowSize_.fetch_add(1, std::memory_order_release);
+}
+
+std::optional<Task> InjectionQueue::pop() {
+    auto task = tryPopRing();
+    if (task || overflowSize_.load(std::memory_order_acquire) == 0) {
+        return task;
+    }
+
+    std::lock_guard<std::mutex> lock(overflowMutex_);
+    if (overflow_.empty()) {
+        return std::nullopt;
+    }
+    task.emplace(std::move(overflow_.front()));
+    overflow_.pop_front();
+    overflowSize_.fetch_sub(1, std::memory_order_release);
+    return task;
+}
+
+std::size_t InjectionQueue::size() const {
+    const std::size_t enqueued = enqueuePos_.load(std::memory_order_relaxed);
+    const std::size_t dequeued = dequeuePos_.load(std::memory_order_relaxed);
+    const std::size_t ring = enqueued > dequeued ? enqueued - dequeued : 0;
+    return ring + overflowSize_.load(std::memory_order_relaxed);
+}
+
+bool InjectionQueue::tryPushRing(Task& task) {
+    std::size_t pos = enqueuePos_.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots_[pos & mask_];
+        const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+        if (diff == 0) {
+            if (enqueuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                slot.task = std::move(task);
+                slot.sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+std::optional<Task> InjectionQueue::tryPopRing() {
+    std::size_t pos = dequeuePos_.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots_[pos & mask_];
+        const std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+        const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+        if (diff == 0) {
+            if (dequeuePos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                std::optional<Task> task(std::move(slot.task));
+                slot.task = nullptr;
+                slot.sequence.store(pos + mask_ + 1, std::memory_order_release);
+                return task;
+            }
+        } else if (diff < 0) {
+            return std::nullopt;
+        } else {
+            pos = dequeuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+}  // namespace threadpool
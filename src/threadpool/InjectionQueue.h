@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "threadpool/Task.h"
+
+namespace threadpool {
+
+// Multi-producer multi-consumer queue for tasks submitted from outside the
+// pool. A bounded lock-free ring (per-slot sequence numbers) absorbs normal
+// load; a mutex-guarded overflow list keeps submit() unbounded under bursts.
+class InjectionQueue {
+public:
+    explicit InjectionQueue(std::size_t capacity = 4096);
+
+    InjectionQueue(const InjectionQueue&) = delete;
+    InjectionQueue& operator=(const InjectionQueue&) = delete;
+
+    void push(Task task);
+    std::optional<Task> pop();
+    std::size_t size() const;
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence{0};
+        Task task;
+    };
+
+    bool tryPushRing(Task& task);
+    std::optional<Task> tryPopRing();
+
+    std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<std::size_t> enqueuePos_{0};
+    alignas(64) std::atomic<std::size_t> dequeuePos_{0};
+
+    alignas(64) std::atomic<std::size_t> overflowSize_{0};
+    std::mutex overflowMutex_;
+    std::deque<Task> overflow_;
+};
+
+}  // namespace threadpool
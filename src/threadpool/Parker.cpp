@@ -0,0 +1,99 @@
+#include "threadpool/Parker.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace threadpool {
+
+#if defined(__linux__)
+namespace {
+void futexWait(std::atomic<std::int32_t>* addr, std::int32_t expected, const timespec* timeout = nullptr) {
+    (void)::syscall(SYS_futex, reinterpret_cast<std::int32_t*>(addr), FUTEX_WAIT_PRIVATE, expected, timeout,
+                    nullptr, 0);
+}
+
+void futexWake(std::atomic<std::int32_t>* addr) {
+    (void)::syscall(SYS_futex, reinterpret_cast<std::int32_t*>(addr), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+}  // namespace
+#endif
+
+void Parker::park() {
+    if (state_.fetch_sub(1, std::memory_order_acquire) == kNotified) {
+        return;
+    }
+#if defined(__linux__)
+    while (true) {
+        futexWait(&state_, kParked);
+        std::int32_t expected = kNotified;
+        if (state_.compare_exchange_strong(expected, kEmpty, std::memory_order_acquire)) {
+            return;
+        }
+    }
+#else
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return state_.load(std::memory_order_acquire) == kNotified; });
+    state_.store(kEmpty, std::memory_order_relaxed);
+#endif
+}
+
+bool Parker::parkFor(std::chrono::nanoseconds timeout) {
+    if (state_.fetch_sub(1, std::memory_order_acquire) == kNotified) {
+        return true;
+    }
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+#if defined(__linux__)
+    while (true) {
+        const auto remaining = deadline - std::chrono::steady_clock::now();
+        if (remaining > std::chrono::nanoseconds::zero()) {
+            const auto secs = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+            timespec ts{};
+            ts.tv_sec = static_cast<time_t>(secs.count());
+            ts.tv_nsec = static_cast<long>(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining - secs).count());
+            futexWait(&state_, kParked, &ts);
+        }
+        std::int32_t expected = kNotified;
+        if (state_.compare_exchange_strong(expected, kEmpty, std::memory_order_acquire)) {
+            return true;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            expected = kParked;
+            if (state_.compare_exchange_strong(expected, kEmpty, std::memory_order_acquire)) {
+                return false;
+            }
+        }
+    }
+#else
+    std::unique_lock<std::mutex> lock(mutex_);
+    const bool notified = cv_.wait_until(lock, deadline, [this]() {
+        return state_.load(std::memory_order_acquire) == kNotified;
+    });
+    if (notified) {
+        state_.store(kEmpty, std::memory_order_relaxed);
+        return true;
+    }
+    std::int32_t expected = kParked;
+    if (state_.compare_exchange_strong(expected, kEmpty, std::memory_order_acquire)) {
+        return false;
+    }
+    state_.store(kEmpty, std::memory_order_relaxed);
+    return true;
+#endif
+}
+
+void Parker::unpark() {
+    if (state_.exchange(kNotified, std::memory_order_release) != kParked) {
+        return;
+    }
+#if defined(__linux__)
+    futexWake(&state_);
+#else
+    std::lock_guard<std::mutex> lock(mutex_);
+    cv_.notify_one();
+#endif
+}
+
+}  // namespace threadpool
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if !defined(__linux__)
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace threadpool {
+
+// One-shot wakeup token for a single worker. unpark() before park() makes the
+// next park() return immediately. Linux blocks on a futex; other platforms use
+// a private mutex/condvar so parking never touches shared state.
+class Parker {
+public:
+    void park();
+    // Returns false if the timeout elapsed without an unpark().
+    bool parkFor(std::chrono::nanoseconds timeout);
+    void unpark();
+
+private:
+    static constexpr std::int32_t kEmpty = 0;
+    static constexpr std::int32_t kNotified = 1;
+    static constexpr std::int32_t kParked = -1;
+
+    std::atomic<std::int32_t> state_{kEmpty};
+#if !defined(__linux__)
+    std::mutex mutex_;
+    std::condition_variable cv_;
+#endif
+};
+
+}  // namespace threadpool
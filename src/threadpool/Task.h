@@ -1,7 +1,131 @@
 #pragma once
 
-#include <functional>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
 
 namespace threadpool {
-using Task = std::function<void()>;
+
+// Move-only type-erased void() callable. Callables up to kInlineSize bytes
+// (an accepted Socket with its transport layer pointer, plus its client
+// address, fits) live inside the Task, so submitting them never touches the
+// heap; larger ones fall back to new.
+// The pool stamps each task with its enqueue time, deadline (steady-clock
+// nanoseconds, 0 = none) and priority lane.
+class Task {
+public:
+    static constexpr std::size_t kInlineSize = 56;
+
+    Task() noexcept = default;
+    Task(std::nullptr_t) noexcept {}
+
+    template <typename F, typename Fn = std::decay_t<F>,
+              typename = std::enable_if_t<!std::is_same_v<Fn, Task> && std::is_invocable_r_v<void, Fn&>>>
+    Task(F&& fn) {
+        if constexpr (fitsInline<Fn>()) {
+            ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(fn));
+            ops_ = &kInlineOps<Fn>;
+        } else {
+            ::new (static_cast<void*>(storage_)) Fn*(new Fn(std::forward<F>(fn)));
+            ops_ = &kHeapOps<Fn>;
+        }
+    }
+
+    Task(Task&& other) noexcept
+        : ops_(other.ops_),
+          enqueuedAt_(other.enqueuedAt_),
+          deadline_(other.deadline_),
+          lane_(other.lane_),
+          demoteWhenExpired_(other.demoteWhenExpired_) {
+        if (ops_ != nullptr) {
+            ops_->relocate(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_ != nullptr) {
+                other.ops_->relocate(storage_, other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+            enqueuedAt_ = other.enqueuedAt_;
+            deadline_ = other.deadline_;
+            lane_ = other.lane_;
+            demoteWhenExpired_ = other.demoteWhenExpired_;
+        }
+        return *this;
+    }
+
+    Task& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() { reset(); }
+
+    void operator()() { ops_->invoke(storage_); }
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+    std::uint64_t enqueuedAt() const noexcept { return enqueuedAt_; }
+    void setEnqueuedAt(std::uint64_t nanos) noexcept { enqueuedAt_ = nanos; }
+    std::uint64_t deadline() const noexcept { return deadline_; }
+    void setDeadline(std::uint64_t nanos) noexcept { deadline_ = nanos; }
+    std::uint8_t lane() const noexcept { return lane_; }
+    void setLane(std::uint8_t lane) noexcept { lane_ = lane; }
+    bool demoteWhenExpired() const noexcept { return demoteWhenExpired_; }
+    void setDemoteWhenExpired(bool demote) noexcept { demoteWhenExpired_ = demote; }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*relocate)(void* dst, void* src) noexcept;
+        void (*destroy)(void* storage) noexcept;
+    };
+
+    template <typename Fn>
+    static constexpr bool fitsInline() {
+        return sizeof(Fn) <= kInlineSize && alignof(Fn) <= alignof(std::max_align_t) &&
+               std::is_nothrow_move_constructible_v<Fn>;
+    }
+
+    template <typename Fn>
+    static constexpr Ops kInlineOps{
+        [](void* storage) { (*static_cast<Fn*>(storage))(); },
+        [](void* dst, void* src) noexcept {
+            ::new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+            static_cast<Fn*>(src)->~Fn();
+        },
+        [](void* storage) noexcept { static_cast<Fn*>(storage)->~Fn(); },
+    };
+
+    template <typename Fn>
+    static constexpr Ops kHeapOps{
+        [](void* storage) { (**static_cast<Fn**>(storage))(); },
+        [](void* dst, void* src) noexcept { ::new (dst) Fn*(*static_cast<Fn**>(src)); },
+        [](void* storage) noexcept { delete *static_cast<Fn**>(storage); },
+    };
+
+    void reset() noexcept {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char storage_[kInlineSize];
+    const Ops* ops_{nullptr};
+    std::uint64_t enqueuedAt_{0};
+    std::uint64_t deadline_{0};
+    std::uint8_t lane_{0};
+    bool demoteWhenExpired_{false};
+};
+
 }  // namespace threadpool
@@ -1,22 +1,130 @@
 #include "threadpool/ThreadPool.h"
 
+#include <algorithm>
+#include <map>
 #include <stdexcept>
 
+#include "utils/CpuAffinity.h"
+
 namespace threadpool {
+namespace {
+constexpr int kSpinRounds = 16;
+// Every kFairnessInterval-th search starts at the lowest lane.
+constexpr std::uint32_t kFairnessInterval = 61;
+constexpr auto kLowLane = static_cast<std::size_t>(Priority::Low);
+
+struct WorkerContext {
+    const ThreadPool* pool{nullptr};
+    std::size_t index{0};
+    std::uint64_t rng{0};
+    std::uint32_t searches{0};
+};
+
+thread_local WorkerContext t_worker;
+
+std::uint64_t nextRandom(std::uint64_t& state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Single-writer counter increment; avoids a locked RMW on the hot path.
+void bump(std::atomic<std::uint64_t>& counter, std::uint64_t delta = 1) {
+    counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// The wait extremes are reset with exchange() by other threads, so a plain
+// load-then-store here could overwrite a reset with a stale value.
+void fetchMax(std::atomic<std::uint64_t>& target, std::uint64_t value) {
+    std::uint64_t current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+void fetchMin(std::atomic<std::uint64_t>& target, std::uint64_t value) {
+    std::uint64_t current = target.load(std::memory_order_relaxed);
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::uint64_t nowNanos() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+}  // namespace
+
+ThreadPool::BlockingScope::BlockingScope()
+    : flag_(t_worker.pool != nullptr ? &t_worker.pool->states_[t_worker.index].blocked : nullptr) {
+    if (flag_ != nullptr) {
+        flag_->store(true, std::memory_order_relaxed);
+    }
+}
+
+ThreadPool::BlockingScope::~BlockingScope() {
+    if (flag_ != nullptr) {
+        flag_->store(false, std::memory_order_relaxed);
+    }
+}
+
+ThreadPool::ThreadPool(std::size_t numThreads) : ThreadPool(ThreadPoolOptions{numThreads, {}}) {}
+
+ThreadPool::ThreadPool(ThreadPoolOptions options) : options_(std::move(options)) {
+    coreThreads_ = options_.numThreads == 0 ? 1 : options_.numThreads;
+    const std::size_t slots = std::max(coreThreads_, options_.maxThreads);
+
+    std::map<int, std::size_t> nodeIndex;
+    workerNode_.assign(slots, 0);
+    if (!options_.cpus.empty()) {
+        for (std::size_t i = 0; i < slots; ++i) {
+            const int node = affinity::numaNodeOfCpu(options_.cpus[i % options_.cpus.size()]);
+            workerNode_[i] = nodeIndex.emplace(node, nodeIndex.size()).first->second;
+        }
+        cpuNode_.assign(static_cast<std::size_t>(affinity::configuredCpuCount()), 0);
+        for (std::size_t cpu = 0; cpu < cpuNode_.size(); ++cpu) {
+            const auto it = nodeIndex.find(affinity::numaNodeOfCpu(static_cast<int>(cpu)));
+            cpuNode_[cpu] = it == nodeIndex.end() ? 0 : it->second;
+        }
+    }
+    nodeWorkers_.resize(nodeIndex.empty() ? 1 : nodeIndex.size());
+    for (std::size_t i = 0; i < slots; ++i) {
+        nodeWorkers_[workerNode_[i]].push_back(i);
+    }
+    for (std::size_t n = 0; n < nodeWorkers_.size(); ++n) {
+        injectors_.push_back(std::make_unique<InjectorLanes>());
+    }
 
-ThreadPool::ThreadPool(std::size_t numThreads) {
-    if (numThreads == 0) {
-        numThreads = 1;
+    queues_.resize(slots);
+    parkers_.resize(slots);
+    for (std::size_t i = coreThreads_; i < slots; ++i) {
+        queues_[i] = std::make_unique<WorkerLanes>();
+        parkers_[i] = std::make_unique<Parker>();
     }
+    states_ = std::make_unique<WorkerState[]>(slots);
+    idleWords_ = (slots + 63) / 64;
+    idleMask_ = std::make_unique<std::atomic<std::uint64_t>[]>(idleWords_);
 
-    queues_.reserve(numThreads);
-    for (std::size_t i = 0; i < numThreads; ++i) {
-        queues_.push_back(std::make_unique<WorkStealingQueue>());
+    workers_.resize(slots);
+    activeWorkers_.store(coreThreads_, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < coreThreads_; ++i) {
+        states_[i].slot.store(kSlotRunning, std::memory_order_relaxed);
+        workers_[i] = std::thread([this, i]() { workerThread(i); });
+    }
+    while (readyWorkers_.load(std::memory_order_acquire) < coreThreads_) {
+        std::this_thread::yield();
     }
 
-    workers_.reserve(numThreads);
-    for (std::size_t i = 0; i < numThreads; ++i) {
-        workers_.emplace_back([this, i]() { workerThread(i); });
+    if (slots > coreThreads_) {
+        supervisor_ = std::thread([this]() { supervisorThread(); });
     }
 }
 
@@ -25,13 +133,34 @@ ThreadPool::~ThreadPool() {
 }
 
 void ThreadPool::submit(Task task) {
+    submit(std::move(task), SubmitOptions{});
+}
+
+void ThreadPool::submit(Task task, const SubmitOptions& options) {
     if (stop_.load(std::memory_order_relaxed)) {
         throw std::runtime_error("Cannot submit task to stopped ThreadPool");
     }
-    const std::size_t index = nextQueue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
-    queues_[index]->push(std::move(task));
-    pendingTasks_.fetch_add(1, std::memory_order_release);
-    cv_.notify_one();
+    const auto lane = static_cast<std::size_t>(options.priority);
+    task.setEnqueuedAt(nowNanos());
+    task.setLane(static_cast<std::uint8_t>(lane));
+    task.setDeadline(options.deadline == std::chrono::steady_clock::time_point{}
+                         ? 0
+                         : static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                          options.deadline.time_since_epoch())
+                                                          .count()));
+    task.setDemoteWhenExpired(options.onExpired == ExpiryPolicy::Demote);
+
+    lanePending_[lane].fetch_add(1, std::memory_order_relaxed);
+    pendingTasks_.fetch_add(1, std::memory_order_seq_cst);
+    if (t_worker.pool == this) {
+        // Local fast path; Chase-Lev deques also accept pushes only from their owner.
+        queues_[t_worker.index]->lanes[lane].push(std::move(task));
+    } else {
+        injectors_[submitterNode()]->lanes[lane].push(std::move(task));
+    }
+    if (spinning_.load(std::memory_order_seq_cst) == 0) {
+        (void)wakeOne();
+    }
 }
 
 void ThreadPool::shutdown() {
@@ -40,7 +169,17 @@ void ThreadPool::shutdown() {
         return;
     }
 
-    cv_.notify_all();
+    {
+        std::lock_guard<std::mutex> lock(supervisorMutex_);
+    }
+    supervisorCv_.notify_all();
+    if (supervisor_.joinable()) {
+        supervisor_.join();
+    }
+
+    for (auto& parker : parkers_) {
+        parker->unpark();
+    }
     for (auto& worker : workers_) {
         if (worker.joinable()) {
             worker.join();
@@ -48,49 +187,348 @@ void ThreadPool::shutdown() {
     }
 }
 
+std::size_t ThreadPool::blockedWorkers() const {
+    std::size_t blocked = 0;
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        if (states_[i].blocked.load(std::memory_order_relaxed)) {
+            ++blocked;
+        }
+    }
+    return blocked;
+}
+
+ThreadPoolStats ThreadPool::stats() const {
+    ThreadPoolStats stats;
+    stats.workers.resize(workers_.size());
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        const WorkerState& state = states_[i];
+        WorkerStats& worker = stats.workers[i];
+        worker.active = state.slot.load(std::memory_order_acquire) == kSlotRunning;
+        worker.blocked = state.blocked.load(std::memory_order_relaxed);
+        if (queues_[i]) {
+            for (const auto& lane : queues_[i]->lanes) {
+                worker.queueDepth += lane.size();
+            }
+        }
+        worker.tasksRun = state.tasksStarted.load(std::memory_order_relaxed);
+        worker.stealAttempts = state.stealAttempts.load(std::memory_order_relaxed);
+        worker.steals = state.steals.load(std::memory_order_relaxed);
+        worker.parks = state.parks.load(std::memory_order_relaxed);
+        worker.wakeups = state.wakeups.load(std::memory_order_relaxed);
+        worker.idleNs = state.idleNs.load(std::memory_order_relaxed);
+        state.waitNs.addTo(stats.waitNs);
+        state.runNs.addTo(stats.runNs);
+    }
+    for (const auto& injector : injectors_) {
+        std::size_t depth = 0;
+        for (const auto& lane : injector->lanes) {
+            depth += lane.size();
+        }
+        stats.injectorDepth.push_back(depth);
+    }
+    for (std::size_t lane = 0; lane < kPriorityLevels; ++lane) {
+        stats.laneDepth[lane] = lanePending_[lane].load(std::memory_order_relaxed);
+    }
+    stats.pendingTasks = pendingTasks_.load(std::memory_order_relaxed);
+    stats.droppedTasks = droppedTasks_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::uint64_t ThreadPool::takeMinSojournNs() {
+    std::uint64_t minWait = UINT64_MAX;
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        minWait = std::min(minWait, states_[i].minWaitNs.exchange(UINT64_MAX, std::memory_order_relaxed));
+    }
+    if (minWait == UINT64_MAX && pendingTasks_.load(std::memory_order_relaxed) == 0) {
+        return 0;
+    }
+    return minWait;
+}
+
 void ThreadPool::workerThread(std::size_t threadId) {
+    if (!options_.cpus.empty()) {
+        (void)affinity::pinCurrentThread({options_.cpus[threadId % options_.cpus.size()]});
+    }
+    if (threadId < coreThreads_) {
+        queues_[threadId] = std::make_unique<WorkerLanes>();
+        parkers_[threadId] = std::make_unique<Parker>();
+        readyWorkers_.fetch_add(1, std::memory_order_acq_rel);
+        while (readyWorkers_.load(std::memory_order_acquire) < coreThreads_) {
+            std::this_thread::yield();
+        }
+    }
+
+    t_worker = WorkerContext{this, threadId, 0x9E3779B97F4A7C15ull * (threadId + 1)};
     while (true) {
         auto task = tryGetTask(threadId);
+        if (!task) {
+            task = spinForTask(threadId);
+        }
         if (task) {
-            try {
-                (*task)();
-            } catch (...) {
-                // Worker keeps processing subsequent tasks.
-            }
+            runTask(threadId, *task);
             continue;
         }
 
-        std::unique_lock<std::mutex> lock(cvMutex_);
-        cv_.wait(lock, [this]() {
-            return stop_.load(std::memory_order_relaxed) ||
-                   pendingTasks_.load(std::memory_order_acquire) > 0;
-        });
+        if (stop_.load(std::memory_order_acquire) && pendingTasks_.load(std::memory_order_acquire) == 0) {
+            break;
+        }
+        if (!parkWorker(threadId)) {
+            break;
+        }
+    }
 
-        if (stop_.load(std::memory_order_relaxed) &&
-            pendingTasks_.load(std::memory_order_acquire) == 0) {
+    t_worker = WorkerContext{};
+    activeWorkers_.fetch_sub(1, std::memory_order_relaxed);
+    states_[threadId].slot.store(kSlotEmpty, std::memory_order_release);
+}
+
+void ThreadPool::runTask(std::size_t threadId, Task& task) {
+    WorkerState& state = states_[threadId];
+    const std::uint64_t start = nowNanos();
+    const std::uint64_t waitNs = start - task.enqueuedAt();
+    bump(state.tasksStarted);
+    fetchMax(state.maxWaitNs, waitNs);
+    fetchMin(state.minWaitNs, waitNs);
+    state.waitNs.record(waitNs);
+    try {
+        task();
+    } catch (...) {
+        // Worker keeps processing subsequent tasks.
+    }
+    state.runNs.record(nowNanos() - start);
+}
+
+bool ThreadPool::parkWorker(std::size_t threadId) {
+    markIdle(threadId);
+    if (pendingTasks_.load(std::memory_order_seq_cst) > 0 || stop_.load(std::memory_order_seq_cst)) {
+        if (clearIdle(threadId)) {
+            return true;
+        }
+        // A submitter already claimed our idle bit and is unparking us;
+        // park() consumes that token and returns immediately.
+    }
+
+    WorkerState& state = states_[threadId];
+    bump(state.parks);
+    const std::uint64_t parkedAt = nowNanos();
+    if (threadId < coreThreads_) {
+        parkers_[threadId]->park();
+        bump(state.idleNs, nowNanos() - parkedAt);
+        return true;
+    }
+    const bool woken = parkers_[threadId]->parkFor(options_.retireAfter);
+    bump(state.idleNs, nowNanos() - parkedAt);
+    if (woken) {
+        return true;
+    }
+    // Cooldown elapsed. Retire unless a waker picked us in the meantime.
+    if (!clearIdle(threadId)) {
+        return true;
+    }
+    return pendingTasks_.load(std::memory_order_seq_cst) > 0;
+}
+
+void ThreadPool::supervisorThread() {
+    const auto threshold = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(options_.spawnAfter).count());
+    const auto tick = std::max<std::chrono::nanoseconds>(std::chrono::milliseconds(1), options_.spawnAfter / 4);
+    const auto tickNs = static_cast<std::uint64_t>(tick.count());
+    std::vector<std::uint64_t> lastStarted(workers_.size(), 0);
+    std::uint64_t stallSince = 0;
+
+    std::unique_lock<std::mutex> lock(supervisorMutex_);
+    while (!stop_.load(std::memory_order_acquire)) {
+        supervisorCv_.wait_for(lock, tick, [this]() { return stop_.load(std::memory_order_acquire); });
+        if (stop_.load(std::memory_order_acquire)) {
             break;
         }
+
+        std::size_t active = 0;
+        std::size_t blocked = 0;
+        std::uint64_t maxWait = 0;
+        bool progressed = false;
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            WorkerState& state = states_[i];
+            const std::uint64_t started = state.tasksStarted.load(std::memory_order_relaxed);
+            progressed = progressed || started != lastStarted[i];
+            lastStarted[i] = started;
+            maxWait = std::max(maxWait, state.maxWaitNs.exchange(0, std::memory_order_relaxed));
+            if (state.slot.load(std::memory_order_acquire) == kSlotRunning) {
+                ++active;
+                blocked += state.blocked.load(std::memory_order_relaxed) ? 1 : 0;
+            }
+        }
+
+        if (pendingTasks_.load(std::memory_order_acquire) == 0) {
+            stallSince = 0;
+            continue;
+        }
+        const std::uint64_t now = nowNanos();
+        if (progressed) {
+            stallSince = 0;
+        } else if (stallSince == 0) {
+            stallSince = now;
+        }
+
+        const bool aging = maxWait >= threshold || (stallSince != 0 && now - stallSince + tickNs >= threshold);
+        if (aging && blocked > 0 && active - blocked < coreThreads_ && active < workers_.size()) {
+            spawnWorker();
+        }
+    }
+}
+
+void ThreadPool::spawnWorker() {
+    for (std::size_t i = coreThreads_; i < workers_.size(); ++i) {
+        if (states_[i].slot.load(std::memory_order_acquire) != kSlotEmpty) {
+            continue;
+        }
+        if (workers_[i].joinable()) {
+            workers_[i].join();
+        }
+        states_[i].slot.store(kSlotRunning, std::memory_order_release);
+        activeWorkers_.fetch_add(1, std::memory_order_relaxed);
+        workers_[i] = std::thread([this, i]() { workerThread(i); });
+        return;
+    }
+}
+
+std::optional<Task> ThreadPool::spinForTask(std::size_t threadId) {
+    spinning_.fetch_add(1, std::memory_order_seq_cst);
+    std::optional<Task> task;
+    for (int round = 0; round < kSpinRounds && !task; ++round) {
+        for (int i = 0; i < (1 << (round < 6 ? round : 6)); ++i) {
+            cpuRelax();
+        }
+        if (round >= kSpinRounds / 2) {
+            std::this_thread::yield();
+        }
+        task = tryGetTask(threadId);
+    }
+    const bool lastSpinner = spinning_.fetch_sub(1, std::memory_order_seq_cst) == 1;
+    if (task && lastSpinner && pendingTasks_.load(std::memory_order_seq_cst) > 0) {
+        // Hand the search over so remaining work is not left waiting behind us.
+        (void)wakeOne();
     }
+    return task;
 }
 
 std::optional<Task> ThreadPool::tryGetTask(std::size_t threadId) {
-    auto task = queues_[threadId]->pop();
-    if (!task) {
-        for (std::size_t i = 0; i < queues_.size(); ++i) {
-            if (i == threadId) {
-                continue;
-            }
-            task = queues_[i]->steal();
-            if (task) {
-                break;
+    const bool lowFirst = ++t_worker.searches % kFairnessInterval == 0;
+    for (std::size_t i = 0; i < kPriorityLevels; ++i) {
+        const std::size_t lane = lowFirst ? kLowLane - i : i;
+        if (lanePending_[lane].load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        while (auto task = tryGetFromLane(threadId, lane)) {
+            lanePending_[lane].fetch_sub(1, std::memory_order_relaxed);
+            if (task->deadline() == 0 || admitExpired(threadId, *task)) {
+                (void)pendingTasks_.fetch_sub(1, std::memory_order_acq_rel);
+                return task;
             }
         }
     }
+    return std::nullopt;
+}
 
-    if (task) {
-        (void)pendingTasks_.fetch_sub(1, std::memory_order_acq_rel);
+std::optional<Task> ThreadPool::tryGetFromLane(std::size_t threadId, std::size_t lane) {
+    // Nearest work first: own deque, own node, then remote nodes.
+    const std::size_t node = workerNode_[threadId];
+    auto task = queues_[threadId]->lanes[lane].pop();
+    if (!task) {
+        task = injectors_[node]->lanes[lane].pop();
+    }
+    if (!task) {
+        task = stealFrom(nodeWorkers_[node], threadId, lane);
+    }
+    for (std::size_t n = 1; !task && n < nodeWorkers_.size(); ++n) {
+        const std::size_t remote = (node + n) % nodeWorkers_.size();
+        task = injectors_[remote]->lanes[lane].pop();
+        if (!task) {
+            task = stealFrom(nodeWorkers_[remote], threadId, lane);
+        }
     }
     return task;
 }
 
+// Returns true if the task should run now. Otherwise it was dropped or
+// requeued on this worker's Low lane and the search continues.
+bool ThreadPool::admitExpired(std::size_t threadId, Task& task) {
+    if (nowNanos() <= task.deadline()) {
+        return true;
+    }
+    if (!task.demoteWhenExpired()) {
+        task = nullptr;
+        droppedTasks_.fetch_add(1, std::memory_order_relaxed);
+        (void)pendingTasks_.fetch_sub(1, std::memory_order_acq_rel);
+        return false;
+    }
+    task.setDeadline(0);
+    if (task.lane() == kLowLane) {
+        return true;
+    }
+    task.setLane(static_cast<std::uint8_t>(kLowLane));
+    lanePending_[kLowLane].fetch_add(1, std::memory_order_relaxed);
+    queues_[threadId]->lanes[kLowLane].push(std::move(task));
+    return false;
+}
+
+std::optional<Task> ThreadPool::stealFrom(const std::vector<std::size_t>& victims, std::size_t threadId,
+                                          std::size_t lane) {
+    const std::size_t count = victims.size();
+    if (count == 0) {
+        return std::nullopt;
+    }
+    const std::size_t start = static_cast<std::size_t>(nextRandom(t_worker.rng) % count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const std::size_t victim = victims[(start + i) % count];
+        if (victim == threadId) {
+            continue;
+        }
+        bump(states_[threadId].stealAttempts);
+        auto task = queues_[victim]->lanes[lane].steal();
+        if (task) {
+            bump(states_[threadId].steals);
+            return task;
+        }
+    }
+    return std::nullopt;
+}
+
+std::size_t ThreadPool::submitterNode() const {
+    if (injectors_.size() == 1) {
+        return 0;
+    }
+    const int cpu = affinity::currentCpu();
+    if (cpu < 0 || static_cast<std::size_t>(cpu) >= cpuNode_.size()) {
+        return 0;
+    }
+    return cpuNode_[static_cast<std::size_t>(cpu)];
+}
+
+void ThreadPool::markIdle(std::size_t threadId) {
+    idleMask_[threadId / 64].fetch_or(std::uint64_t{1} << (threadId % 64), std::memory_order_seq_cst);
+}
+
+bool ThreadPool::clearIdle(std::size_t threadId) {
+    const std::uint64_t bit = std::uint64_t{1} << (threadId % 64);
+    return (idleMask_[threadId / 64].fetch_and(~bit, std::memory_order_seq_cst) & bit) != 0;
+}
+
+bool ThreadPool::wakeOne() {
+    for (std::size_t w = 0; w < idleWords_; ++w) {
+        std::uint64_t bits = idleMask_[w].load(std::memory_order_seq_cst);
+        while (bits != 0) {
+            const auto bitIndex = static_cast<std::size_t>(__builtin_ctzll(bits));
+            const std::uint64_t bit = std::uint64_t{1} << bitIndex;
+            if ((idleMask_[w].fetch_and(~bit, std::memory_order_seq_cst) & bit) != 0) {
+                states_[w * 64 + bitIndex].wakeups.fetch_add(1, std::memory_order_relaxed);
+                parkers_[w * 64 + bitIndex]->unpark();
+                return true;
+            }
+            bits = idleMask_[w].load(std::memory_order_seq_cst);
+        }
+    }
+    return false;
+}
+
 }  // namespace threadpool
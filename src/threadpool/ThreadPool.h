@@ -1,42 +1,191 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <thread>
 #include <vector>
 
+#include "threadpool/InjectionQueue.h"
+#include "threadpool/Parker.h"
 #include "threadpool/Task.h"
 #include "threadpool/WorkStealingQueue.h"
+#include "utils/Histogram.h"
 
 namespace threadpool {
 
+// Workers drain higher lanes first; Low is still visited periodically so it
+// cannot starve.
+enum class Priority : std::uint8_t { High = 0, Normal = 1, Low = 2 };
+constexpr std::size_t kPriorityLevels = 3;
+
+enum class ExpiryPolicy : std::uint8_t { Drop, Demote };
+
+struct SubmitOptions {
+    Priority priority{Priority::Normal};
+    // A task still queued past its deadline is dropped (destroyed without
+    // running) or demoted to Low and run without a deadline. Default: none.
+    std::chrono::steady_clock::time_point deadline{};
+    ExpiryPolicy onExpired{ExpiryPolicy::Drop};
+};
+
+struct ThreadPoolOptions {
+    std::size_t numThreads{std::thread::hardware_concurrency()};
+    // Worker i is pinned to cpus[i % cpus.size()]; empty leaves threads unpinned.
+    std::vector<int> cpus;
+
+    // Elastic sizing. When maxThreads > numThreads, extra workers are spawned
+    // while some workers are blocked in I/O, fewer than numThreads are
+    // runnable and queued tasks have waited longer than spawnAfter. Extra
+    // workers exit after retireAfter without work.
+    std::size_t maxThreads{0};
+    std::chrono::milliseconds spawnAfter{50};
+    std::chrono::milliseconds retireAfter{10000};
+};
+
+struct WorkerStats {
+    bool active{false};
+    bool blocked{false};
+    std::size_t queueDepth{0};
+    std::uint64_t tasksRun{0};
+    std::uint64_t stealAttempts{0};
+    std::uint64_t steals{0};
+    std::uint64_t parks{0};
+    std::uint64_t wakeups{0};
+    std::uint64_t idleNs{0};
+};
+
+// Counters are cumulative since construction; histograms are in nanoseconds
+// and merged across workers.
+struct ThreadPoolStats {
+    std::vector<WorkerStats> workers;
+    std::vector<std::size_t> injectorDepth;
+    std::size_t laneDepth[kPriorityLevels]{};
+    std::size_t pendingTasks{0};
+    std::uint64_t droppedTasks{0};
+    HistogramSnapshot waitNs;
+    HistogramSnapshot runNs;
+};
+
 class ThreadPool {
 public:
+    // Marks the calling worker as blocked (e.g. waiting on a socket) for the
+    // scope's lifetime. No-op on threads that are not pool workers.
+    class BlockingScope {
+    public:
+        BlockingScope();
+        ~BlockingScope();
+
+        BlockingScope(const BlockingScope&) = delete;
+        BlockingScope& operator=(const BlockingScope&) = delete;
+
+    private:
+        std::atomic<bool>* flag_;
+    };
+
     explicit ThreadPool(std::size_t numThreads = std::thread::hardware_concurrency());
+    explicit ThreadPool(ThreadPoolOptions options);
     ~ThreadPool();
 
     ThreadPool(const ThreadPool&) = delete;
     ThreadPool& operator=(const ThreadPool&) = delete;
 
     void submit(Task task);
+    void submit(Task task, const SubmitOptions& options);
     void shutdown();
 
+    std::size_t activeWorkers() const { return activeWorkers_.load(std::memory_order_relaxed); }
+    std::size_t blockedWorkers() const;
+    std::uint64_t droppedTasks() const { return droppedTasks_.load(std::memory_order_relaxed); }
+    // Aggregates per-worker counters without stopping the workers.
+    ThreadPoolStats stats() const;
+    // Smallest enqueue-to-start wait among tasks started since the previous
+    // call (CoDel's sojourn signal). With no task started it is 0 if nothing
+    // is queued and UINT64_MAX otherwise. Meant for a single polling thread.
+    std::uint64_t takeMinSojournNs();
+
 private:
+    enum SlotState : int { kSlotEmpty = 0, kSlotRunning = 1 };
+
+    // Everything but slot, blocked, wakeups and the wait extremes (reset by
+    // the readers) is written only by the worker occupying the slot.
+    struct alignas(64) WorkerState {
+        std::atomic<int> slot{kSlotEmpty};
+        std::atomic<bool> blocked{false};
+        std::atomic<std::uint64_t> tasksStarted{0};
+        std::atomic<std::uint64_t> maxWaitNs{0};
+        std::atomic<std::uint64_t> minWaitNs{UINT64_MAX};
+        std::atomic<std::uint64_t> stealAttempts{0};
+        std::atomic<std::uint64_t> steals{0};
+        std::atomic<std::uint64_t> parks{0};
+        std::atomic<std::uint64_t> idleNs{0};
+        Histogram waitNs;
+        Histogram runNs;
+        alignas(64) std::atomic<std::uint64_t> wakeups{0};
+    };
+
+    struct WorkerLanes {
+        WorkStealingQueue lanes[kPriorityLevels];
+    };
+
+    struct InjectorLanes {
+        InjectionQueue lanes[kPriorityLevels];
+    };
+
     std::optional<Task> tryGetTask(std::size_t threadId);
+    std::optional<Task> tryGetFromLane(std::size_t threadId, std::size_t lane);
+    std::optional<Task> stealFrom(const std::vector<std::size_t>& victims, std::size_t threadId, std::size_t lane);
+    bool admitExpired(std::size_t threadId, Task& task);
+    std::optional<Task> spinForTask(std::size_t threadId);
     void workerThread(std::size_t threadId);
+    void runTask(std::size_t threadId, Task& task);
+    bool parkWorker(std::size_t threadId);
+    std::size_t submitterNode() const;
+
+    void supervisorThread();
+    void spawnWorker();
+
+    void markIdle(std::size_t threadId);
+    bool clearIdle(std::size_t threadId);
+    bool wakeOne();
 
+    ThreadPoolOptions options_;
+    std::size_t coreThreads_{0};
     std::vector<std::thread> workers_;
-    std::vector<std::unique_ptr<WorkStealingQueue>> queues_;
+    // Core workers allocate these after pinning so first-touch places them on
+    // the worker's NUMA node; elastic slots are allocated up front.
+    std::vector<std::unique_ptr<WorkerLanes>> queues_;
+    std::vector<std::unique_ptr<Parker>> parkers_;
+    std::unique_ptr<WorkerState[]> states_;
+    std::atomic<std::size_t> readyWorkers_{0};
+    std::atomic<std::size_t> activeWorkers_{0};
+
+    // Dense NUMA node indices. Without pinning everything is node 0.
+    std::vector<std::size_t> workerNode_;
+    std::vector<std::vector<std::size_t>> nodeWorkers_;
+    std::vector<std::size_t> cpuNode_;
+    std::vector<std::unique_ptr<InjectorLanes>> injectors_;
+
     std::atomic<bool> stop_{false};
-    std::atomic<std::size_t> nextQueue_{0};
     std::atomic<std::size_t> pendingTasks_{0};
+    // Per-lane queued counts; only used to skip empty lanes while searching.
+    alignas(64) std::atomic<std::size_t> lanePending_[kPriorityLevels]{};
+    std::atomic<std::uint64_t> droppedTasks_{0};
+
+    // Idle registry: one bit per parked worker. submit() only wakes a parked
+    // worker when nobody is already spinning for work.
+    std::unique_ptr<std::atomic<std::uint64_t>[]> idleMask_;
+    std::size_t idleWords_{0};
+    alignas(64) std::atomic<std::size_t> spinning_{0};
 
-    std::mutex cvMutex_;
-    std::condition_variable cv_;
+    std::thread supervisor_;
+    std::mutex supervisorMutex_;
+    std::condition_variable supervisorCv_;
 };
 
 }  // namespace threadpool
@@ -2,34 +2,133 @@
 
 namespace threadpool {
 
+WorkStealingQueue::Buffer::Buffer(std::size_t cap)
+    : capacity(cap), mask(cap - 1), slots(std::make_unique<std::atomic<Node*>[]>(cap)) {}
+
+WorkStealingQueue::WorkStealingQueue(std::size_t initialCapacity) {
+    std::size_t capacity = 2;
+    while (capacity < initialCapacity) {
+        capacity <<= 1;
+    }
+    buffers_.push_back(std::make_unique<Buffer>(capacity));
+    buffer_.store(buffers_.back().get(), std::memory_order_relaxed);
+}
+
+WorkStealingQueue::~WorkStealingQueue() {
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    const std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    for (std::int64_t i = top_.load(std::memory_order_relaxed); i < bottom; ++i) {
+        delete buffer->load(i);
+    }
+    deleteList(freeList_);
+    deleteList(returned_.load(std::memory_order_acquire));
+}
+
 void WorkStealingQueue::push(Task task) {
-    std::lock_guard<std::mutex> lock(mutex_);
-    tasks_.push_back(std::move(task));
+    const std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const std::int64_t top = top_.load(std::memory_order_acquire);
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    if (bottom - top > static_cast<std::int64_t>(buffer->capacity) - 1) {
+        buffer = grow(buffer, bottom, top);
+    }
+    Node* node = acquireNode();
+    node->task = std::move(task);
+    buffer->store(bottom, node);
+    bottom_.store(bottom + 1, std::memory_order_release);
 }
 
 std::optional<Task> WorkStealingQueue::pop() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (tasks_.empty()) {
+    const std::int64_t bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t top = top_.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
         return std::nullopt;
     }
-    Task task = std::move(tasks_.back());
-    tasks_.pop_back();
-    return task;
+
+    Node* node = buffer->load(bottom);
+    if (top == bottom) {
+        // Last element: race thieves for it through top_.
+        if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            node = nullptr;
+        }
+        bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    if (node == nullptr) {
+        return std::nullopt;
+    }
+
+    std::optional<Task> result(std::move(node->task));
+    node->next = freeList_;
+    freeList_ = node;
+    return result;
 }
 
 std::optional<Task> WorkStealingQueue::steal() {
-    std::lock_guard<std::mutex> lock(mutex_);
-    if (tasks_.empty()) {
-        return std::nullopt;
+    while (true) {
+        std::int64_t top = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const std::int64_t bottom = bottom_.load(std::memory_order_acquire);
+        if (top >= bottom) {
+            return std::nullopt;
+        }
+
+        Buffer* buffer = buffer_.load(std::memory_order_acquire);
+        Node* node = buffer->load(top);
+        if (top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            std::optional<Task> result(std::move(node->task));
+            returnNode(node);
+            return result;
+        }
     }
-    Task task = std::move(tasks_.front());
-    tasks_.pop_front();
-    return task;
 }
 
 std::size_t WorkStealingQueue::size() const {
-    std::lock_guard<std::mutex> lock(mutex_);
-    return tasks_.size();
+    const std::int64_t bottom = bottom_.load(std::memory_order_relaxed);
+    const std::int64_t top = top_.load(std::memory_order_relaxed);
+    return bottom > top ? static_cast<std::size_t>(bottom - top) : 0;
+}
+
+WorkStealingQueue::Buffer* WorkStealingQueue::grow(Buffer* current, std::int64_t bottom, std::int64_t top) {
+    auto next = std::make_unique<Buffer>(current->capacity * 2);
+    for (std::int64_t i = top; i < bottom; ++i) {
+        next->store(i, current->load(i));
+    }
+    Buffer* raw = next.get();
+    buffers_.push_back(std::move(next));
+    buffer_.store(raw, std::memory_order_release);
+    return raw;
+}
+
+WorkStealingQueue::Node* WorkStealingQueue::acquireNode() {
+    if (freeList_ == nullptr) {
+        freeList_ = returned_.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (freeList_ == nullptr) {
+        return new Node();
+    }
+    Node* node = freeList_;
+    freeList_ = node->next;
+    node->next = nullptr;
+    return node;
+}
+
+void WorkStealingQueue::returnNode(Node* node) {
+    Node* head = returned_.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!returned_.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void WorkStealingQueue::deleteList(Node* node) {
+    while (node != nullptr) {
+        Node* next = node->next;
+        delete node;
+        node = next;
+    }
 }
 
 }  // namespace threadpool
@@ -1,23 +1,68 @@
 #pragma once
 
-#include <deque>
-#include <mutex>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <vector>
 
 #include "threadpool/Task.h"
 
 namespace threadpool {
 
+// Chase-Lev deque: the owning worker pushes and pops at the bottom, any other
+// thread steals from the top. Only the owner may call push() and pop().
 class WorkStealingQueue {
 public:
+    explicit WorkStealingQueue(std::size_t initialCapacity = 256);
+    ~WorkStealingQueue();
+
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
     void push(Task task);
     std::optional<Task> pop();
     std::optional<Task> steal();
     std::size_t size() const;
 
 private:
-    mutable std::mutex mutex_;
-    std::deque<Task> tasks_;
+    // Tasks are stored in recycled nodes so steady-state push/pop/steal do not
+    // allocate: the owner keeps a private free list and thieves hand consumed
+    // nodes back through an atomic stack the owner drains in one exchange.
+    struct Node {
+        Task task;
+        Node* next{nullptr};
+    };
+
+    struct Buffer {
+        explicit Buffer(std::size_t cap);
+
+        Node* load(std::int64_t index) const {
+            return slots[static_cast<std::size_t>(index) & mask].load(std::memory_order_relaxed);
+        }
+        void store(std::int64_t index, Node* node) {
+            slots[static_cast<std::size_t>(index) & mask].store(node, std::memory_order_relaxed);
+        }
+
+        std::size_t capacity;
+        std::size_t mask;
+        std::unique_ptr<std::atomic<Node*>[]> slots;
+    };
+
+    Buffer* grow(Buffer* current, std::int64_t bottom, std::int64_t top);
+    Node* acquireNode();
+    void returnNode(Node* node);
+    static void deleteList(Node* node);
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    alignas(64) std::atomic<Buffer*> buffer_;
+    // Thieves may still be reading a buffer after the owner grows past it, so
+    // superseded buffers stay alive until the queue is destroyed.
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    Node* freeList_{nullptr};
+    alignas(64) std::atomic<Node*> returned_{nullptr};
 };
 
 }  // namespace threadpool
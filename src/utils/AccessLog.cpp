@@ -0,0 +1,249 @@
+#include "utils/AccessLog.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <unistd.h>
+
+namespace {
+
+constexpr auto kDrainInterval = std::chrono::milliseconds(10);
+constexpr std::size_t kBatchBytes = 256 * 1024;
+
+std::atomic<std::uint64_t> nextLogId{1};
+
+// One ring per (thread, log). The shared_ptr keeps the ring alive whichever of
+// the thread and the log goes first.
+struct ThreadRing {
+    std::uint64_t logId{0};
+    std::shared_ptr<void> ring;
+    std::atomic<bool>* owned{nullptr};
+
+    ~ThreadRing() {
+        if (owned != nullptr) {
+            owned->store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRing threadRing;
+
+bool writeFully(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+}  // namespace
+
+AccessLog::AccessLog(Options options) : options_(std::move(options)), id_(nextLogId.fetch_add(1)) {
+    batch_.reserve(kBatchBytes + kMaxUri + 128);
+    openOutput();
+    writer_ = std::thread([this]() { run(); });
+}
+
+AccessLog::~AccessLog() {
+    stop();
+    if (fd_ > STDERR_FILENO) {
+        ::close(fd_);
+    }
+}
+
+void AccessLog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+AccessLog::Ring& AccessLog::ringForThisThread() {
+    if (threadRing.logId == id_) {
+        return *static_cast<Ring*>(threadRing.ring.get());
+    }
+    std::shared_ptr<Ring> ring;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        // Adopt a ring left behind by an exited thread before adding one.
+        for (const auto& candidate : rings_) {
+            bool expected = false;
+            if (candidate->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                ring = candidate;
+                break;
+            }
+        }
+        if (!ring) {
+            ring = std::make_shared<Ring>();
+            rings_.push_back(ring);
+        }
+    }
+    if (threadRing.owned != nullptr) {
+        threadRing.owned->store(false, std::memory_order_release);
+    }
+    threadRing.logId = id_;
+    threadRing.owned = &ring->owned;
+    threadRing.ring = std::move(ring);
+    return *static_cast<Ring*>(threadRing.ring.get());
+}
+
+void AccessLog::record(std::string_view method, std::string_view uri, int status, std::uint64_t bytes) {
+    Ring& ring = ringForThisThread();
+    const std::uint64_t tail = ring.tail.load(std::memory_order_relaxed);
+    if (tail - ring.head.load(std::memory_order_acquire) >= kRingCapacity) {
+        ring.dropped.store(ring.dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    Record& slot = ring.records[tail % kRingCapacity];
+    slot.unixSeconds = std::chrono::duration_cast<std::chrono::seconds>(
+                           std::chrono::system_clock::now().time_since_epoch())
+                           .count();
+    slot.bytes = bytes;
+    slot.status = static_cast<std::uint16_t>(status);
+    slot.methodLength = static_cast<std::uint8_t>(std::min(method.size(), kMaxMethod));
+    slot.uriLength = static_cast<std::uint8_t>(std::min(uri.size(), kMaxUri));
+    std::memcpy(slot.method, method.data(), slot.methodLength);
+    std::memcpy(slot.uri, uri.data(), slot.uriLength);
+    ring.tail.store(tail + 1, std::memory_order_release);
+}
+
+std::uint64_t AccessLog::dropped() const {
+    std::lock_guard<std::mutex> lock(ringsMutex_);
+    std::uint64_t total = 0;
+    for (const auto& ring : rings_) {
+        total += ring->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+void AccessLog::run() {
+    while (true) {
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex_);
+            wake_.wait_for(lock, kDrainInterval, [this]() { return stopping_; });
+            stopping = stopping_;
+        }
+        if (reopenRequested_.exchange(false, std::memory_order_relaxed)) {
+            flush();
+            openOutput();
+        }
+        // Keep draining while the rings refill faster than one pass.
+        while (drain()) {
+        }
+        flush();
+        if (stopping) {
+            return;
+        }
+    }
+}
+
+// One pass over every ring; returns whether any ring was found full.
+bool AccessLog::drain() {
+    std::vector<Ring*> rings;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        rings.reserve(rings_.size());
+        for (const auto& ring : rings_) {
+            rings.push_back(ring.get());
+        }
+    }
+    bool busy = false;
+    for (Ring* ring : rings) {
+        const std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+        const std::uint64_t tail = ring->tail.load(std::memory_order_acquire);
+        busy = busy || tail - head == kRingCapacity;
+        for (std::uint64_t i = head; i != tail; ++i) {
+            format(ring->records[i % kRingCapacity]);
+            if (batch_.size() >= kBatchBytes) {
+                flush();
+            }
+        }
+        ring->head.store(tail, std::memory_order_release);
+    }
+    return busy;
+}
+
+void AccessLog::format(const Record& record) {
+    if (record.unixSeconds != cachedSecond_) {
+        cachedSecond_ = record.unixSeconds;
+        const auto seconds = static_cast<std::time_t>(record.unixSeconds);
+        std::tm tm{};
+        localtime_r(&seconds, &tm);
+        cachedStampLength_ = std::strftime(cachedStamp_, sizeof(cachedStamp_), "[%Y-%m-%d %H:%M:%S] ", &tm);
+    }
+    char numbers[48];
+    const int length = std::snprintf(numbers, sizeof(numbers), " %u %llu\n", static_cast<unsigned>(record.status),
+                                     static_cast<unsigned long long>(record.bytes));
+    batch_.append(cachedStamp_, cachedStampLength_);
+    batch_.append(record.method, record.methodLength);
+    batch_.push_back(' ');
+    batch_.append(record.uri, record.uriLength);
+    batch_.append(numbers, static_cast<std::size_t>(std::max(length, 0)));
+    written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AccessLog::flush() {
+    if (batch_.empty()) {
+        return;
+    }
+    if (options_.maxBytes != 0 && fd_ > STDERR_FILENO && fileSize_ + batch_.size() > options_.maxBytes &&
+        fileSize_ != 0) {
+        rotate();
+    }
+    if (fd_ >= 0 && writeFully(fd_, batch_.data(), batch_.size())) {
+        fileSize_ += batch_.size();
+    }
+    batch_.clear();
+}
+
+void AccessLog::openOutput() {
+    if (fd_ > STDERR_FILENO) {
+        ::close(fd_);
+    }
+    fileSize_ = 0;
+    if (options_.path.empty()) {
+        fd_ = STDOUT_FILENO;
+        return;
+    }
+    fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Cannot open access log " << options_.path << ": " << std::strerror(errno) << "\n";
+        return;
+    }
+    const off_t size = ::lseek(fd_, 0, SEEK_END);
+    fileSize_ = size > 0 ? static_cast<std::size_t>(size) : 0;
+}
+
+// path -> path.1 -> ... -> path.N (the oldest is overwritten).
+void AccessLog::rotate() {
+    for (std::size_t i = options_.keepFiles; i > 1; --i) {
+        const std::string from = options_.path + "." + std::to_string(i - 1);
+        const std::string to = options_.path + "." + std::to_string(i);
+        (void)std::rename(from.c_str(), to.c_str());
+    }
+    if (options_.keepFiles > 0) {
+        (void)std::rename(options_.path.c_str(), (options_.path + ".1").c_str());
+    } else {
+        (void)::ftruncate(fd_, 0);
+    }
+    openOutput();
+}
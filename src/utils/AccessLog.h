@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Asynchronous access log. Request threads copy a fixed-size binary record
+// into their own single-producer ring (no lock, no allocation, no syscall)
+// and a background thread drains every ring, formats the lines with a
+// timestamp cached per second and writes them in large batches. A full ring
+// drops the record and counts it instead of blocking the request.
+//
+// Output goes to a file (rotated to path.1 .. path.N past maxBytes, and
+// reopened on reopen() for external log rotation) or, with an empty path,
+// to stdout.
+class AccessLog {
+public:
+    struct Options {
+        std::string path;
+        // Rotate once the file would exceed this size; 0 never rotates.
+        std::size_t maxBytes{0};
+        std::size_t keepFiles{5};
+    };
+
+    static constexpr std::size_t kRingCapacity = 4096;
+    static constexpr std::size_t kMaxMethod = 8;
+    static constexpr std::size_t kMaxUri = 96;
+
+    explicit AccessLog(Options options);
+    ~AccessLog();
+
+    AccessLog(const AccessLog&) = delete;
+    AccessLog& operator=(const AccessLog&) = delete;
+
+    // Long URIs are truncated. Safe from any thread; never blocks.
+    void record(std::string_view method, std::string_view uri, int status, std::uint64_t bytes);
+
+    // Asks the writer thread to reopen the file (e.g. after SIGHUP).
+    void reopen() { reopenRequested_.store(true, std::memory_order_relaxed); }
+    // Flushes everything recorded before the call and stops the writer.
+    void stop();
+
+    std::uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    std::uint64_t dropped() const;
+
+private:
+    struct Record {
+        std::int64_t unixSeconds;
+        std::uint64_t bytes;
+        std::uint16_t status;
+        std::uint8_t methodLength;
+        std::uint8_t uriLength;
+        char method[kMaxMethod];
+        char uri[kMaxUri];
+    };
+
+    struct alignas(64) Ring {
+        std::atomic<std::uint64_t> head{0};
+        alignas(64) std::atomic<std::uint64_t> tail{0};
+        std::atomic<std::uint64_t> dropped{0};
+        // Cleared when the owning thread exits so another can adopt the ring.
+        std::atomic<bool> owned{true};
+        Record records[kRingCapacity];
+    };
+
+    Ring& ringForThisThread();
+    void run();
+    bool drain();
+    void format(const Record& record);
+    void flush();
+    void openOutput();
+    void rotate();
+
+    Options options_;
+    const std::uint64_t id_;
+
+    mutable std::mutex ringsMutex_;
+    std::vector<std::shared_ptr<Ring>> rings_;
+
+    // Writer thread state.
+    int fd_{-1};
+    std::size_t fileSize_{0};
+    std::string batch_;
+    std::int64_t cachedSecond_{-1};
+    char cachedStamp_[32]{};
+    std::size_t cachedStampLength_{0};
+
+    std::atomic<bool> reopenRequested_{false};
+    std::atomic<std::uint64_t> written_{0};
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    bool stopping_{false};
+    std::thread writer_;
+};
@@ -0,0 +1,130 @@
+#include "utils/BufferPool.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+
+namespace {
+
+constexpr std::size_t kBlocksPerSlab = BufferPool::kSlabSize / BufferPool::kBlockSize;
+constexpr std::size_t kCacheLimit = 64;
+constexpr std::size_t kRefillCount = kCacheLimit / 2;
+
+std::atomic<bool> hugePagesEnabled{false};
+
+char* mapSlab() {
+    void* memory = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (hugePagesEnabled.load(std::memory_order_relaxed)) {
+        memory = ::mmap(nullptr, BufferPool::kSlabSize, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (memory == MAP_FAILED) {
+        // No reserved huge pages: fall back to normal pages, and let THP back
+        // the slab if it can.
+        memory = ::mmap(nullptr, BufferPool::kSlabSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#if defined(MADV_HUGEPAGE)
+        if (hugePagesEnabled.load(std::memory_order_relaxed)) {
+            (void)::madvise(memory, BufferPool::kSlabSize, MADV_HUGEPAGE);
+        }
+#endif
+    }
+    return static_cast<char*>(memory);
+}
+
+// Fixed capacity, so releasing a block never allocates.
+struct ThreadCache {
+    char* blocks[kCacheLimit];
+    std::size_t count{0};
+
+    ~ThreadCache();
+};
+
+class Depot {
+public:
+    // Moves up to `count` blocks into `cache`, mapping a new slab if empty.
+    void take(ThreadCache& cache, std::size_t count) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            // Room for every block in existence, reserved before the slab is
+            // mapped, so give() never allocates.
+            free_.reserve((slabs_ + 1) * kBlocksPerSlab);
+            char* slab = mapSlab();
+            ++slabs_;
+            for (std::size_t i = 0; i < kBlocksPerSlab; ++i) {
+                free_.push_back(slab + i * BufferPool::kBlockSize);
+            }
+        }
+        while (count-- > 0 && !free_.empty() && cache.count < kCacheLimit) {
+            cache.blocks[cache.count++] = free_.back();
+            free_.pop_back();
+        }
+    }
+
+    void give(ThreadCache& cache, std::size_t count) noexcept {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (count-- > 0 && cache.count > 0) {
+            free_.push_back(cache.blocks[--cache.count]);
+        }
+    }
+
+    std::size_t slabs() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return slabs_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<char*> free_;
+    std::size_t slabs_{0};
+};
+
+// Never destroyed: thread caches may flush into it during static teardown.
+Depot& depot() {
+    static Depot* instance = new Depot;
+    return *instance;
+}
+
+ThreadCache::~ThreadCache() {
+    depot().give(*this, count);
+}
+
+ThreadCache& threadCache() {
+    thread_local ThreadCache cache;
+    return cache;
+}
+
+}  // namespace
+
+void BufferPool::setHugePages(bool enabled) {
+    hugePagesEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+char* BufferPool::acquire() {
+    ThreadCache& cache = threadCache();
+    if (cache.count == 0) {
+        depot().take(cache, kRefillCount);
+    }
+    return cache.blocks[--cache.count];
+}
+
+void BufferPool::release(char* block) noexcept {
+    if (block == nullptr) {
+        return;
+    }
+    ThreadCache& cache = threadCache();
+    if (cache.count == kCacheLimit) {
+        depot().give(cache, kCacheLimit / 2);
+    }
+    cache.blocks[cache.count++] = block;
+}
+
+std::size_t BufferPool::slabCount() {
+    return depot().slabs();
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// Fixed-size I/O blocks recycled through per-thread caches. Blocks are carved
+// from 2 MiB slabs that are never returned to the OS (huge-page backed when
+// enabled). A thread's cache spills half of itself to a shared depot when it
+// fills up and refills from the depot when empty, so the steady state takes
+// no lock and never calls malloc. Blocks may be released on any thread.
+class BufferPool {
+public:
+    static constexpr std::size_t kBlockSize = 16 * 1024;
+    static constexpr std::size_t kSlabSize = 2 * 1024 * 1024;
+
+    struct Deleter {
+        void operator()(char* block) const noexcept { release(block); }
+    };
+    using Block = std::unique_ptr<char[], Deleter>;
+
+    // Affects slabs mapped after the call; set it before serving traffic.
+    static void setHugePages(bool enabled);
+
+    static char* acquire();
+    static void release(char* block) noexcept;
+    static Block acquireBlock() { return Block(acquire()); }
+
+    static std::size_t slabCount();
+};
@@ -0,0 +1,93 @@
+#include "utils/CpuAffinity.h"
+
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace affinity {
+
+std::vector<int> parseCpuList(const std::string& spec) {
+    std::vector<int> cpus;
+    std::size_t pos = 0;
+    while (pos < spec.size()) {
+        std::size_t end = spec.find(',', pos);
+        if (end == std::string::npos) {
+            end = spec.size();
+        }
+        const std::string item = spec.substr(pos, end - pos);
+        const std::size_t dash = item.find('-');
+        int first = 0;
+        int last = 0;
+        try {
+            first = std::stoi(item.substr(0, dash));
+            last = dash == std::string::npos ? first : std::stoi(item.substr(dash + 1));
+        } catch (const std::exception&) {
+            throw std::invalid_argument("Invalid CPU list: " + spec);
+        }
+        // Checked before expanding, so "0-100000000" cannot build a huge list.
+        if (first < 0 || last < first || last >= kMaxCpus) {
+            throw std::invalid_argument("Invalid CPU list: " + spec + " (ids must be 0-" +
+                                        std::to_string(kMaxCpus - 1) + ", ranges low-high)");
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+        pos = end + 1;
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+#if defined(__linux__)
+    if (cpus.empty()) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const int cpu : cpus) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+
+int currentCpu() {
+#if defined(__linux__)
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+int numaNodeOfCpu(int cpu) {
+    std::error_code ec;
+    const std::filesystem::path dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0) {
+            try {
+                return std::stoi(name.substr(4));
+            } catch (const std::exception&) {
+                return 0;
+            }
+        }
+    }
+    return 0;
+}
+
+int configuredCpuCount() {
+    const long count = ::sysconf(_SC_NPROCESSORS_CONF);
+    return count > 0 ? static_cast<int>(count) : 1;
+}
+
+}  // namespace affinity
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace affinity {
+
+// Largest CPU id + 1 that an affinity mask can name.
+#if defined(__linux__)
+inline constexpr int kMaxCpus = CPU_SETSIZE;
+#else
+inline constexpr int kMaxCpus = 1024;
+#endif
+
+// Parses lists such as "0-3,8,10-11". Throws std::invalid_argument on
+// malformed items, reversed ranges and ids of kMaxCpus or more.
+std::vector<int> parseCpuList(const std::string& spec);
+
+// Pins the calling thread to the given CPUs. Returns false when the platform
+// has no affinity API or the kernel rejected the set.
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+int currentCpu();
+int numaNodeOfCpu(int cpu);
+int configuredCpuCount();
+
+}  // namespace affinity
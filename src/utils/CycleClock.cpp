@@ -0,0 +1,50 @@
+#include "utils/CycleClock.h"
+
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+// CPUID 0x80000007 EDX bit 8: the TSC ticks at a constant rate in every
+// P-/C-state and is synchronised across cores.
+bool hasInvariantTsc() {
+    unsigned eax = 0;
+    unsigned ebx = 0;
+    unsigned ecx = 0;
+    unsigned edx = 0;
+    if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 0) {
+        return false;
+    }
+    return (edx & (1u << 8)) != 0;
+}
+#endif
+
+}  // namespace
+
+void CycleClock::calibrate() {
+    static std::once_flag once;
+    std::call_once(once, []() {
+#if defined(__x86_64__) || defined(__i386__)
+        if (!hasInvariantTsc()) {
+            return;
+        }
+        const auto startTime = std::chrono::steady_clock::now();
+        const std::uint64_t startTicks = __rdtsc();
+        auto endTime = startTime;
+        while (endTime - startTime < std::chrono::milliseconds(10)) {
+            endTime = std::chrono::steady_clock::now();
+        }
+        const std::uint64_t endTicks = __rdtsc();
+        if (endTicks <= startTicks) {
+            return;
+        }
+        const auto elapsedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+        nanosPerTick_ = static_cast<double>(elapsedNs) / static_cast<double>(endTicks - startTicks);
+        useTsc_.store(true, std::memory_order_release);
+#endif
+    });
+}
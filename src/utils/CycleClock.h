@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Cheap monotonic timestamps for phase timing. On x86 with an invariant TSC
+// (after calibrate()), ticks are raw rdtsc cycles; everywhere else they are
+// steady_clock nanoseconds. Only differences of ticks are meaningful, and
+// only between ticks taken on the same side of calibrate().
+class CycleClock {
+public:
+    // Measures the TSC rate against steady_clock (a ~10 ms spin) on the
+    // first call; later calls return immediately.
+    static void calibrate();
+
+    static std::uint64_t now() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        if (useTsc_.load(std::memory_order_relaxed)) {
+            return __rdtsc();
+        }
+#endif
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                              std::chrono::steady_clock::now().time_since_epoch())
+                                              .count());
+    }
+
+    static std::uint64_t toNanoseconds(std::uint64_t ticks) noexcept {
+        if (!useTsc_.load(std::memory_order_acquire)) {
+            return ticks;
+        }
+        return static_cast<std::uint64_t>(static_cast<double>(ticks) * nanosPerTick_);
+    }
+
+    static bool usesTsc() noexcept { return useTsc_.load(std::memory_order_relaxed); }
+
+private:
+    static inline std::atomic<bool> useTsc_{false};
+    static inline double nanosPerTick_{1.0};
+};
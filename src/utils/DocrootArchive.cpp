@@ -0,0 +1,137 @@
+#include "utils/DocrootArchive.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace archive {
+
+std::uint64_t hashPath(std::string_view path) {
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const char c : path) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::uint32_t bucketFor(std::uint64_t hash, std::uint32_t bucketCount) {
+    return static_cast<std::uint32_t>((hash >> 32) % bucketCount);
+}
+
+std::uint32_t slotFor(std::uint64_t hash, std::uint32_t seed, std::uint32_t slotCount) {
+    std::uint64_t x = hash ^ (static_cast<std::uint64_t>(seed) * 0x9E3779B97F4A7C15ull);
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return static_cast<std::uint32_t>(x % slotCount);
+}
+
+}  // namespace archive
+
+namespace {
+std::runtime_error makeError(const std::string& prefix) {
+    return std::runtime_error(prefix + ": errno=" + std::to_string(errno) + " (" + std::strerror(errno) + ")");
+}
+
+bool rangeValid(std::uint64_t offset, std::uint64_t length, std::size_t size) {
+    return offset <= size && length <= size - offset;
+}
+}  // namespace
+
+DocrootArchive::DocrootArchive(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) {
+        throw makeError("open(" + path + ") failed");
+    }
+
+    struct stat st{};
+    if (::fstat(fd_, &st) < 0) {
+        const auto error = makeError("fstat(" + path + ") failed");
+        ::close(fd_);
+        throw error;
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ < sizeof(archive::ArchiveHeader)) {
+        ::close(fd_);
+        throw std::runtime_error("Docroot archive truncated: " + path);
+    }
+
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapping == MAP_FAILED) {
+        const auto error = makeError("mmap(" + path + ") failed");
+        ::close(fd_);
+        throw error;
+    }
+    base_ = static_cast<const char*>(mapping);
+
+    header_ = reinterpret_cast<const archive::ArchiveHeader*>(base_);
+    const bool valid =
+        std::memcmp(header_->magic, archive::kMagic, sizeof(archive::kMagic)) == 0 &&
+        header_->version == archive::kVersion && header_->fileSize == size_ &&
+        header_->bucketCount > 0 && header_->slotCount >= header_->entryCount && header_->slotCount > 0 &&
+        rangeValid(header_->seedsOffset, std::uint64_t{header_->bucketCount} * sizeof(std::uint32_t), size_) &&
+        rangeValid(header_->slotsOffset, std::uint64_t{header_->slotCount} * sizeof(std::uint32_t), size_) &&
+        rangeValid(header_->entriesOffset, std::uint64_t{header_->entryCount} * sizeof(archive::ArchiveEntry),
+                   size_) &&
+        rangeValid(header_->stringsOffset, header_->stringsSize, size_);
+    if (!valid) {
+        ::munmap(mapping, size_);
+        ::close(fd_);
+        throw std::runtime_error("Invalid docroot archive: " + path);
+    }
+
+    seeds_ = reinterpret_cast<const std::uint32_t*>(base_ + header_->seedsOffset);
+    slots_ = reinterpret_cast<const std::uint32_t*>(base_ + header_->slotsOffset);
+    entries_ = reinterpret_cast<const archive::ArchiveEntry*>(base_ + header_->entriesOffset);
+    (void)::madvise(mapping, size_, MADV_WILLNEED);
+}
+
+DocrootArchive::~DocrootArchive() {
+    if (base_ != nullptr) {
+        ::munmap(const_cast<char*>(base_), size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+}
+
+bool DocrootArchive::lookup(std::string_view path, ArchivedFile& out) const {
+    const std::uint64_t hash = archive::hashPath(path);
+    const std::uint32_t seed = seeds_[archive::bucketFor(hash, header_->bucketCount)];
+    const std::uint32_t index = slots_[archive::slotFor(hash, seed, header_->slotCount)];
+    if (index >= header_->entryCount) {
+        return false;
+    }
+
+    const archive::ArchiveEntry& entry = entries_[index];
+    if (entry.pathHash != hash || stringAt(entry.pathOffset, entry.pathLength) != path) {
+        return false;
+    }
+
+    out.content = blobAt(entry.dataOffset, entry.dataLength);
+    out.gzipContent = blobAt(entry.gzipOffset, entry.gzipLength);
+    out.mimeType = stringAt(entry.mimeOffset, entry.mimeLength);
+    out.etag = stringAt(entry.etagOffset, entry.etagLength);
+    return true;
+}
+
+std::string_view DocrootArchive::stringAt(std::uint32_t offset, std::uint32_t length) const {
+    if (!rangeValid(offset, length, header_->stringsSize)) {
+        return {};
+    }
+    return std::string_view(base_ + header_->stringsOffset + offset, length);
+}
+
+std::string_view DocrootArchive::blobAt(std::uint64_t offset, std::uint64_t length) const {
+    if (length == 0 || !rangeValid(offset, length, size_)) {
+        return {};
+    }
+    return std::string_view(base_ + offset, static_cast<std::size_t>(length));
+}
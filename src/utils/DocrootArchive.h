@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// On-disk layout (native endianness, all offsets absolute):
+//   ArchiveHeader
+//   uint32_t seeds[bucketCount]      displacement seed per hash bucket
+//   uint32_t slots[slotCount]        entry index per slot, kEmptySlot if unused
+//   ArchiveEntry entries[entryCount]
+//   string table (paths, MIME types, ETags)
+//   file blobs, each aligned to kBlobAlignment
+namespace archive {
+
+constexpr char kMagic[8] = {'H', 'S', 'D', 'A', 'R', 'C', 'H', '1'};
+constexpr std::uint32_t kVersion = 1;
+constexpr std::uint32_t kEmptySlot = 0xFFFFFFFFu;
+constexpr std::size_t kBlobAlignment = 64;
+
+struct ArchiveHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t entryCount;
+    std::uint32_t bucketCount;
+    std::uint32_t slotCount;
+    std::uint64_t seedsOffset;
+    std::uint64_t slotsOffset;
+    std::uint64_t entriesOffset;
+    std::uint64_t stringsOffset;
+    std::uint64_t stringsSize;
+    std::uint64_t fileSize;
+};
+
+struct ArchiveEntry {
+    std::uint64_t pathHash;
+    std::uint32_t pathOffset;
+    std::uint32_t pathLength;
+    std::uint32_t mimeOffset;
+    std::uint32_t mimeLength;
+    std::uint32_t etagOffset;
+    std::uint32_t etagLength;
+    std::uint64_t dataOffset;
+    std::uint64_t dataLength;
+    std::uint64_t gzipOffset;
+    std::uint64_t gzipLength;
+};
+
+std::uint64_t hashPath(std::string_view path);
+std::uint32_t bucketFor(std::uint64_t hash, std::uint32_t bucketCount);
+std::uint32_t slotFor(std::uint64_t hash, std::uint32_t seed, std::uint32_t slotCount);
+
+}  // namespace archive
+
+struct ArchivedFile {
+    std::string_view content;
+    std::string_view gzipContent;
+    std::string_view mimeType;
+    std::string_view etag;
+};
+
+class DocrootArchive {
+public:
+    explicit DocrootArchive(const std::string& path);
+    ~DocrootArchive();
+
+    DocrootArchive(const DocrootArchive&) = delete;
+    DocrootArchive& operator=(const DocrootArchive&) = delete;
+
+    bool lookup(std::string_view path, ArchivedFile& out) const;
+    std::size_t entryCount() const { return header_->entryCount; }
+    int fd() const { return fd_; }
+
+private:
+    std::string_view stringAt(std::uint32_t offset, std::uint32_t length) const;
+    std::string_view blobAt(std::uint64_t offset, std::uint64_t length) const;
+
+    int fd_{-1};
+    const char* base_{nullptr};
+    std::size_t size_{0};
+    const archive::ArchiveHeader* header_{nullptr};
+    const std::uint32_t* seeds_{nullptr};
+    const std::uint32_t* slots_{nullptr};
+    const archive::ArchiveEntry* entries_{nullptr};
+};
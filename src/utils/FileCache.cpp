@@ -4,7 +4,7 @@
 
 FileCache::FileCache(std::size_t maxSize) : maxSize_(maxSize == 0 ? 1 : maxSize) {}
 
-std::optional<CachedFile> FileCache::get(const std::string& path) {
+std::optional<CachedFile> FileCache::get(std::string_view path) {
     std::lock_guard<std::mutex> lock(mutex_);
     auto it = cache_.find(path);
     if (it == cache_.end()) {
@@ -12,16 +12,50 @@ std::optional<CachedFile> FileCache::get(const std::string& path) {
     }
 
     it->second.lastAccess = std::chrono::steady_clock::now();
-    return CachedFile{it->second.content, it->second.mimeType};
+    return CachedFile{it->second.content, it->second.mimeType, it->second.stamp, it->second.verifiedAt};
 }
 
-void FileCache::put(const std::string& path, std::string content, std::string mimeType) {
+void FileCache::put(const std::string& path, std::shared_ptr<const std::string> content, std::string mimeType,
+                    FileStamp stamp) {
     std::lock_guard<std::mutex> lock(mutex_);
-    if (cache_.size() >= maxSize_) {
+    if (cache_.size() >= maxSize_ && cache_.find(path) == cache_.end()) {
         evictLRU();
     }
 
-    cache_[path] = CacheEntry{std::move(content), std::move(mimeType), std::chrono::steady_clock::now()};
+    const auto now = std::chrono::steady_clock::now();
+    CacheEntry entry{std::move(content), std::move(mimeType), stamp, now, now};
+    const bool inserted = cache_.insert_or_assign(path, std::move(entry)).second;
+    if (inserted && metrics_ != nullptr) {
+        metrics_->add(entriesMetric_);
+    }
+}
+
+void FileCache::markVerified(std::string_view path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.find(path);
+    if (it != cache_.end()) {
+        it->second.verifiedAt = std::chrono::steady_clock::now();
+    }
+}
+
+void FileCache::erase(std::string_view path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cache_.find(path);
+    if (it == cache_.end()) {
+        return;
+    }
+    cache_.erase(it);
+    if (metrics_ != nullptr) {
+        metrics_->subtract(entriesMetric_);
+    }
+}
+
+void FileCache::setMetrics(Metrics* metrics) {
+    metrics_ = metrics;
+    if (metrics_ != nullptr) {
+        entriesMetric_ = metrics_->gauge("file_cache_entries", "Files held in the file cache");
+        evictionsMetric_ = metrics_->counter("file_cache_evictions_total", "Files evicted from the file cache");
+    }
 }
 
 void FileCache::evictLRU() {
@@ -40,4 +74,8 @@ void FileCache::evictLRU() {
     }
 
     cache_.erase(oldestIt);
+    if (metrics_ != nullptr) {
+        metrics_->subtract(entriesMetric_);
+        metrics_->add(evictionsMetric_);
+    }
 }
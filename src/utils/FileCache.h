@@ -1,33 +1,71 @@
 #pragma once
 
 #include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
+#include "utils/Metrics.h"
+
+// Identifies one version of a file on disk, to tell whether a cached copy
+// is still current.
+struct FileStamp {
+    std::uint64_t device{0};
+    std::uint64_t inode{0};
+    std::uint64_t size{0};
+    std::int64_t mtimeNs{0};
+
+    bool operator==(const FileStamp&) const = default;
+};
+
+// Hits share the cached content instead of copying it.
 struct CachedFile {
-    std::string content;
+    std::shared_ptr<const std::string> content;
     std::string mimeType;
+    FileStamp stamp;
+    // When the stamp was last checked against the file.
+    std::chrono::steady_clock::time_point verifiedAt;
 };
 
 class FileCache {
 public:
     explicit FileCache(std::size_t maxSize);
 
-    std::optional<CachedFile> get(const std::string& path);
-    void put(const std::string& path, std::string content, std::string mimeType);
+    std::optional<CachedFile> get(std::string_view path);
+    // The entry counts as verified now.
+    void put(const std::string& path, std::shared_ptr<const std::string> content, std::string mimeType,
+             FileStamp stamp = {});
+    // Records that the entry still matches the file.
+    void markVerified(std::string_view path);
+    void erase(std::string_view path);
+    // Registers entry and eviction counts; call before serving.
+    void setMetrics(Metrics* metrics);
 
 private:
+    struct PathHash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view path) const noexcept { return std::hash<std::string_view>{}(path); }
+    };
+
     struct CacheEntry {
-        std::string content;
+        std::shared_ptr<const std::string> content;
         std::string mimeType;
+        FileStamp stamp;
+        std::chrono::steady_clock::time_point verifiedAt;
         std::chrono::steady_clock::time_point lastAccess;
     };
 
     void evictLRU();
 
-    std::unordered_map<std::string, CacheEntry> cache_;
+    std::unordered_map<std::string, CacheEntry, PathHash, std::equal_to<>> cache_;
     std::mutex mutex_;
     std::size_t maxSize_;
+    Metrics* metrics_{nullptr};
+    Metrics::Id entriesMetric_{0};
+    Metrics::Id evictionsMetric_{0};
 };
@@ -0,0 +1,64 @@
+#include "utils/Histogram.h"
+
+#include <cmath>
+#include <limits>
+
+void Histogram::addTo(HistogramSnapshot& snapshot) const {
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        const std::uint64_t count = counts_[i].load(std::memory_order_relaxed);
+        snapshot.counts[i] += count;
+        snapshot.total += count;
+    }
+    snapshot.sum += sum_.load(std::memory_order_relaxed);
+}
+
+std::uint64_t Histogram::lowestValueIn(std::size_t bucket) noexcept {
+    if (bucket < kSubBuckets) {
+        return bucket;
+    }
+    const std::size_t magnitude = bucket / kSubBuckets - 1;
+    const std::uint64_t sub = bucket % kSubBuckets;
+    return (kSubBuckets + sub) << magnitude;
+}
+
+std::uint64_t Histogram::highestValueIn(std::size_t bucket) noexcept {
+    if (bucket + 1 >= kBucketCount) {
+        return std::numeric_limits<std::uint64_t>::max();
+    }
+    return lowestValueIn(bucket + 1) - 1;
+}
+
+void HistogramSnapshot::merge(const HistogramSnapshot& other) {
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+    sum += other.sum;
+}
+
+std::uint64_t HistogramSnapshot::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+    auto rank = static_cast<std::uint64_t>(std::ceil(p / 100.0 * static_cast<double>(total)));
+    if (rank == 0) {
+        rank = 1;
+    }
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < counts.size(); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return Histogram::highestValueIn(i);
+        }
+    }
+    return max();
+}
+
+std::uint64_t HistogramSnapshot::max() const {
+    for (std::size_t i = counts.size(); i > 0; --i) {
+        if (counts[i - 1] != 0) {
+            return Histogram::highestValueIn(i - 1);
+        }
+    }
+    return 0;
+}
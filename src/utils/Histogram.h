@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct HistogramSnapshot;
+
+// Log-linear (HDR style) histogram of unsigned values: each power of two is
+// split into kSubBuckets linear steps, so a value is reported within ~6% of
+// what was recorded. record() assumes a single writer and never locks;
+// readers can snapshot while it runs.
+class Histogram {
+public:
+    static constexpr unsigned kSubBucketBits = 4;
+    static constexpr std::size_t kSubBuckets = std::size_t{1} << kSubBucketBits;
+    static constexpr std::size_t kBucketCount = kSubBuckets * (64 - kSubBucketBits + 1);
+
+    void record(std::uint64_t value) noexcept {
+        bump(counts_[bucketFor(value)], 1);
+        bump(sum_, value);
+    }
+
+    // For histograms shared between writers.
+    void recordConcurrent(std::uint64_t value) noexcept {
+        counts_[bucketFor(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    void addTo(HistogramSnapshot& snapshot) const;
+
+    static std::size_t bucketFor(std::uint64_t value) noexcept {
+        if (value < kSubBuckets) {
+            return static_cast<std::size_t>(value);
+        }
+        const auto msb = static_cast<unsigned>(63 - __builtin_clzll(value));
+        const unsigned shift = msb - kSubBucketBits;
+        return (msb - kSubBucketBits + 1) * kSubBuckets + static_cast<std::size_t>((value >> shift) & (kSubBuckets - 1));
+    }
+
+    static std::uint64_t lowestValueIn(std::size_t bucket) noexcept;
+    static std::uint64_t highestValueIn(std::size_t bucket) noexcept;
+
+private:
+    static void bump(std::atomic<std::uint64_t>& counter, std::uint64_t delta) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    std::atomic<std::uint64_t> counts_[kBucketCount]{};
+    std::atomic<std::uint64_t> sum_{0};
+};
+
+// Plain copy of one or more histograms merged together.
+struct HistogramSnapshot {
+    std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(Histogram::kBucketCount, 0);
+    std::uint64_t total{0};
+    std::uint64_t sum{0};
+
+    void merge(const HistogramSnapshot& other);
+    // Upper bound of the bucket holding the p-th percentile (0 < p <= 100).
+    std::uint64_t percentile(double p) const;
+    std::uint64_t max() const;
+    double mean() const { return total == 0 ? 0.0 : static_cast<double>(sum) / static_cast<double>(total); }
+};
@@ -0,0 +1,232 @@
+#include "utils/Metrics.h"
+
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+
+std::atomic<std::uint64_t> nextRegistryId{1};
+
+struct ThreadShard {
+    std::uint64_t registryId{0};
+    std::shared_ptr<void> shard;
+    std::atomic<bool>* owned{nullptr};
+
+    ~ThreadShard() {
+        if (owned != nullptr) {
+            owned->store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadShard threadShard;
+
+// Prometheus bucket bounds in seconds, with the same values in nanoseconds.
+// A histogram bucket is counted under a bound only if it lies entirely below
+// it, so cumulative counts are exact to the histogram's ~6% resolution.
+constexpr std::string_view kBucketLabels[] = {"0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005",
+                                              "0.01",   "0.025",   "0.05",   "0.1",   "0.25",   "0.5",
+                                              "1",      "2.5",     "5",      "10"};
+constexpr std::uint64_t kBucketBoundsNs[] = {100'000,     250'000,       500'000,       1'000'000,
+                                             2'500'000,   5'000'000,     10'000'000,    25'000'000,
+                                             50'000'000,  100'000'000,   250'000'000,   500'000'000,
+                                             1'000'000'000, 2'500'000'000, 5'000'000'000, 10'000'000'000};
+
+void appendNumber(std::string& out, std::uint64_t value) {
+    char digits[24];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void appendNumber(std::string& out, double value) {
+    char digits[32];
+    const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    out.append(digits, result.ptr);
+}
+
+void appendHeader(std::string& out, std::string_view name, std::string_view help, std::string_view type) {
+    out.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void appendSample(std::string& out, std::string_view name, std::string_view labels) {
+    out.append(name);
+    if (!labels.empty()) {
+        out.append("{").append(labels).append("}");
+    }
+    out.push_back(' ');
+}
+
+void appendHistogramSeries(std::string& out, std::string_view name, std::string_view labels,
+                           const HistogramSnapshot& nanoseconds) {
+    const std::string_view separator = labels.empty() ? "" : ",";
+    std::size_t bucket = 0;
+    std::uint64_t cumulative = 0;
+    for (std::size_t i = 0; i <= std::size(kBucketBoundsNs); ++i) {
+        std::string_view bound = "+Inf";
+        if (i < std::size(kBucketBoundsNs)) {
+            while (bucket < nanoseconds.counts.size() &&
+                   Histogram::highestValueIn(bucket) <= kBucketBoundsNs[i]) {
+                cumulative += nanoseconds.counts[bucket++];
+            }
+            bound = kBucketLabels[i];
+        } else {
+            cumulative = nanoseconds.total;
+        }
+        out.append(name).append("_bucket{").append(labels).append(separator);
+        out.append("le=\"").append(bound).append("\"} ");
+        appendNumber(out, cumulative);
+        out.push_back('\n');
+    }
+    appendSample(out, std::string(name) + "_sum", labels);
+    appendNumber(out, static_cast<double>(nanoseconds.sum) / 1e9);
+    out.push_back('\n');
+    appendSample(out, std::string(name) + "_count", labels);
+    appendNumber(out, nanoseconds.total);
+    out.push_back('\n');
+}
+
+}  // namespace
+
+Metrics::Metrics() : id_(nextRegistryId.fetch_add(1)) {}
+
+Metrics::Id Metrics::counter(std::string name, std::string help, std::string labels) {
+    return addSeries(Kind::Counter, std::move(name), std::move(help), std::move(labels));
+}
+
+Metrics::Id Metrics::gauge(std::string name, std::string help, std::string labels) {
+    return addSeries(Kind::Gauge, std::move(name), std::move(help), std::move(labels));
+}
+
+Metrics::Id Metrics::addSeries(Kind kind, std::string name, std::string help, std::string labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!shards_.empty()) {
+        throw std::logic_error("Metrics registered after recording started: " + name);
+    }
+    series_.push_back(Series{kind, std::move(name), std::move(help), std::move(labels)});
+    return static_cast<Id>(series_.size() - 1);
+}
+
+Metrics::Id Metrics::histogram(std::string name, std::string help, std::string labels) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!shards_.empty()) {
+        throw std::logic_error("Metrics registered after recording started: " + name);
+    }
+    histograms_.push_back(HistogramInfo{std::move(name), std::move(help), std::move(labels)});
+    return static_cast<Id>(histograms_.size() - 1);
+}
+
+void Metrics::addCollector(Collector collector) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    collectors_.push_back(std::move(collector));
+}
+
+Metrics::Shard& Metrics::shardForThisThread() {
+    if (threadShard.registryId == id_) {
+        return *static_cast<Shard*>(threadShard.shard.get());
+    }
+    std::shared_ptr<Shard> shard;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& candidate : shards_) {
+            bool expected = false;
+            if (candidate->owned.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                shard = candidate;
+                break;
+            }
+        }
+        if (!shard) {
+            shard = std::make_shared<Shard>(series_.size(), histograms_.size());
+            shards_.push_back(shard);
+        }
+    }
+    if (threadShard.owned != nullptr) {
+        threadShard.owned->store(false, std::memory_order_release);
+    }
+    threadShard.registryId = id_;
+    threadShard.owned = &shard->owned;
+    threadShard.shard = std::move(shard);
+    return *static_cast<Shard*>(threadShard.shard.get());
+}
+
+void Metrics::add(Id counter, std::uint64_t delta) {
+    std::atomic<std::uint64_t>& value = shardForThisThread().values[counter];
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+void Metrics::observe(Id histogram, std::uint64_t nanoseconds) {
+    shardForThisThread().histograms[histogram].record(nanoseconds);
+}
+
+std::uint64_t Metrics::value(Id counter) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::uint64_t total = 0;
+    for (const auto& shard : shards_) {
+        total += shard->values[counter].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::string Metrics::render() const {
+    std::vector<Collector> collectors;
+    std::string out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::uint64_t> totals(series_.size(), 0);
+        std::vector<HistogramSnapshot> snapshots(histograms_.size());
+        for (const auto& shard : shards_) {
+            for (std::size_t i = 0; i < series_.size(); ++i) {
+                totals[i] += shard->values[i].load(std::memory_order_relaxed);
+            }
+            for (std::size_t i = 0; i < histograms_.size(); ++i) {
+                shard->histograms[i].addTo(snapshots[i]);
+            }
+        }
+
+        for (std::size_t i = 0; i < series_.size(); ++i) {
+            const Series& series = series_[i];
+            if (i == 0 || series_[i - 1].name != series.name) {
+                appendHeader(out, series.name, series.help, series.kind == Kind::Counter ? "counter" : "gauge");
+            }
+            appendSample(out, series.name, series.labels);
+            if (series.kind == Kind::Counter) {
+                appendNumber(out, totals[i]);
+            } else {
+                appendNumber(out, static_cast<double>(static_cast<std::int64_t>(totals[i])));
+            }
+            out.push_back('\n');
+        }
+        for (std::size_t i = 0; i < histograms_.size(); ++i) {
+            const HistogramInfo& histogram = histograms_[i];
+            if (i == 0 || histograms_[i - 1].name != histogram.name) {
+                appendHeader(out, histogram.name, histogram.help, "histogram");
+            }
+            appendHistogramSeries(out, histogram.name, histogram.labels, snapshots[i]);
+        }
+        collectors = collectors_;
+    }
+    for (const Collector& collector : collectors) {
+        collector(out);
+    }
+    return out;
+}
+
+void Metrics::appendCounter(std::string& out, std::string_view name, std::string_view help, std::uint64_t value) {
+    appendHeader(out, name, help, "counter");
+    appendSample(out, name, "");
+    appendNumber(out, value);
+    out.push_back('\n');
+}
+
+void Metrics::appendGauge(std::string& out, std::string_view name, std::string_view help, double value) {
+    appendHeader(out, name, help, "gauge");
+    appendSample(out, name, "");
+    appendNumber(out, value);
+    out.push_back('\n');
+}
+
+void Metrics::appendHistogram(std::string& out, std::string_view name, std::string_view help,
+                              const HistogramSnapshot& nanoseconds) {
+    appendHeader(out, name, help, "histogram");
+    appendHistogramSeries(out, name, "", nanoseconds);
+}
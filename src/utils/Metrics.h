@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils/Histogram.h"
+
+// Registry of counters, gauges and latency histograms exported in the
+// Prometheus text format. Every thread records into its own shard (a plain
+// relaxed load/store per value, no shared cache lines); render() sums the
+// shards. Metrics are registered up front, before the first value is
+// recorded; collectors append values that are computed only on scrape.
+class Metrics {
+public:
+    using Id = std::uint32_t;
+    using Collector = std::function<void(std::string&)>;
+
+    Metrics();
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+    // Series sharing a name must be registered one after another; `labels`
+    // is the text between the braces, e.g. `code="200"`. Registering once
+    // any thread has recorded a value throws std::logic_error.
+    Id counter(std::string name, std::string help, std::string labels = "");
+    // Summed across threads, so a value added on one thread may be
+    // subtracted on another.
+    Id gauge(std::string name, std::string help, std::string labels = "");
+    // Recorded in nanoseconds, exported in seconds.
+    Id histogram(std::string name, std::string help, std::string labels = "");
+
+    void add(Id counter, std::uint64_t delta = 1);
+    void subtract(Id gauge, std::uint64_t delta = 1) { add(gauge, ~delta + 1); }
+    void observe(Id histogram, std::uint64_t nanoseconds);
+
+    void addCollector(Collector collector);
+    std::string render() const;
+
+    std::uint64_t value(Id counter) const;
+
+    static void appendCounter(std::string& out, std::string_view name, std::string_view help, std::uint64_t value);
+    static void appendGauge(std::string& out, std::string_view name, std::string_view help, double value);
+    static void appendHistogram(std::string& out, std::string_view name, std::string_view help,
+                                const HistogramSnapshot& nanoseconds);
+
+private:
+    enum class Kind { Counter, Gauge };
+
+    struct Series {
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;
+    };
+
+    struct HistogramInfo {
+        std::string name;
+        std::string help;
+        std::string labels;
+    };
+
+    struct Shard {
+        Shard(std::size_t values, std::size_t histograms)
+            : values(new std::atomic<std::uint64_t>[values]()), histograms(new Histogram[histograms]) {}
+
+        std::unique_ptr<std::atomic<std::uint64_t>[]> values;
+        std::unique_ptr<Histogram[]> histograms;
+        // Cleared when the owning thread exits so another can adopt the shard.
+        std::atomic<bool> owned{true};
+    };
+
+    Id addSeries(Kind kind, std::string name, std::string help, std::string labels);
+    Shard& shardForThisThread();
+
+    const std::uint64_t id_;
+    mutable std::mutex mutex_;
+    std::vector<Series> series_;
+    std::vector<HistogramInfo> histograms_;
+    std::vector<Collector> collectors_;
+    std::vector<std::shared_ptr<Shard>> shards_;
+};
@@ -0,0 +1,71 @@
+#include "utils/RecvBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+RecvBuffer::~RecvBuffer() {
+    releaseStorage();
+}
+
+char* RecvBuffer::prepare(std::size_t minWritable) {
+    if (writableBytes() >= minWritable) {
+        return storage_ + tail_;
+    }
+    const std::size_t used = size();
+    if (capacity_ - used >= minWritable && head_ >= used) {
+        // Only compact when the unread bytes are no larger than the space
+        // reclaimed, so each byte is moved a bounded number of times.
+        std::memmove(storage_, storage_ + head_, used);
+        head_ = 0;
+        tail_ = used;
+        return storage_ + tail_;
+    }
+    reallocate(std::max({kDefaultCapacity, capacity_ * 2, used + minWritable}));
+    return storage_ + tail_;
+}
+
+void RecvBuffer::append(const char* data, std::size_t len) {
+    std::memcpy(prepare(len), data, len);
+    commit(len);
+}
+
+void RecvBuffer::consume(std::size_t n) {
+    head_ += std::min(n, size());
+    if (head_ == tail_) {
+        clear();
+    }
+}
+
+void RecvBuffer::clear() {
+    head_ = 0;
+    tail_ = 0;
+    if (capacity_ > kDefaultCapacity) {
+        releaseStorage();
+    }
+}
+
+void RecvBuffer::reallocate(std::size_t capacity) {
+    const std::size_t used = size();
+    char* storage = capacity == kDefaultCapacity ? BufferPool::acquire() : new char[capacity];
+    if (used != 0) {
+        std::memcpy(storage, storage_ + head_, used);
+    }
+    releaseStorage();
+    storage_ = storage;
+    capacity_ = capacity;
+    head_ = 0;
+    tail_ = used;
+}
+
+void RecvBuffer::releaseStorage() noexcept {
+    if (storage_ == nullptr) {
+        return;
+    }
+    if (capacity_ == kDefaultCapacity) {
+        BufferPool::release(storage_);
+    } else {
+        delete[] storage_;
+    }
+    storage_ = nullptr;
+    capacity_ = 0;
+}
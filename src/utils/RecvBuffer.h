@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+
+#include "utils/BufferPool.h"
+
+// Contiguous receive buffer with a moving head: recv() writes straight into
+// the tail, parsed requests are consumed by advancing the head, and the
+// unread bytes are only moved back to the front when the tail runs out of
+// room. Storage is a BufferPool block taken on first use; only requests
+// larger than a block grow onto the heap, and draining such a buffer returns
+// it to a pooled block.
+class RecvBuffer {
+public:
+    static constexpr std::size_t kDefaultCapacity = BufferPool::kBlockSize;
+
+    RecvBuffer() = default;
+    ~RecvBuffer();
+
+    RecvBuffer(const RecvBuffer&) = delete;
+    RecvBuffer& operator=(const RecvBuffer&) = delete;
+
+    const char* data() const { return storage_ + head_; }
+    std::size_t size() const { return tail_ - head_; }
+    bool empty() const { return head_ == tail_; }
+    std::size_t capacity() const { return capacity_; }
+
+    // Returns the tail with at least `minWritable` bytes free, compacting or
+    // growing as needed; writableBytes() then reports the full free space.
+    char* prepare(std::size_t minWritable);
+    std::size_t writableBytes() const { return capacity_ - tail_; }
+    // Marks `n` bytes written at the tail by the last prepare().
+    void commit(std::size_t n) { tail_ += n; }
+
+    void append(const char* data, std::size_t len);
+    void consume(std::size_t n);
+    void clear();
+
+private:
+    void reallocate(std::size_t capacity);
+    void releaseStorage() noexcept;
+
+    char* storage_{nullptr};
+    std::size_t capacity_{0};
+    std::size_t head_{0};
+    std::size_t tail_{0};
+};
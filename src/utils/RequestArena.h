@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory_resource>
+
+#include "utils/BufferPool.h"
+
+// Bump-pointer allocator for one request's parsed headers and response
+// metadata. It starts in a pooled I/O block; only unusually large requests
+// spill onto the heap. reset() frees everything at once, so it must only be
+// called after every object allocated from resource() has been destroyed.
+class RequestArena {
+public:
+    RequestArena()
+        : block_(BufferPool::acquireBlock()),
+          resource_(block_.get(), BufferPool::kBlockSize, std::pmr::new_delete_resource()) {}
+
+    RequestArena(const RequestArena&) = delete;
+    RequestArena& operator=(const RequestArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &resource_; }
+    void reset() { resource_.release(); }
+
+private:
+    BufferPool::Block block_;
+    std::pmr::monotonic_buffer_resource resource_;
+};
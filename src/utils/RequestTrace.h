@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "utils/CycleClock.h"
+
+// Where a request's time went, in CycleClock ticks. Phases a request never
+// entered (e.g. Disk on a cache hit) stay unmarked and are not reported.
+enum class Phase : std::uint8_t { Queue, Parse, Resolve, Cache, Disk, Handler, Serialize, Send };
+
+inline constexpr std::size_t kPhaseCount = 8;
+
+inline constexpr std::string_view kPhaseNames[kPhaseCount] = {"queue",   "parse",   "resolve",   "cache",
+                                                              "disk",    "handler", "serialize", "send"};
+
+struct RequestTrace {
+    static constexpr std::size_t kMaxMethod = 8;
+    static constexpr std::size_t kMaxUri = 96;
+
+    std::uint64_t ticks[kPhaseCount]{};
+    std::uint32_t seen{0};
+
+    // Copied when the response is ready, for the slow-request log.
+    int status{0};
+    std::uint8_t methodLength{0};
+    std::uint8_t uriLength{0};
+    char method[kMaxMethod];
+    char uri[kMaxUri];
+
+    void add(Phase phase, std::uint64_t elapsed) noexcept {
+        const auto index = static_cast<std::size_t>(phase);
+        ticks[index] += elapsed;
+        seen |= 1u << index;
+    }
+    bool has(Phase phase) const noexcept { return (seen & (1u << static_cast<std::size_t>(phase))) != 0; }
+
+    std::uint64_t total() const noexcept {
+        std::uint64_t sum = 0;
+        for (const std::uint64_t phase : ticks) {
+            sum += phase;
+        }
+        return sum;
+    }
+
+    void describe(std::string_view requestMethod, std::string_view requestUri, int statusCode) noexcept {
+        status = statusCode;
+        methodLength = static_cast<std::uint8_t>(std::min(requestMethod.size(), kMaxMethod));
+        uriLength = static_cast<std::uint8_t>(std::min(requestUri.size(), kMaxUri));
+        std::memcpy(method, requestMethod.data(), methodLength);
+        std::memcpy(uri, requestUri.data(), uriLength);
+    }
+};
+
+// Charges the time until it goes out of scope to one phase; a null trace
+// makes it free.
+class PhaseTimer {
+public:
+    PhaseTimer(RequestTrace* trace, Phase phase) noexcept
+        : trace_(trace), phase_(phase), start_(trace != nullptr ? CycleClock::now() : 0) {}
+    ~PhaseTimer() {
+        if (trace_ != nullptr) {
+            trace_->add(phase_, CycleClock::now() - start_);
+        }
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    RequestTrace* trace_;
+    Phase phase_;
+    std::uint64_t start_;
+};
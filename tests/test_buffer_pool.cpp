@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "utils/BufferPool.h"
+
+TEST(BufferPoolTest, ReleasedBlockIsReusedByTheSameThread) {
+    char* block = BufferPool::acquire();
+    ASSERT_NE(block, nullptr);
+    std::memset(block, 0xab, BufferPool::kBlockSize);
+    BufferPool::release(block);
+    EXPECT_EQ(BufferPool::acquire(), block);
+    BufferPool::release(block);
+}
+
+TEST(BufferPoolTest, BlocksAreDistinctAcrossSlabs) {
+    constexpr std::size_t kBlocks = 3 * BufferPool::kSlabSize / BufferPool::kBlockSize;
+    std::vector<char*> blocks;
+    for (std::size_t i = 0; i < kBlocks; ++i) {
+        blocks.push_back(BufferPool::acquire());
+    }
+    EXPECT_EQ(std::set<char*>(blocks.begin(), blocks.end()).size(), kBlocks);
+    EXPECT_GE(BufferPool::slabCount(), 3u);
+    for (char* block : blocks) {
+        BufferPool::release(block);
+    }
+}
+
+TEST(BufferPoolTest, BlocksMayBeReleasedOnAnotherThread) {
+    std::vector<char*> blocks;
+    for (int i = 0; i < 500; ++i) {
+        blocks.push_back(BufferPool::acquire());
+    }
+    const std::size_t slabs = BufferPool::slabCount();
+    std::thread releaser([&blocks]() {
+        for (char* block : blocks) {
+            BufferPool::release(block);
+        }
+    });
+    releaser.join();
+
+    // The releasing thread spilled them to the depot; taking them again
+    // maps nothing new.
+    std::vector<char*> again;
+    for (int i = 0; i < 500; ++i) {
+        again.push_back(BufferPool::acquire());
+    }
+    EXPECT_EQ(BufferPool::slabCount(), slabs);
+    for (char* block : again) {
+        BufferPool::release(block);
+    }
+}
+
+TEST(BufferPoolTest, BlockReleasesOnDestruction) {
+    char* raw = nullptr;
+    {
+        BufferPool::Block block = BufferPool::acquireBlock();
+        raw = block.get();
+    }
+    EXPECT_EQ(BufferPool::acquire(), raw);
+    BufferPool::release(raw);
+}
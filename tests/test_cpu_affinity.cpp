@@ -0,0 +1,33 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "utils/CpuAffinity.h"
+
+TEST(CpuAffinityTest, ParsesSinglesAndRanges) {
+    EXPECT_EQ(affinity::parseCpuList("0-3,8,10-11"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(affinity::parseCpuList("5"), (std::vector<int>{5}));
+    EXPECT_EQ(affinity::parseCpuList("2-2"), (std::vector<int>{2}));
+    EXPECT_TRUE(affinity::parseCpuList("").empty());
+}
+
+TEST(CpuAffinityTest, RejectsMalformedItems) {
+    EXPECT_THROW(affinity::parseCpuList("x"), std::invalid_argument);
+    EXPECT_THROW(affinity::parseCpuList("-1"), std::invalid_argument);
+    EXPECT_THROW(affinity::parseCpuList("1-"), std::invalid_argument);
+    EXPECT_THROW(affinity::parseCpuList("0,,1"), std::invalid_argument);
+}
+
+TEST(CpuAffinityTest, RejectsReversedRanges) {
+    EXPECT_THROW(affinity::parseCpuList("3-1"), std::invalid_argument);
+}
+
+TEST(CpuAffinityTest, RejectsIdsPastTheMaskSize) {
+    const std::string last = std::to_string(affinity::kMaxCpus - 1);
+    EXPECT_EQ(affinity::parseCpuList(last).size(), 1u);
+    EXPECT_THROW(affinity::parseCpuList(std::to_string(affinity::kMaxCpus)), std::invalid_argument);
+    EXPECT_THROW(affinity::parseCpuList("0-100000000"), std::invalid_argument);
+    EXPECT_THROW(affinity::parseCpuList("0-99999999999"), std::invalid_argument);
+}
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "http/Hpack.h"
+
+using http::HeaderField;
+using http::HpackDecoder;
+using http::HpackEncoder;
+
+namespace {
+
+// Hex dump as printed in RFC 7541 Appendix C; spaces are ignored.
+std::string fromHex(const std::string& hex) {
+    std::string bytes;
+    int high = -1;
+    for (const char c : hex) {
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            continue;
+        }
+        const int nibble = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : std::tolower(c) - 'a' + 10;
+        if (high < 0) {
+            high = nibble;
+        } else {
+            bytes.push_back(static_cast<char>((high << 4) | nibble));
+            high = -1;
+        }
+    }
+    return bytes;
+}
+
+std::vector<HeaderField> decode(HpackDecoder& decoder, const std::string& hex) {
+    const std::string block = fromHex(hex);
+    std::vector<HeaderField> fields;
+    EXPECT_TRUE(decoder.decode(reinterpret_cast<const std::uint8_t*>(block.data()), block.size(), fields));
+    return fields;
+}
+
+using Fields = std::vector<std::pair<std::string, std::string>>;
+
+Fields flatten(const std::vector<HeaderField>& fields) {
+    Fields out;
+    for (const HeaderField& field : fields) {
+        out.emplace_back(field.name, field.value);
+    }
+    return out;
+}
+
+const Fields kRequest1 = {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}};
+const Fields kRequest2 = {{":method", "GET"},
+                          {":scheme", "http"},
+                          {":path", "/"},
+                          {":authority", "www.example.com"},
+                          {"cache-control", "no-cache"}};
+const Fields kRequest3 = {{":method", "GET"},
+                          {":scheme", "https"},
+                          {":path", "/index.html"},
+                          {":authority", "www.example.com"},
+                          {"custom-key", "custom-value"}};
+
+const Fields kResponse1 = {{":status", "302"},
+                           {"cache-control", "private"},
+                           {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+                           {"location", "https://www.example.com"}};
+const Fields kResponse2 = {{":status", "307"},
+                           {"cache-control", "private"},
+                           {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
+                           {"location", "https://www.example.com"}};
+const Fields kResponse3 = {{":status", "200"},
+                           {"cache-control", "private"},
+                           {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+                           {"location", "https://www.example.com"},
+                           {"content-encoding", "gzip"},
+                           {"set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"}};
+
+}  // namespace
+
+// C.1
+TEST(HpackTest, IntegerRepresentation) {
+    std::string out;
+    http::hpack::encodeInteger(10, 5, 0, out);
+    EXPECT_EQ(out, fromHex("0a"));
+    out.clear();
+    http::hpack::encodeInteger(1337, 5, 0, out);
+    EXPECT_EQ(out, fromHex("1f9a0a"));
+    out.clear();
+    http::hpack::encodeInteger(42, 8, 0, out);
+    EXPECT_EQ(out, fromHex("2a"));
+
+    const std::string encoded = fromHex("1f9a0a");
+    const auto* pos = reinterpret_cast<const std::uint8_t*>(encoded.data());
+    std::uint64_t value = 0;
+    ASSERT_TRUE(http::hpack::decodeInteger(pos, pos + encoded.size(), 5, value));
+    EXPECT_EQ(value, 1337u);
+
+    const std::string truncated = fromHex("1f9a");
+    pos = reinterpret_cast<const std::uint8_t*>(truncated.data());
+    EXPECT_FALSE(http::hpack::decodeInteger(pos, pos + truncated.size(), 5, value));
+}
+
+// C.2
+TEST(HpackTest, HeaderFieldRepresentations) {
+    HpackDecoder indexed;
+    EXPECT_EQ(flatten(decode(indexed, "400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572")),
+              (Fields{{"custom-key", "custom-header"}}));
+    // The literal went into the dynamic table as index 62.
+    EXPECT_EQ(flatten(decode(indexed, "be")), (Fields{{"custom-key", "custom-header"}}));
+
+    HpackDecoder decoder;
+    EXPECT_EQ(flatten(decode(decoder, "040c 2f73 616d 706c 652f 7061 7468")), (Fields{{":path", "/sample/path"}}));
+    EXPECT_EQ(flatten(decode(decoder, "1008 7061 7373 776f 7264 0673 6563 7265 74")),
+              (Fields{{"password", "secret"}}));
+    EXPECT_EQ(flatten(decode(decoder, "82")), (Fields{{":method", "GET"}}));
+    // Neither literal was indexed, so the dynamic table is still empty.
+    const std::string index62 = fromHex("be");
+    std::vector<HeaderField> fields;
+    EXPECT_FALSE(decoder.decode(reinterpret_cast<const std::uint8_t*>(index62.data()), index62.size(), fields));
+}
+
+// C.3
+TEST(HpackTest, RequestsWithoutHuffman) {
+    HpackDecoder decoder;
+    EXPECT_EQ(flatten(decode(decoder, "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d")), kRequest1);
+    EXPECT_EQ(flatten(decode(decoder, "8286 84be 5808 6e6f 2d63 6163 6865")), kRequest2);
+    EXPECT_EQ(flatten(decode(decoder, "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65")),
+              kRequest3);
+}
+
+// C.4
+TEST(HpackTest, RequestsWithHuffman) {
+    HpackDecoder decoder;
+    EXPECT_EQ(flatten(decode(decoder, "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff")), kRequest1);
+    EXPECT_EQ(flatten(decode(decoder, "8286 84be 5886 a8eb 1064 9cbf")), kRequest2);
+    EXPECT_EQ(flatten(decode(decoder, "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf")), kRequest3);
+}
+
+// C.5: a 256-byte table, so the third response evicts entries.
+TEST(HpackTest, ResponsesWithoutHuffman) {
+    HpackDecoder decoder(256);
+    EXPECT_EQ(flatten(decode(decoder, "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230"
+                                      "3133 2032 303a 3133 3a32 3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65"
+                                      "7861 6d70 6c65 2e63 6f6d")),
+              kResponse1);
+    EXPECT_EQ(flatten(decode(decoder, "4803 3330 37c1 c0bf")), kResponse2);
+    EXPECT_EQ(flatten(decode(decoder, "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220"
+                                      "474d 54c0 5a04 677a 6970 7738 666f 6f3d 4153 444a 4b48 514b 425a 584f 5157"
+                                      "454f 5049 5541 5851 5745 4f49 553b 206d 6178 2d61 6765 3d33 3630 303b 2076"
+                                      "6572 7369 6f6e 3d31")),
+              kResponse3);
+}
+
+// C.6
+TEST(HpackTest, ResponsesWithHuffman) {
+    HpackDecoder decoder(256);
+    EXPECT_EQ(flatten(decode(decoder, "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0"
+                                      "82a6 2d1b ff6e 919d 29ad 1718 63c7 8f0b 97c8 e9ae 82ae 43d3")),
+              kResponse1);
+    EXPECT_EQ(flatten(decode(decoder, "4883 640e ffc1 c0bf")), kResponse2);
+    EXPECT_EQ(flatten(decode(decoder, "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b"
+                                      "d9ab 77ad 94e7 821d d7f2 e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27"
+                                      "0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07")),
+              kResponse3);
+}
+
+TEST(HpackTest, HuffmanMatchesTheRfcAndRejectsBadPadding) {
+    std::string out;
+    http::hpack::huffmanEncode("www.example.com", out);
+    EXPECT_EQ(out, fromHex("f1e3 c2e5 f23a 6ba0 ab90 f4ff"));
+    EXPECT_EQ(http::hpack::huffmanLength("www.example.com"), out.size());
+
+    std::string decoded;
+    ASSERT_TRUE(http::hpack::huffmanDecode(reinterpret_cast<const std::uint8_t*>(out.data()), out.size(), decoded));
+    EXPECT_EQ(decoded, "www.example.com");
+
+    // 'a' is 00011; padding with zeros instead of ones is an error, as is a
+    // whole byte of padding.
+    const std::string zeroPadded = fromHex("18");
+    decoded.clear();
+    EXPECT_FALSE(http::hpack::huffmanDecode(reinterpret_cast<const std::uint8_t*>(zeroPadded.data()),
+                                            zeroPadded.size(), decoded));
+    const std::string longPadding = fromHex("1fff");
+    decoded.clear();
+    EXPECT_FALSE(http::hpack::huffmanDecode(reinterpret_cast<const std::uint8_t*>(longPadding.data()),
+                                            longPadding.size(), decoded));
+}
+
+TEST(HpackTest, RejectsOversizedHeaderLists) {
+    HpackDecoder decoder;
+    const std::string block = fromHex("400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572");
+    std::vector<HeaderField> fields;
+    // custom-key + custom-header + 32 = 55 bytes.
+    EXPECT_FALSE(decoder.decode(reinterpret_cast<const std::uint8_t*>(block.data()), block.size(), fields, 54));
+}
+
+TEST(HpackTest, EncoderOutputDecodesBack) {
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    for (int round = 0; round < 3; ++round) {
+        const Fields fields = {{":status", "200"},
+                               {"content-type", "text/html"},
+                               {"content-length", std::to_string(1000 + round)},
+                               {"x-custom", "value-" + std::to_string(round)}};
+        std::string block;
+        for (const auto& [name, value] : fields) {
+            encoder.encode(name, value, block);
+        }
+        std::vector<HeaderField> decoded;
+        ASSERT_TRUE(decoder.decode(reinterpret_cast<const std::uint8_t*>(block.data()), block.size(), decoded));
+        EXPECT_EQ(flatten(decoded), fields);
+    }
+}
+
+TEST(HpackTest, EncoderAnnouncesATableSizeChange) {
+    HpackEncoder encoder;
+    HpackDecoder decoder(4096);
+    std::string first;
+    encoder.encode("x-first", "one", first);
+    std::vector<HeaderField> decoded;
+    ASSERT_TRUE(decoder.decode(reinterpret_cast<const std::uint8_t*>(first.data()), first.size(), decoded));
+
+    encoder.setMaxTableSize(0);
+    std::string second;
+    encoder.encode("x-first", "one", second);
+    // Dynamic table size update to 0, first in the block.
+    EXPECT_EQ(static_cast<std::uint8_t>(second[0]), 0x20);
+    decoded.clear();
+    ASSERT_TRUE(decoder.decode(reinterpret_cast<const std::uint8_t*>(second.data()), second.size(), decoded));
+    EXPECT_EQ(flatten(decoded), (Fields{{"x-first", "one"}}));
+}
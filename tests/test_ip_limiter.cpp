@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "server/IpLimiter.h"
+
+namespace {
+
+IpAddress v4(std::uint32_t host) {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(host);
+    return IpAddress::fromSockaddr(reinterpret_cast<const sockaddr*>(&addr));
+}
+
+IpLimitConfig connectionsOnly(std::size_t maxConnections) {
+    IpLimitConfig config;
+    config.maxConnections = maxConnections;
+    return config;
+}
+
+}  // namespace
+
+TEST(IpLimiterTest, RefusesPastTheConnectionLimitUntilOneCloses) {
+    IpLimiter limiter(connectionsOnly(2));
+    const IpAddress client = v4(0x0a000001);
+    IpLimiter::Lease first;
+    IpLimiter::Lease second;
+    IpLimiter::Lease third;
+    EXPECT_TRUE(limiter.tryAcquire(client, first));
+    EXPECT_TRUE(limiter.tryAcquire(client, second));
+    EXPECT_FALSE(limiter.tryAcquire(client, third));
+    EXPECT_EQ(limiter.rejectedConnections(), 1u);
+    EXPECT_EQ(limiter.activeConnections(), 2u);
+
+    first.release();
+    EXPECT_TRUE(limiter.tryAcquire(client, third));
+    EXPECT_EQ(limiter.activeConnections(), 2u);
+}
+
+TEST(IpLimiterTest, CountsEachAddressSeparately) {
+    IpLimiter limiter(connectionsOnly(1));
+    IpLimiter::Lease a;
+    IpLimiter::Lease b;
+    IpLimiter::Lease again;
+    EXPECT_TRUE(limiter.tryAcquire(v4(0x0a000001), a));
+    EXPECT_TRUE(limiter.tryAcquire(v4(0x0a000002), b));
+    EXPECT_FALSE(limiter.tryAcquire(v4(0x0a000001), again));
+}
+
+TEST(IpLimiterTest, MovedLeaseReleasesOnce) {
+    IpLimiter limiter(connectionsOnly(1));
+    const IpAddress client = v4(0x0a000001);
+    {
+        IpLimiter::Lease lease;
+        ASSERT_TRUE(limiter.tryAcquire(client, lease));
+        IpLimiter::Lease moved(std::move(lease));
+        IpLimiter::Lease assigned;
+        assigned = std::move(moved);
+        EXPECT_EQ(limiter.activeConnections(), 1u);
+    }
+    EXPECT_EQ(limiter.activeConnections(), 0u);
+}
+
+TEST(IpLimiterTest, EmptyAddressIsAdmittedUntracked) {
+    IpLimiter limiter(connectionsOnly(1));
+    IpLimiter::Lease a;
+    IpLimiter::Lease b;
+    EXPECT_TRUE(limiter.tryAcquire(IpAddress(), a));
+    EXPECT_TRUE(limiter.tryAcquire(IpAddress(), b));
+    EXPECT_EQ(limiter.untrackedConnections(), 2u);
+    EXPECT_EQ(limiter.activeConnections(), 2u);
+    a.release();
+    b.release();
+    EXPECT_EQ(limiter.activeConnections(), 0u);
+}
+
+TEST(IpLimiterTest, FullTableAdmitsUntracked) {
+    IpLimiter limiter(connectionsOnly(1));
+    constexpr std::size_t kClients = IpLimiter::kShards * IpLimiter::kSlotsPerShard + 1000;
+    std::vector<IpLimiter::Lease> leases(kClients);
+    for (std::size_t i = 0; i < kClients; ++i) {
+        ASSERT_TRUE(limiter.tryAcquire(v4(0x0b000000 + static_cast<std::uint32_t>(i)), leases[i]));
+    }
+    EXPECT_GT(limiter.untrackedConnections(), 0u);
+    EXPECT_EQ(limiter.activeConnections(), kClients);
+    leases.clear();
+    EXPECT_EQ(limiter.activeConnections(), 0u);
+}
+
+TEST(IpLimiterTest, RequestRateAllowsTheBurstThenRefuses) {
+    IpLimitConfig config;
+    config.requestsPerSecond = 1;
+    config.requestBurst = 5;
+    IpLimiter limiter(config);
+    IpLimiter::Lease lease;
+    ASSERT_TRUE(limiter.tryAcquire(v4(0x0a000001), lease));
+    for (int i = 0; i < 5; ++i) {
+        EXPECT_TRUE(lease.admitRequest()) << "request " << i;
+    }
+    EXPECT_FALSE(lease.admitRequest());
+    EXPECT_EQ(limiter.throttledRequests(), 1u);
+}
+
+TEST(IpLimiterTest, RequestRateIsSharedAcrossConnections) {
+    IpLimitConfig config;
+    config.requestsPerSecond = 1;
+    config.requestBurst = 2;
+    IpLimiter limiter(config);
+    IpLimiter::Lease a;
+    IpLimiter::Lease b;
+    ASSERT_TRUE(limiter.tryAcquire(v4(0x0a000001), a));
+    ASSERT_TRUE(limiter.tryAcquire(v4(0x0a000001), b));
+    EXPECT_TRUE(a.admitRequest());
+    EXPECT_TRUE(b.admitRequest());
+    EXPECT_FALSE(a.admitRequest());
+}
+
+TEST(IpLimiterTest, BandwidthDelaysOnlyBeyondTheBurst) {
+    IpLimitConfig config;
+    config.bytesPerSecond = 1000;
+    config.bandwidthBurst = 1000;
+    IpLimiter limiter(config);
+    IpLimiter::Lease lease;
+    ASSERT_TRUE(limiter.tryAcquire(v4(0x0a000001), lease));
+    ASSERT_TRUE(lease.limitsBandwidth());
+    EXPECT_EQ(lease.reserveBytes(500).count(), 0);
+    const auto delay = lease.reserveBytes(1500);
+    EXPECT_GT(delay, std::chrono::milliseconds(900));
+    EXPECT_LE(delay, std::chrono::milliseconds(1000));
+}
+
+TEST(IpLimiterTest, UnlimitedLeaseNeverDelays) {
+    IpLimiter limiter(connectionsOnly(10));
+    IpLimiter::Lease lease;
+    ASSERT_TRUE(limiter.tryAcquire(v4(0x0a000001), lease));
+    EXPECT_FALSE(lease.limitsBandwidth());
+    EXPECT_EQ(lease.reserveBytes(1 << 30).count(), 0);
+    EXPECT_TRUE(lease.admitRequest());
+}
+
+// Threads race to connect from the same address; the limit must hold at
+// every moment and every lease must be returned.
+TEST(IpLimiterTest, ConcurrentAcquireNeverExceedsTheLimit) {
+    constexpr std::size_t kLimit = 4;
+    constexpr int kThreads = 8;
+    constexpr int kRounds = 20000;
+    IpLimiter limiter(connectionsOnly(kLimit));
+    const IpAddress client = v4(0x0a000001);
+    std::atomic<std::size_t> holding{0};
+    std::atomic<std::size_t> peak{0};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < kRounds; ++i) {
+                IpLimiter::Lease lease;
+                if (!limiter.tryAcquire(client, lease)) {
+                    continue;
+                }
+                const std::size_t now = holding.fetch_add(1) + 1;
+                std::size_t seen = peak.load();
+                while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+                }
+                holding.fetch_sub(1);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    EXPECT_LE(peak.load(), kLimit);
+    EXPECT_EQ(limiter.activeConnections(), 0u);
+    EXPECT_EQ(limiter.untrackedConnections(), 0u);
+}
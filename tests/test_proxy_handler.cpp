@@ -0,0 +1,253 @@
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "handlers/ProxyHandler.h"
+#include "utils/Metrics.h"
+
+namespace {
+
+// HTTP/1.1 backend on a loopback port, one connection at a time. Each
+// request head it reads is recorded and answered with the next scripted
+// reply; an empty reply leaves the request unanswered.
+class StubBackend {
+public:
+    explicit StubBackend(std::vector<std::string> replies) : replies_(std::move(replies)) {
+        listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(addr);
+        if (::bind(listenFd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listenFd_, 16) != 0 ||
+            ::getsockname(listenFd_, reinterpret_cast<sockaddr*>(&addr), &length) != 0) {
+            ADD_FAILURE() << "stub backend could not listen";
+        }
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    ~StubBackend() {
+        stopping_.store(true);
+        thread_.join();
+        ::close(listenFd_);
+    }
+
+    std::string address() const { return "127.0.0.1:" + std::to_string(port_); }
+
+    std::vector<std::string> requests() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return requests_;
+    }
+
+    int connections() const { return connections_.load(); }
+
+private:
+    bool waitReadable(int fd) {
+        pollfd entry{fd, POLLIN, 0};
+        while (!stopping_.load()) {
+            if (::poll(&entry, 1, 20) > 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run() {
+        while (waitReadable(listenFd_)) {
+            const int fd = ::accept(listenFd_, nullptr, nullptr);
+            if (fd < 0) {
+                continue;
+            }
+            ++connections_;
+            serve(fd);
+            ::close(fd);
+        }
+    }
+
+    void serve(int fd) {
+        std::string buffer;
+        while (true) {
+            std::size_t headEnd;
+            while ((headEnd = buffer.find("\r\n\r\n")) == std::string::npos) {
+                char chunk[4096];
+                const ssize_t bytes = waitReadable(fd) ? ::recv(fd, chunk, sizeof(chunk), 0) : 0;
+                if (bytes <= 0) {
+                    return;
+                }
+                buffer.append(chunk, static_cast<std::size_t>(bytes));
+            }
+            std::string reply;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                requests_.push_back(buffer.substr(0, headEnd + 4));
+                if (next_ < replies_.size()) {
+                    reply = replies_[next_++];
+                }
+            }
+            buffer.erase(0, headEnd + 4);
+            if (!reply.empty()) {
+                (void)::send(fd, reply.data(), reply.size(), MSG_NOSIGNAL);
+            }
+        }
+    }
+
+    std::vector<std::string> replies_;
+    std::size_t next_{0};
+    int listenFd_{-1};
+    int port_{0};
+    std::atomic<bool> stopping_{false};
+    std::atomic<int> connections_{0};
+    std::mutex mutex_;
+    std::vector<std::string> requests_;
+    std::thread thread_;
+};
+
+ProxyConfig configFor(const StubBackend& backend) {
+    ProxyConfig config;
+    config.prefix = "/api";
+    config.upstreams = {backend.address()};
+    config.timeout = std::chrono::seconds(1);
+    config.healthInterval = std::chrono::milliseconds(0);
+    return config;
+}
+
+http::HttpRequest get(const std::string& uri) {
+    http::HttpRequest request;
+    request.method = "GET";
+    request.uri = uri;
+    request.version = "HTTP/1.1";
+    return request;
+}
+
+std::string_view body(const http::HttpResponse& response) {
+    return response.bodyView.empty() ? std::string_view(response.body) : response.bodyView;
+}
+
+}  // namespace
+
+TEST(ProxyHandlerTest, RelaysTheResponseAndDropsHopByHopHeaders) {
+    StubBackend backend({"HTTP/1.1 200 OK\r\nContent-Length: 5\r\nConnection: keep-alive\r\n"
+                         "X-Upstream: stub\r\n\r\nhello"});
+    ProxyHandler proxy(configFor(backend));
+    http::HttpRequest request = get("/api/items?id=1");
+    request.headers.emplace("host", "example.test");
+    request.headers.emplace("connection", "keep-alive");
+
+    const http::HttpResponse response = proxy.handle(request);
+    EXPECT_EQ(response.statusCode, 200);
+    EXPECT_EQ(body(response), "hello");
+    EXPECT_EQ(response.headers.count("X-Upstream"), 1u);
+    EXPECT_EQ(response.headers.count("Connection"), 0u);
+
+    const std::vector<std::string> seen = backend.requests();
+    ASSERT_EQ(seen.size(), 1u);
+    EXPECT_EQ(seen[0].rfind("GET /api/items?id=1 HTTP/1.1\r\n", 0), 0u);
+    EXPECT_NE(seen[0].find("host: example.test\r\n"), std::string::npos);
+    EXPECT_EQ(seen[0].find("connection:"), std::string::npos);
+}
+
+TEST(ProxyHandlerTest, RequestWithoutHostNamesTheChosenUpstream) {
+    StubBackend backend({"HTTP/1.1 204 No Content\r\n\r\n"});
+    ProxyHandler proxy(configFor(backend));
+    EXPECT_EQ(proxy.handle(get("/api")).statusCode, 204);
+    const std::vector<std::string> seen = backend.requests();
+    ASSERT_EQ(seen.size(), 1u);
+    EXPECT_NE(seen[0].find("host: " + backend.address() + "\r\n"), std::string::npos);
+}
+
+TEST(ProxyHandlerTest, KeepsEachSetCookieOnItsOwnLine) {
+    StubBackend backend({"HTTP/1.1 200 OK\r\nSet-Cookie: a=1; Expires=Wed, 21 Oct 2026 07:28:00 GMT\r\n"
+                         "Set-Cookie: b=2\r\nVary: Accept\r\nVary: Origin\r\nContent-Length: 0\r\n\r\n"});
+    ProxyHandler proxy(configFor(backend));
+    const http::HttpResponse response = proxy.handle(get("/api"));
+    ASSERT_EQ(response.repeatedHeaders.size(), 2u);
+    EXPECT_EQ(response.repeatedHeaders[0].second, "a=1; Expires=Wed, 21 Oct 2026 07:28:00 GMT");
+    EXPECT_EQ(response.repeatedHeaders[1].second, "b=2");
+    // Other repeated fields are still joined.
+    ASSERT_EQ(response.headers.count("Vary"), 1u);
+    EXPECT_EQ(response.headers.find("Vary")->second, "Accept, Origin");
+
+    const std::string wire = response.serialize();
+    EXPECT_NE(wire.find("Set-Cookie: a=1; Expires=Wed, 21 Oct 2026 07:28:00 GMT\r\n"), std::string::npos);
+    EXPECT_NE(wire.find("Set-Cookie: b=2\r\n"), std::string::npos);
+}
+
+TEST(ProxyHandlerTest, DechunksTheBodyAndDropsTrailers) {
+    StubBackend backend({"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                         "5;ext=1\r\nhello\r\n6\r\n world\r\n0\r\nX-Trailer: 1\r\n\r\n"});
+    ProxyHandler proxy(configFor(backend));
+    const http::HttpResponse response = proxy.handle(get("/api"));
+    EXPECT_EQ(response.statusCode, 200);
+    EXPECT_EQ(body(response), "hello world");
+    EXPECT_EQ(response.headers.count("X-Trailer"), 0u);
+}
+
+TEST(ProxyHandlerTest, ReusesThePooledConnection) {
+    const std::string reply = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+    StubBackend backend({reply, reply, reply});
+    ProxyHandler proxy(configFor(backend));
+    for (int i = 0; i < 3; ++i) {
+        EXPECT_EQ(proxy.handle(get("/api")).statusCode, 200);
+    }
+    EXPECT_EQ(backend.requests().size(), 3u);
+    EXPECT_EQ(backend.connections(), 1);
+}
+
+TEST(ProxyHandlerTest, RefusesBodiesOverTheLimit) {
+    StubBackend backend({"HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n" + std::string(100, 'x'),
+                         "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n64\r\n" + std::string(100, 'y') +
+                             "\r\n0\r\n\r\n"});
+    ProxyConfig config = configFor(backend);
+    config.maxResponseBody = 64;
+    ProxyHandler proxy(config);
+    EXPECT_EQ(proxy.handle(get("/api/declared")).statusCode, 502);
+    EXPECT_EQ(proxy.handle(get("/api/chunked")).statusCode, 502);
+}
+
+TEST(ProxyHandlerTest, TimeoutAnswers504AndKeepsTheUpstreamHealthy) {
+    StubBackend backend({"", "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok"});
+    ProxyHandler proxy(configFor(backend));
+    Metrics metrics;
+    ProxyHandler::registerMetrics(metrics, {&proxy});
+
+    EXPECT_EQ(proxy.handle(get("/api/slow")).statusCode, 504);
+    const std::string healthy = "proxy_upstream_healthy{route=\"/api\",upstream=\"" + backend.address() + "\"} 1";
+    EXPECT_NE(metrics.render().find(healthy), std::string::npos);
+    EXPECT_EQ(proxy.handle(get("/api/next")).statusCode, 200);
+}
+
+TEST(ProxyHandlerTest, UnreachableUpstreamAnswers502) {
+    ProxyConfig config;
+    config.prefix = "/api";
+    // Port 1 on loopback refuses connections.
+    config.upstreams = {"127.0.0.1:1"};
+    config.timeout = std::chrono::seconds(1);
+    config.healthInterval = std::chrono::milliseconds(0);
+    ProxyHandler proxy(config);
+    EXPECT_EQ(proxy.handle(get("/api")).statusCode, 502);
+}
+
+TEST(ProxyHandlerTest, RejectsMalformedUpstreamAddresses) {
+    ProxyConfig config;
+    config.prefix = "/api";
+    config.upstreams = {"localhost"};
+    EXPECT_THROW(ProxyHandler{config}, std::invalid_argument);
+    config.upstreams = {"localhost:99999"};
+    EXPECT_THROW(ProxyHandler{config}, std::invalid_argument);
+}
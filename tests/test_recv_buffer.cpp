@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "utils/RecvBuffer.h"
+
+namespace {
+
+std::string_view contents(const RecvBuffer& buffer) {
+    return std::string_view(buffer.data(), buffer.size());
+}
+
+}  // namespace
+
+TEST(RecvBufferTest, StartsEmptyWithoutStorage) {
+    RecvBuffer buffer;
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.size(), 0u);
+    EXPECT_EQ(buffer.capacity(), 0u);
+}
+
+TEST(RecvBufferTest, PrepareAndCommitWriteAtTheTail) {
+    RecvBuffer buffer;
+    char* tail = buffer.prepare(5);
+    EXPECT_EQ(buffer.capacity(), RecvBuffer::kDefaultCapacity);
+    EXPECT_GE(buffer.writableBytes(), 5u);
+    std::memcpy(tail, "hello", 5);
+    buffer.commit(5);
+    buffer.append(" world", 6);
+    EXPECT_EQ(contents(buffer), "hello world");
+}
+
+TEST(RecvBufferTest, ConsumeAdvancesTheHead) {
+    RecvBuffer buffer;
+    const std::string_view input = "GET / HTTP/1.1\r\n\r\nGET /b";
+    buffer.append(input.data(), input.size());
+    buffer.consume(18);
+    EXPECT_EQ(contents(buffer), "GET /b");
+    buffer.consume(100);
+    EXPECT_TRUE(buffer.empty());
+}
+
+TEST(RecvBufferTest, CompactsInsteadOfGrowingWhenTheHeadHasRoom) {
+    RecvBuffer buffer;
+    const std::string filler(RecvBuffer::kDefaultCapacity - 4, 'x');
+    buffer.append(filler.data(), filler.size());
+    buffer.append("tail", 4);
+    buffer.consume(filler.size());
+    ASSERT_EQ(buffer.writableBytes(), 0u);
+
+    // Four unread bytes, a block's worth reclaimed at the front.
+    buffer.prepare(100);
+    EXPECT_EQ(buffer.capacity(), RecvBuffer::kDefaultCapacity);
+    EXPECT_EQ(contents(buffer), "tail");
+    EXPECT_GE(buffer.writableBytes(), 100u);
+}
+
+TEST(RecvBufferTest, GrowsPastABlockKeepingUnreadBytes) {
+    RecvBuffer buffer;
+    const std::string large(RecvBuffer::kDefaultCapacity * 3 + 7, 'r');
+    buffer.append("head", 4);
+    buffer.append(large.data(), large.size());
+    EXPECT_GT(buffer.capacity(), RecvBuffer::kDefaultCapacity);
+    ASSERT_EQ(buffer.size(), large.size() + 4);
+    EXPECT_EQ(contents(buffer).substr(0, 4), "head");
+    EXPECT_EQ(contents(buffer).substr(4), large);
+}
+
+TEST(RecvBufferTest, DrainingAGrownBufferDropsTheHeapStorage) {
+    RecvBuffer buffer;
+    const std::string large(RecvBuffer::kDefaultCapacity * 2, 'g');
+    buffer.append(large.data(), large.size());
+    ASSERT_GT(buffer.capacity(), RecvBuffer::kDefaultCapacity);
+
+    buffer.consume(large.size());
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.capacity(), 0u);
+
+    // The next request goes back to a pooled block.
+    buffer.append("next", 4);
+    EXPECT_EQ(buffer.capacity(), RecvBuffer::kDefaultCapacity);
+    EXPECT_EQ(contents(buffer), "next");
+}
+
+TEST(RecvBufferTest, ClearKeepsAPooledBlock) {
+    RecvBuffer buffer;
+    buffer.append("abc", 3);
+    buffer.clear();
+    EXPECT_TRUE(buffer.empty());
+    EXPECT_EQ(buffer.capacity(), RecvBuffer::kDefaultCapacity);
+    EXPECT_EQ(buffer.writableBytes(), RecvBuffer::kDefaultCapacity);
+}
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string_view>
+
+#include "server/Router.h"
+
+namespace {
+
+class StubHandler : public RequestHandler {
+public:
+    http::HttpResponse handle(const http::HttpRequest&) override { return http::HttpResponse(); }
+};
+
+RequestHandler* handlerFor(const Router& router, std::string_view method, std::string_view path) {
+    http::RouteParams params;
+    return router.match(method, path, params).handler;
+}
+
+}  // namespace
+
+TEST(RouterTest, EmptyRouterMatchesNothing) {
+    Router router;
+    EXPECT_TRUE(router.empty());
+    http::RouteParams params;
+    const Router::Match result = router.match("GET", "/", params);
+    EXPECT_EQ(result.handler, nullptr);
+    EXPECT_FALSE(result.methodNotAllowed);
+}
+
+TEST(RouterTest, LiteralBeatsParameterBeatsRest) {
+    Router router;
+    StubHandler me;
+    StubHandler byId;
+    StubHandler rest;
+    router.add("GET", "/users/me", me);
+    router.add("GET", "/users/:id", byId);
+    router.add("GET", "/users/*path", rest);
+
+    http::RouteParams params;
+    EXPECT_EQ(router.match("GET", "/users/me", params).handler, &me);
+    EXPECT_EQ(params.size, 0u);
+
+    EXPECT_EQ(router.match("GET", "/users/42", params).handler, &byId);
+    EXPECT_EQ(params.get("id"), "42");
+
+    EXPECT_EQ(router.match("GET", "/users/42/posts", params).handler, &rest);
+    EXPECT_EQ(params.get("path"), "42/posts");
+    EXPECT_EQ(params.get("id"), "");
+}
+
+TEST(RouterTest, BacktracksWhenTheLiteralBranchFails) {
+    Router router;
+    StubHandler literal;
+    StubHandler param;
+    router.add("GET", "/a/b/c", literal);
+    router.add("GET", "/a/:x/d", param);
+
+    http::RouteParams params;
+    EXPECT_EQ(router.match("GET", "/a/b/c", params).handler, &literal);
+    EXPECT_EQ(router.match("GET", "/a/b/d", params).handler, &param);
+    EXPECT_EQ(params.get("x"), "b");
+    EXPECT_EQ(handlerFor(router, "GET", "/a/b/e"), nullptr);
+}
+
+TEST(RouterTest, SharedPrefixesSplitIntoSeparateRoutes) {
+    Router router;
+    StubHandler users;
+    StubHandler usage;
+    StubHandler root;
+    router.add("GET", "/users", users);
+    router.add("GET", "/usage", usage);
+    router.add("GET", "/", root);
+
+    EXPECT_EQ(handlerFor(router, "GET", "/users"), &users);
+    EXPECT_EQ(handlerFor(router, "GET", "/usage"), &usage);
+    EXPECT_EQ(handlerFor(router, "GET", "/"), &root);
+    EXPECT_EQ(handlerFor(router, "GET", "/us"), nullptr);
+    EXPECT_EQ(handlerFor(router, "GET", "/users/1"), nullptr);
+}
+
+TEST(RouterTest, PrefixRestAlsoMatchesThePrefixButNotLongerSegments) {
+    Router router;
+    StubHandler api;
+    router.add("", "/api/*", api);
+
+    EXPECT_EQ(handlerFor(router, "GET", "/api"), &api);
+    EXPECT_EQ(handlerFor(router, "GET", "/api/"), &api);
+    EXPECT_EQ(handlerFor(router, "POST", "/api/v1/items"), &api);
+    EXPECT_EQ(handlerFor(router, "GET", "/apiary"), nullptr);
+}
+
+TEST(RouterTest, ExplicitRouteBeatsTheImpliedPrefixRoute) {
+    Router router;
+    StubHandler mount;
+    StubHandler exact;
+    router.add("GET", "/api/*", mount);
+    router.add("GET", "/api", exact);
+
+    EXPECT_EQ(handlerFor(router, "GET", "/api"), &exact);
+    EXPECT_EQ(handlerFor(router, "GET", "/api/x"), &mount);
+}
+
+TEST(RouterTest, MostSpecificPatternDecidesMethodNotAllowed) {
+    Router router;
+    StubHandler item;
+    StubHandler fallback;
+    router.add("GET", "/items/:id", item);
+    router.add("", "/*", fallback);
+
+    http::RouteParams params;
+    EXPECT_EQ(router.match("GET", "/items/7", params).handler, &item);
+
+    const Router::Match deleted = router.match("DELETE", "/items/7", params);
+    EXPECT_EQ(deleted.handler, nullptr);
+    EXPECT_TRUE(deleted.methodNotAllowed);
+
+    EXPECT_EQ(router.match("DELETE", "/other", params).handler, &fallback);
+}
+
+TEST(RouterTest, EmptyMethodMatchesAnyAndPerMethodRoutesCoexist) {
+    Router router;
+    StubHandler get;
+    StubHandler head;
+    router.add("GET", "/health", get);
+    router.add("HEAD", "/health", head);
+
+    EXPECT_EQ(handlerFor(router, "GET", "/health"), &get);
+    EXPECT_EQ(handlerFor(router, "HEAD", "/health"), &head);
+    http::RouteParams params;
+    EXPECT_TRUE(router.match("POST", "/health", params).methodNotAllowed);
+}
+
+TEST(RouterTest, CapturesAreViewsIntoThePath) {
+    Router router;
+    StubHandler handler;
+    router.add("GET", "/files/:dir/*name", handler);
+
+    const std::string_view path = "/files/docs/a/b.txt";
+    http::RouteParams params;
+    ASSERT_EQ(router.match("GET", path, params).handler, &handler);
+    ASSERT_EQ(params.size, 2u);
+    EXPECT_EQ(params.get("dir"), "docs");
+    EXPECT_EQ(params.get("name"), "a/b.txt");
+    EXPECT_EQ(params.get("name").data(), path.data() + 12);
+}
+
+TEST(RouterTest, EmptyParameterSegmentDoesNotMatch) {
+    Router router;
+    StubHandler handler;
+    router.add("GET", "/users/:id", handler);
+    EXPECT_EQ(handlerFor(router, "GET", "/users/"), nullptr);
+}
+
+TEST(RouterTest, DuplicateRouteIsRefused) {
+    Router router;
+    StubHandler first;
+    StubHandler second;
+    EXPECT_TRUE(router.add("GET", "/a", first));
+    EXPECT_FALSE(router.add("GET", "/a", second));
+    EXPECT_TRUE(router.add("POST", "/a", second));
+    EXPECT_EQ(handlerFor(router, "GET", "/a"), &first);
+}
+
+TEST(RouterTest, RejectsMalformedPatternsAndKeepsExistingRoutes) {
+    Router router;
+    StubHandler handler;
+    router.add("GET", "/users/:id", handler);
+
+    EXPECT_THROW(router.add("GET", "no-slash", handler), std::invalid_argument);
+    EXPECT_THROW(router.add("GET", "/a:b", handler), std::invalid_argument);
+    EXPECT_THROW(router.add("GET", "/a/:", handler), std::invalid_argument);
+    EXPECT_THROW(router.add("GET", "/a/*rest/more", handler), std::invalid_argument);
+    EXPECT_THROW(router.add("GET", "/users/:name/posts", handler), std::invalid_argument);
+    EXPECT_THROW(router.add("GET", "/:a/:b/:c/:d/:e", handler), std::invalid_argument);
+
+    http::RouteParams params;
+    EXPECT_EQ(router.match("GET", "/users/5", params).handler, &handler);
+    EXPECT_EQ(params.get("id"), "5");
+}
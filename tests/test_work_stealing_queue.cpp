@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "threadpool/WorkStealingQueue.h"
+
+using threadpool::Task;
+using threadpool::WorkStealingQueue;
+
+namespace {
+
+// Runs whatever the queue handed back; the tasks record their number in `last`.
+int runAndRead(std::optional<Task> task, const int& last) {
+    if (!task) {
+        return -1;
+    }
+    (*task)();
+    return last;
+}
+
+}  // namespace
+
+TEST(WorkStealingQueueTest, OwnerPopsNewestThiefStealsOldest) {
+    WorkStealingQueue queue(4);
+    int last = 0;
+    for (int i = 1; i <= 3; ++i) {
+        queue.push([&last, i]() { last = i; });
+    }
+    EXPECT_EQ(queue.size(), 3u);
+
+    EXPECT_EQ(runAndRead(queue.pop(), last), 3);
+    EXPECT_EQ(runAndRead(queue.steal(), last), 1);
+    EXPECT_EQ(runAndRead(queue.pop(), last), 2);
+    EXPECT_FALSE(queue.pop().has_value());
+    EXPECT_FALSE(queue.steal().has_value());
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+TEST(WorkStealingQueueTest, GrowsPastInitialCapacityInOrder) {
+    WorkStealingQueue queue(2);
+    std::vector<int> seen;
+    for (int i = 0; i < 1000; ++i) {
+        queue.push([&seen, i]() { seen.push_back(i); });
+    }
+    EXPECT_EQ(queue.size(), 1000u);
+    while (auto task = queue.steal()) {
+        (*task)();
+    }
+    ASSERT_EQ(seen.size(), 1000u);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(seen[static_cast<std::size_t>(i)], i);
+    }
+}
+
+TEST(WorkStealingQueueTest, DestroysTasksLeftInQueue) {
+    auto token = std::make_shared<int>(0);
+    {
+        WorkStealingQueue queue(2);
+        for (int i = 0; i < 10; ++i) {
+            queue.push([token]() {});
+        }
+        (void)queue.pop();
+        (void)queue.steal();
+    }
+    EXPECT_EQ(token.use_count(), 1);
+}
+
+// The owner pushes in bursts (forcing growth and node recycling) and pops
+// between them while thieves steal continuously. Every task must run exactly
+// once: a lost task leaves a zero, a task handed to both owner and thief a two.
+TEST(WorkStealingQueueTest, StressEveryTaskRunsExactlyOnce) {
+    constexpr std::size_t kTasks = 200000;
+    constexpr std::size_t kBurst = 64;
+    constexpr int kThieves = 3;
+
+    WorkStealingQueue queue(8);
+    std::vector<std::atomic<int>> runs(kTasks);
+    std::atomic<std::size_t> executed{0};
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < kThieves; ++t) {
+        thieves.emplace_back([&]() {
+            while (!done.load(std::memory_order_acquire)) {
+                if (auto task = queue.steal()) {
+                    (*task)();
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::size_t next = 0;
+    while (next < kTasks) {
+        const std::size_t end = std::min(next + kBurst, kTasks);
+        for (; next < end; ++next) {
+            queue.push([&runs, &executed, next]() {
+                runs[next].fetch_add(1, std::memory_order_relaxed);
+                executed.fetch_add(1, std::memory_order_relaxed);
+            });
+        }
+        for (std::size_t i = 0; i < kBurst / 2; ++i) {
+            if (auto task = queue.pop()) {
+                (*task)();
+            }
+        }
+    }
+    while (auto task = queue.pop()) {
+        (*task)();
+    }
+    // Bounded, so a lost task fails the checks below instead of hanging.
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    while (executed.load(std::memory_order_acquire) < kTasks && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread& thief : thieves) {
+        thief.join();
+    }
+
+    EXPECT_EQ(executed.load(), kTasks);
+    for (std::size_t i = 0; i < kTasks; ++i) {
+        ASSERT_EQ(runs[i].load(), 1) << "task " << i;
+    }
+}
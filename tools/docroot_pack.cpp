@@ -0,0 +1,315 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#if defined(HTTP_SERVER_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#include "http/HttpConstants.h"
+#include "utils/DocrootArchive.h"
+
+namespace {
+
+struct PackedFile {
+    std::string content;
+    std::string gzipContent;
+    std::string mimeType;
+    std::string etag;
+};
+
+struct IndexKey {
+    std::string path;
+    std::size_t fileIndex;
+    std::uint64_t hash;
+};
+
+std::string detectMimeType(const std::filesystem::path& path) {
+    const auto it = http::MIME_TYPES.find(path.extension().string());
+    if (it != http::MIME_TYPES.end()) {
+        return it->second;
+    }
+    return "application/octet-stream";
+}
+
+bool isCompressible(const std::string& mimeType) {
+    return mimeType.rfind("text/", 0) == 0 || mimeType == "application/javascript" ||
+           mimeType == "application/json" || mimeType == "image/svg+xml";
+}
+
+std::string gzipCompress(const std::string& input) {
+#if defined(HTTP_SERVER_HAVE_ZLIB)
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return {};
+    }
+    std::string output(deflateBound(&stream, static_cast<uLong>(input.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream.avail_in = static_cast<uInt>(input.size());
+    stream.next_out = reinterpret_cast<Bytef*>(output.data());
+    stream.avail_out = static_cast<uInt>(output.size());
+    const int rc = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return rc == Z_STREAM_END ? output : std::string();
+#else
+    (void)input;
+    return {};
+#endif
+}
+
+std::string makeEtag(const std::string& content) {
+    char buffer[40];
+    std::snprintf(buffer, sizeof(buffer), "\"%016llx-%zx\"",
+                  static_cast<unsigned long long>(archive::hashPath(content)), content.size());
+    return buffer;
+}
+
+std::string readFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open " + path.string());
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return buffer.str();
+}
+
+// Hash-and-displace: place the largest buckets first, searching for a seed
+// that sends every key of the bucket to a distinct free slot.
+bool buildIndex(const std::vector<IndexKey>& keys, std::uint32_t bucketCount, std::uint32_t slotCount,
+                std::vector<std::uint32_t>& seeds, std::vector<std::uint32_t>& slots) {
+    std::vector<std::vector<std::size_t>> buckets(bucketCount);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        buckets[archive::bucketFor(keys[i].hash, bucketCount)].push_back(i);
+    }
+
+    std::vector<std::uint32_t> order(bucketCount);
+    for (std::uint32_t i = 0; i < bucketCount; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    seeds.assign(bucketCount, 0);
+    slots.assign(slotCount, archive::kEmptySlot);
+    constexpr std::uint32_t kMaxSeed = 1u << 20;
+    std::vector<std::uint32_t> candidate;
+
+    for (const std::uint32_t bucket : order) {
+        if (buckets[bucket].empty()) {
+            break;
+        }
+        bool placed = false;
+        for (std::uint32_t seed = 0; seed < kMaxSeed && !placed; ++seed) {
+            candidate.clear();
+            placed = true;
+            for (const std::size_t key : buckets[bucket]) {
+                const std::uint32_t slot = archive::slotFor(keys[key].hash, seed, slotCount);
+                if (slots[slot] != archive::kEmptySlot ||
+                    std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                    placed = false;
+                    break;
+                }
+                candidate.push_back(slot);
+            }
+            if (placed) {
+                seeds[bucket] = seed;
+                for (std::size_t i = 0; i < candidate.size(); ++i) {
+                    slots[candidate[i]] = static_cast<std::uint32_t>(buckets[bucket][i]);
+                }
+            }
+        }
+        if (!placed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::uint64_t alignUp(std::uint64_t value, std::uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [--no-gzip] <docroot> <output-archive>\n";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    bool useGzip = true;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--no-gzip") {
+            useGzip = false;
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    const std::filesystem::path docRoot = positional[0];
+    const std::filesystem::path outputPath = positional[1];
+
+    try {
+        std::vector<std::filesystem::path> paths;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(docRoot)) {
+            if (entry.is_regular_file()) {
+                paths.push_back(entry.path());
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+
+        std::vector<PackedFile> files;
+        std::vector<IndexKey> keys;
+        files.reserve(paths.size());
+        for (const auto& path : paths) {
+            PackedFile file;
+            file.content = readFile(path);
+            file.mimeType = detectMimeType(path);
+            file.etag = makeEtag(file.content);
+            if (useGzip && isCompressible(file.mimeType)) {
+                std::string compressed = gzipCompress(file.content);
+                if (!compressed.empty() && compressed.size() < file.content.size() * 9 / 10) {
+                    file.gzipContent = std::move(compressed);
+                }
+            }
+
+            const std::size_t fileIndex = files.size();
+            const std::string rel = std::filesystem::relative(path, docRoot).generic_string();
+            keys.push_back({rel, fileIndex, archive::hashPath(rel)});
+
+            // Directory aliases mirror FileHandler's index.html fallback.
+            if (path.filename() == "index.html") {
+                const std::string dir = std::filesystem::path(rel).parent_path().generic_string();
+                keys.push_back({dir, fileIndex, archive::hashPath(dir)});
+                if (!dir.empty()) {
+                    keys.push_back({dir + "/", fileIndex, archive::hashPath(dir + "/")});
+                }
+            }
+            files.push_back(std::move(file));
+        }
+
+        const auto entryCount = static_cast<std::uint32_t>(keys.size());
+        const std::uint32_t bucketCount = std::max<std::uint32_t>(1, entryCount / 4);
+        const std::uint32_t slotCount = std::max<std::uint32_t>(1, entryCount + entryCount / 4);
+        std::vector<std::uint32_t> seeds;
+        std::vector<std::uint32_t> slots;
+        if (!buildIndex(keys, bucketCount, slotCount, seeds, slots)) {
+            throw std::runtime_error("Could not build path index (hash collision)");
+        }
+
+        std::string strings;
+        auto addString = [&strings](const std::string& value, std::uint32_t& offset, std::uint32_t& length) {
+            offset = static_cast<std::uint32_t>(strings.size());
+            length = static_cast<std::uint32_t>(value.size());
+            strings += value;
+        };
+
+        archive::ArchiveHeader header{};
+        std::memcpy(header.magic, archive::kMagic, sizeof(header.magic));
+        header.version = archive::kVersion;
+        header.entryCount = entryCount;
+        header.bucketCount = bucketCount;
+        header.slotCount = slotCount;
+        header.seedsOffset = sizeof(header);
+        header.slotsOffset = header.seedsOffset + seeds.size() * sizeof(std::uint32_t);
+        header.entriesOffset = alignUp(header.slotsOffset + slots.size() * sizeof(std::uint32_t), 8);
+
+        std::vector<archive::ArchiveEntry> entries(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            entries[i].pathHash = keys[i].hash;
+            addString(keys[i].path, entries[i].pathOffset, entries[i].pathLength);
+            addString(files[keys[i].fileIndex].mimeType, entries[i].mimeOffset, entries[i].mimeLength);
+            addString(files[keys[i].fileIndex].etag, entries[i].etagOffset, entries[i].etagLength);
+        }
+        header.stringsOffset = header.entriesOffset + entries.size() * sizeof(archive::ArchiveEntry);
+        header.stringsSize = strings.size();
+
+        std::uint64_t cursor = header.stringsOffset + strings.size();
+        std::vector<std::uint64_t> dataOffsets(files.size());
+        std::vector<std::uint64_t> gzipOffsets(files.size());
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            cursor = alignUp(cursor, archive::kBlobAlignment);
+            dataOffsets[i] = cursor;
+            cursor += files[i].content.size();
+            if (!files[i].gzipContent.empty()) {
+                cursor = alignUp(cursor, archive::kBlobAlignment);
+                gzipOffsets[i] = cursor;
+                cursor += files[i].gzipContent.size();
+            }
+        }
+        header.fileSize = cursor;
+
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            const std::size_t f = keys[i].fileIndex;
+            entries[i].dataOffset = dataOffsets[f];
+            entries[i].dataLength = files[f].content.size();
+            entries[i].gzipOffset = gzipOffsets[f];
+            entries[i].gzipLength = files[f].gzipContent.size();
+        }
+
+        // Write next to the destination and rename so a running server only
+        // ever sees a complete archive.
+        const std::filesystem::path tmpPath =
+            outputPath.string() + ".tmp." + std::to_string(static_cast<long>(::getpid()));
+        {
+            std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+            if (!out.is_open()) {
+                throw std::runtime_error("Could not create " + tmpPath.string());
+            }
+            auto padTo = [&out](std::uint64_t offset) {
+                const auto pos = static_cast<std::uint64_t>(out.tellp());
+                if (offset > pos) {
+                    out << std::string(static_cast<std::size_t>(offset - pos), '\0');
+                }
+            };
+
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(seeds.data()),
+                      static_cast<std::streamsize>(seeds.size() * sizeof(std::uint32_t)));
+            out.write(reinterpret_cast<const char*>(slots.data()),
+                      static_cast<std::streamsize>(slots.size() * sizeof(std::uint32_t)));
+            padTo(header.entriesOffset);
+            out.write(reinterpret_cast<const char*>(entries.data()),
+                      static_cast<std::streamsize>(entries.size() * sizeof(archive::ArchiveEntry)));
+            out.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+            for (std::size_t i = 0; i < files.size(); ++i) {
+                padTo(dataOffsets[i]);
+                out.write(files[i].content.data(), static_cast<std::streamsize>(files[i].content.size()));
+                if (!files[i].gzipContent.empty()) {
+                    padTo(gzipOffsets[i]);
+                    out.write(files[i].gzipContent.data(),
+                              static_cast<std::streamsize>(files[i].gzipContent.size()));
+                }
+            }
+            out.flush();
+            if (!out) {
+                throw std::runtime_error("Failed writing " + tmpPath.string());
+            }
+        }
+        std::filesystem::rename(tmpPath, outputPath);
+
+        std::cout << "Packed " << files.size() << " files (" << entryCount << " paths, " << header.fileSize
+                  << " bytes) into " << outputPath.string() << "\n";
+    } catch (const std::exception& ex) {
+        std::cerr << "docroot-pack: " << ex.what() << "\n";
+        return 1;
+    }
+    return 0;
+}